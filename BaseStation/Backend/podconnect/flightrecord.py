@@ -0,0 +1,63 @@
+# Reads a recording from the pod's flight recorder (CentralComputing/FlightRecorder.h)
+#
+# Usage: python flightrecord.py <file>   prints every entry, oldest first
+import struct
+import sys
+
+try:
+    from . import telemetry
+except ImportError:
+    import telemetry  # Run as a script
+
+MAGIC = 0x31434552
+BLOCK_MAGIC = 0x4B4C4252
+HEADER = struct.Struct('<IHHIIq')  # magic, version, telemetry version, block size, block count, started (us since epoch)
+HEADER_SIZE = 4096
+BLOCK_HEADER = struct.Struct('<IIII')  # magic, sequence, used, entries
+ENTRY_HEADER = struct.Struct('<BH')  # kind, length
+COMMAND = struct.Struct('<qII')  # timestamp (us), id, value
+SNAPSHOT = 1
+COMMAND_KIND = 2
+
+
+def read(path):
+    # Yields ('snapshot', timestamp, sequence, {record name: {field: value}}) with the whole state,
+    # and ('command', timestamp, id, value), oldest first
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, telemetry_version, block_size, block_count, started = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError('Not a flight recording')
+
+    blocks = []
+    for i in range(block_count):
+        offset = HEADER_SIZE + i * block_size
+        if offset + block_size > len(data):
+            break  # Cut short
+        block_magic, sequence, used, entries = BLOCK_HEADER.unpack_from(data, offset)
+        if block_magic == BLOCK_MAGIC and sequence != 0:
+            blocks.append((sequence, offset, min(used, block_size - BLOCK_HEADER.size)))
+
+    for sequence, offset, used in sorted(blocks):
+        decoder = telemetry.Decoder()  # Every block starts with a keyframe
+        at = offset + BLOCK_HEADER.size
+        end = at + used
+        while at + ENTRY_HEADER.size <= end:
+            kind, length = ENTRY_HEADER.unpack_from(data, at)
+            at += ENTRY_HEADER.size
+            if at + length > end:
+                break
+            payload = data[at:at + length]
+            at += length
+            if kind == SNAPSHOT:
+                _, _, packet_sequence, timestamp = telemetry.decode_header(payload)
+                decoder.decode_records(payload[telemetry.HEADER.size:])
+                yield 'snapshot', timestamp, packet_sequence, decoder.state()
+            elif kind == COMMAND_KIND:
+                timestamp, command_id, value = COMMAND.unpack_from(payload)
+                yield 'command', timestamp, command_id, value
+
+
+if __name__ == '__main__':
+    for entry in read(sys.argv[1]):
+        print(*entry)
@@ -1,5 +1,5 @@
 from threading import Thread
-from . import tcpsaver, tcphelper
+from . import tcpsaver, tcphelper, telemetry
 import socket
 import queue
 import time
@@ -14,6 +14,8 @@ import numpy as np
 # uint8_t error_id = 5;
 # uint8_t state_id = 6;
 
+# Packed telemetry (tcp_telemetry_format 1) starts with telemetry.MAGIC instead of one of the IDs above
+
 # TCP global variables
 TCP_IP = ''
 TCP_PORT = 8001
@@ -45,6 +47,7 @@ def serve():
         conn, addr = s.accept()
         print('Connection address:', addr)
         tcpsaver.saveTCPStatus(1)
+        decoder = telemetry.Decoder()  # The pod starts every connection with a keyframe
         while (True):
             # Receiving data
             try:
@@ -53,7 +56,14 @@ def serve():
                     break
                 h = bytearray(data)
                 id = int(h[0])
-                if id == 7: # ADC Data
+                if id == telemetry.MAGIC: # Packed telemetry packet
+                    data = data + recvAll(conn, telemetry.HEADER.size - 1)
+                    version, length, sequence, timestamp = telemetry.decode_header(data)
+                    savePacket(decoder.decode_records(recvAll(conn, length)))
+                    if decoder.missing_base:
+                        decoder.missing_base = False
+                        addToCommandQueue([telemetry.REQUEST_KEYFRAME, 0])
+                elif id == 7: # ADC Data
                     data = conn.recv(7*4)
                     data = tcphelper.bytes_to_signed_int32(data, 7)
                     if tcpsaver.saveADCData(data) == -1:
@@ -103,6 +113,34 @@ def serve():
         tcpsaver.saveTCPStatus(0)
         # Add this to event logger
 
+def recvAll(conn, length):
+    data = b''
+    while len(data) < length:
+        chunk = conn.recv(length - len(data))
+        if not chunk:
+            raise ConnectionError("Pod closed the connection mid packet")
+        data += chunk
+    return data
+
+# Saves each record the same way as the raw struct above it would have been
+def savePacket(records):
+    if 'ADC' in records and tcpsaver.saveADCData(records['ADC']['data']) == -1:
+        print("ADC data failure")
+    if 'CAN' in records and tcpsaver.saveCANData(telemetry.flatten(records['CAN'])) == -1:
+        print("CAN data failure")
+    if 'I2C' in records and tcpsaver.saveI2CData(telemetry.flatten(records['I2C'])[:12]) == -1:
+        print("I2C data failure")
+    if 'PRU' in records and tcpsaver.savePRUData(telemetry.flatten(records['PRU'])[:4]) == -1:
+        print("PRU data failure")
+    if 'MOTION' in records:
+        motion = telemetry.flatten(records['MOTION'])
+        if tcpsaver.saveMotionData(motion[0:3] + motion[11:14], motion[3:11], motion[14:18]) == -1:
+            print("Motion data failure")
+    if 'ERRORS' in records and tcpsaver.saveErrorData(records['ERRORS']['error_vector']) == -1:
+        print("Error data failure")
+    if 'STATE' in records and tcpsaver.saveStateData([records['STATE']['state']]) == -1:
+        print("State data failure")
+
 import binascii
 def sendData():
     global conn, COMMAND_QUEUE
@@ -112,8 +150,7 @@ def sendData():
             command = COMMAND_QUEUE.get()
             try:
                 print("Sending " + str(command))
-                for message in command:
-                    conn.sendall(message)
+                conn.sendall(command.tobytes())  # Whole commands in one go
             except Exception as e:
                 print(e)
                 #COMMAND_QUEUE.put(command)
@@ -127,8 +164,11 @@ def start():
     t2.start()
 
 def addToCommandQueue(toSend):
+    # The pod reads [uint32 id][uint32 value] frames, a lone id would be taken as half of the next command
+    if len(toSend) % 2 == 1:
+        toSend = list(toSend) + [0]
     print(str(toSend) + " Added to Queue")
-    COMMAND_QUEUE.put(np.uint32(toSend))
+    COMMAND_QUEUE.put(np.array(toSend, dtype='<u4'))
 
 def addToCommandQueueUINT8(toSend):
     print(str(toSend) + " Added to Queue as uint8")
@@ -0,0 +1,165 @@
+# Decodes the packed telemetry packets the pod sends (CentralComputing/Telemetry.h)
+#
+# The schema is read out of Telemetry.h itself, so adding a field on the pod only needs a rebuild there.
+# Set POD_SOURCE_DIR if the CentralComputing directory is not next to BaseStation.
+import os
+import re
+import struct
+
+MAGIC = 0xA5
+HEADER = struct.Struct('<BBHIq')  # magic, version, length, sequence, timestamp (us)
+RECORD_HEADER = struct.Struct('<BH')  # type, length
+DELTA = 0x80  # Set in the type of a delta record: [changed field bitmask][changed field values]
+REQUEST_KEYFRAME = 31  # Command::Network_Command_ID, makes the pod send every record whole
+
+TYPES = {
+    'int8_t': 'b', 'uint8_t': 'B',
+    'int16_t': 'h', 'uint16_t': 'H',
+    'int32_t': 'i', 'uint32_t': 'I',
+    'int64_t': 'q', 'uint64_t': 'Q',
+}
+
+SOURCE_DIR = os.environ.get('POD_SOURCE_DIR',
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'CentralComputing'))
+
+
+def _read(name):
+    with open(os.path.join(SOURCE_DIR, name)) as f:
+        return f.read()
+
+
+def _load_schema():
+    defines = dict(re.findall(r'#define\s+(\w+)\s+(\d+)', _read('Defines.hpp')))
+    header = _read('Telemetry.h')
+
+    def count(text):
+        return int(defines.get(text, text))
+
+    # Every "#define TELEMETRY_<NAME>_FIELDS(FIELD, ARRAY, STRUCTS)" block, with its continuation lines
+    lists = {}
+    for name, body in re.findall(r'#define TELEMETRY_(\w+)_FIELDS\(FIELD, ARRAY, STRUCTS\)((?:.*\\\n)*.*)', header):
+        lists[name] = re.findall(r'(FIELD|ARRAY|STRUCTS)\(([^)]*)\)', body)
+
+    # [(name, struct format, count, element fields or None)]
+    def fields(name):
+        out = []
+        for kind, args in lists[name]:
+            args = [a.strip() for a in args.split(',')]
+            if kind == 'FIELD':
+                out.append((args[0], TYPES[args[1]], 1, None))
+            elif kind == 'ARRAY':
+                out.append((args[0], TYPES[args[1]], count(args[2]), None))
+            else:
+                out.append((args[0], None, count(args[1]), fields(args[2][len('TELEMETRY_'):-len('_FIELDS')])))
+        return out
+
+    records = {}
+    for type_id, name, field_list in re.findall(r'RECORD\((\d+), (\w+), [\w:]+, TELEMETRY_(\w+)_FIELDS\)', header):
+        records[int(type_id)] = (name, fields(field_list))
+    version = int(re.search(r'#define TELEMETRY_VERSION (\d+)', header).group(1))
+    return version, records
+
+
+VERSION, RECORDS = _load_schema()
+
+
+def _decode_fields(fields, data, offset):
+    values = {}
+    for name, fmt, n, element in fields:
+        if element is not None:
+            values[name] = []
+            for _ in range(n):
+                value, offset = _decode_fields(element, data, offset)
+                values[name].append(value)
+        else:
+            items = struct.unpack_from('<%d%s' % (n, fmt), data, offset)
+            offset += struct.calcsize('<%d%s' % (n, fmt))
+            values[name] = items[0] if n == 1 else list(items)
+    return values, offset
+
+
+def _leaves(fields):
+    # Struct format of every field in wire order, arrays expanded
+    out = []
+    for name, fmt, n, element in fields:
+        for _ in range(n):
+            out.extend(_leaves(element) if element is not None else [fmt])
+    return out
+
+
+LEAVES = {type_id: _leaves(fields) for type_id, (name, fields) in RECORDS.items()}
+
+
+def flatten(record):
+    # Field values in wire order, arrays expanded
+    out = []
+    for value in record.values():
+        if isinstance(value, list):
+            for item in value:
+                out.extend(flatten(item) if isinstance(item, dict) else [item])
+        else:
+            out.append(value)
+    return out
+
+
+def decode_header(data):
+    # Returns (version, length, sequence, timestamp)
+    magic, version, length, sequence, timestamp = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError('Not a telemetry packet')
+    return version, length, sequence, timestamp
+
+
+def _apply_delta(base, leaves, data, offset, end):
+    # Writes the changed fields over base, the whole record's field bytes
+    mask_size = (len(leaves) + 7) // 8
+    mask = data[offset:offset + mask_size]
+    offset += mask_size
+    position = 0
+    for leaf, fmt in enumerate(leaves):
+        size = struct.calcsize('<' + fmt)
+        if mask[leaf // 8] & (1 << (leaf % 8)):
+            if offset + size > end:
+                raise ValueError('Truncated delta record')
+            base[position:position + size] = data[offset:offset + size]
+            offset += size
+        position += size
+
+
+class Decoder:
+    # One per connection. Remembers the last whole value of every record, so deltas can be applied to it
+    def __init__(self):
+        self.last = {}
+        self.missing_base = False  # A delta arrived for a record never sent whole, a keyframe is needed
+
+    def decode_records(self, data):
+        # Decodes the records after a header. Returns {record name: {field: value}}, unknown records are skipped
+        out = {}
+        offset = 0
+        while offset + RECORD_HEADER.size <= len(data):
+            type_id, length = RECORD_HEADER.unpack_from(data, offset)
+            offset += RECORD_HEADER.size
+            base_id = type_id & ~DELTA
+            if base_id in RECORDS:
+                name, fields = RECORDS[base_id]
+                if type_id & DELTA:
+                    if base_id in self.last:
+                        _apply_delta(self.last[base_id], LEAVES[base_id], data, offset, offset + length)
+                    else:
+                        self.missing_base = True
+                else:
+                    self.last[base_id] = bytearray(data[offset:offset + length])
+                if base_id in self.last:
+                    out[name], _ = _decode_fields(fields, self.last[base_id], 0)
+            offset += length
+        return out
+
+    def state(self):
+        # Every record decoded so far, as of the last packet: {record name: {field: value}}
+        return {RECORDS[type_id][0]: _decode_fields(RECORDS[type_id][1], data, 0)[0]
+                for type_id, data in self.last.items()}
+
+
+def decode_records(data):
+    # Whole records only, see Decoder for a stream with deltas
+    return Decoder().decode_records(data)
@@ -20,8 +20,9 @@ bool ADCManager::initialize_source() {
   adc1_san_negative_counter = 0;
 
   // Open the ADC file
-  inFile.open(fileName, std::ifstream::in | std::ifstream::binary);
-  if (!inFile) {
+  // Raw fd rather than an ifstream, so the refresh loop can wait on it (see source_fd())
+  adc_fd = open(fileName.c_str(), O_RDONLY);
+  if (adc_fd < 0) {
     print(LogLevel::LOG_DEBUG, "ADC Manager setup failed\n");
     Command::set_error_flag(Command::Network_Command_ID::SET_ADC_ERROR,ADCErrors::ADC_SETUP_FAILURE);
     return false;
@@ -32,8 +33,9 @@ bool ADCManager::initialize_source() {
 }
 
 void ADCManager::stop_source() {
-  if (inFile) {
-    inFile.close();
+  if (adc_fd >= 0) {
+    close(adc_fd);
+    adc_fd = -1;
     print(LogLevel::LOG_DEBUG, "ADC Manager stopped\n");
   } 
 }
@@ -47,10 +49,9 @@ void ADCManager::calculate_zero_g() {
 }
 
 std::shared_ptr<ADCData> ADCManager::refresh() {
-  std::shared_ptr<ADCData> new_data = std::make_shared<ADCData>();
+  std::shared_ptr<ADCData> new_data = DataPool::make<ADCData>();
   uint16_t buffer[NUM_ADC];
-  inFile.read(reinterpret_cast<char *>(buffer), NUM_ADC * 2);
-  if (!inFile) {
+  if (read(adc_fd, buffer, NUM_ADC * 2) != NUM_ADC * 2) {
     Command::set_error_flag(Command::Network_Command_ID::SET_ADC_ERROR,ADCErrors::ADC_READ_ERROR);
   }
   for (int i = 0; i < NUM_ADC; i++) {
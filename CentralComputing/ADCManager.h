@@ -6,6 +6,8 @@
 #include "Command.h"
 #include <fstream>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 using std::ifstream;
 
 class ADCManager : public SourceManagerBase<ADCData> {
@@ -17,6 +19,9 @@ class ADCManager : public SourceManagerBase<ADCData> {
   void stop_source();
   std::shared_ptr<ADCData> refresh();
   std::shared_ptr<ADCData> refresh_sim();
+  int source_fd() {
+    return adc_fd;
+  }
 
   int64_t calculate_zero_g_timeout;  // Calculate the zero g for X ammount of seconds
   int64_t calculate_zero_g_time;  // variable used in timer
@@ -59,7 +64,7 @@ class ADCManager : public SourceManagerBase<ADCData> {
   }
 
   std::string fileName;
-  ifstream inFile;
+  int adc_fd = -1;
 
  public:
   // Public for testing purposes
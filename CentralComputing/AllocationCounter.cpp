@@ -0,0 +1,49 @@
+#ifdef SIM
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+#if defined(__SANITIZE_THREAD__) || defined(__SANITIZE_ADDRESS__)
+#define ALLOCATION_COUNTER_DISABLED
+#endif
+
+namespace {
+// Plain integer, no constructor, so it is safe to touch from operator new at any point
+thread_local uint64_t allocations = 0;
+}  // namespace
+
+bool AllocationCounter::enabled() {
+  #ifdef ALLOCATION_COUNTER_DISABLED
+  return false;
+  #else
+  return true;
+  #endif
+}
+
+uint64_t AllocationCounter::thread_allocations() {
+  return allocations;
+}
+
+#ifndef ALLOCATION_COUNTER_DISABLED
+void * operator new(size_t size) {
+  allocations++;
+  void * p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void * p) noexcept {
+  free(p);
+}
+
+void operator delete[](void * p) noexcept {
+  free(p);
+}
+#endif
+#endif
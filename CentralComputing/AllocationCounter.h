@@ -0,0 +1,23 @@
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include <stdint.h>
+
+// Test build (SIM) only: counts calls to the global operator new, per thread.
+// Used to prove the sensor pipeline doesn't touch the heap once it is running.
+//
+// Sanitizer builds supply their own operator new, so counting is disabled there
+// and enabled() returns false.
+namespace AllocationCounter {
+  /*
+   * True if allocations are actually being counted in this build
+   */
+  bool enabled();
+
+  /*
+   * Number of operator new calls made by the calling thread so far
+   */
+  uint64_t thread_allocations();
+}  // namespace AllocationCounter
+
+#endif  // ALLOCATION_COUNTER_H_
@@ -26,6 +26,7 @@ void Brakes::enable_brakes() {
   #endif
   std::lock_guard<std::mutex> guard(mutex);
   enabled = true;
+  Trace::actuated();
 }
 
 void Brakes::disable_brakes() {
@@ -48,6 +49,7 @@ void Brakes::disable_brakes() {
   #endif
   std::lock_guard<std::mutex> guard(mutex);
   enabled = false;
+  Trace::actuated();
 }
 
 void Brakes::set_enable(bool enable) {
@@ -5,6 +5,9 @@ bool CANManager::initialize_source() {
   relay_state_buf[1] = 0;
   relay_state_buf[2] = 0;
   memset(&stored_data, 0, sizeof(CANData));
+  // The relay frame is sent at the configured refresh rate, even if we wake up more often than that (event driven)
+  relay_send_period = refresh_timeout();
+  last_relay_send = -relay_send_period;
   #ifndef BBB
   print(LogLevel::LOG_ERROR, "CAN Manager setup failed, not on BBB\n");
   return false;
@@ -117,32 +120,29 @@ bool CANManager::recv_frame() {
 }
 
 std::shared_ptr<CANData> CANManager::refresh() {
-  std::shared_ptr<CANData> new_data = std::make_shared<CANData>();
-  memcpy(new_data.get(), &stored_data, sizeof(CANData));   // This way, most of the data isn't zeros all of the time
+  std::shared_ptr<CANData> new_data = DataPool::make<CANData>(stored_data);  // This way, most of the data isn't zeros all of the time
 
-  int64_t a = Utils::microseconds();
   // Send HV battery relay state frame
   // print(LogLevel::LOG_INFO, "CAN relay state %d %d %d \n",
   //                          relay_state_buf[0], relay_state_buf[1], relay_state_buf[2]);
-
-  send_mutex.lock();  // Used to protect socketfd (TSan datarace)
-  if (!send_frame(can_id_bms_relay, (relay_state_buf), 3)) {
-    Command::set_error_flag(Command::Network_Command_ID::SET_CAN_ERROR, CANErrors::CAN_SEND_FRAME_ERROR);
+  // refresh() as a whole is timed by the SourceManager, see Metrics.h
+  int64_t now = Utils::microseconds();
+  if (now - last_relay_send >= relay_send_period) {
+    send_mutex.lock();  // Used to protect socketfd (TSan datarace)
+    if (!send_frame(can_id_bms_relay, (relay_state_buf), 3)) {
+      Command::set_error_flag(Command::Network_Command_ID::SET_CAN_ERROR, CANErrors::CAN_SEND_FRAME_ERROR);
+    }
+    send_mutex.unlock();  // Used to protect socketfd (TSan datarace)
+    last_relay_send = now;
   }
-  send_mutex.unlock();  // Used to protect socketfd (TSan datarace)
-  int64_t b = Utils::microseconds();
-  // print(LogLevel::LOG_INFO, "CAN send_frame takes %lu microseconds\n", b-a);
 
   // Recieve frame(s). Populates variable r_frame
   do {
-    a = Utils::microseconds();
     if (!recv_frame()) {
       // Error has already been done by recv_frame()
       // Nothing to do now but continue
       continue;
     }
-    b = Utils::microseconds();
-    // print(LogLevel::LOG_INFO, "CAN recv_frame takes %lu microseconds\n", b-a);
     if (r_frame.can_id == can_id_t1) {
       new_data->status_word =  Utils::cast_to_u32(0, 2, r_frame.data);
       new_data->position_val = Utils::cast_to_u32(2, 4, r_frame.data);
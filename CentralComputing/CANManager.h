@@ -38,6 +38,9 @@ class CANManager : public SourceManagerBase<CANData> {
   void stop_source();
   std::shared_ptr<CANData> refresh();
   std::shared_ptr<CANData> refresh_sim();
+  int source_fd() {
+    return can_fd;
+  }
 
   CANData stored_data;
   BMSCells private_cell_data;
@@ -90,6 +93,8 @@ class CANManager : public SourceManagerBase<CANData> {
 
   // uint32_t relay_state_buf;  // used while sending CAN Frames to BMS
   char relay_state_buf[3];
+  int64_t relay_send_period;
+  int64_t last_relay_send;
   // (reinterpret_cast<char*>(&relay_state_buf))[relay] = state;
 
   int32_t error_motor_ctrl_over_temp;
@@ -1,64 +1,194 @@
 #include "Command.h"
+#include "Notifier.h"
 
-SafeQueue<uint64_t> Command::command_queue;
-int64_t Command::error_flag_timers[FLAGS_PER_ERROR * 6]; 
+MPSCRing<Command::Queued_Command, COMMAND_QUEUE_SIZE> Command::command_queue[NUM_PRIORITIES];
+LatencyHistogram Command::queue_wait[NUM_PRIORITIES];
+std::atomic<int64_t> Command::error_flag_timers[FLAGS_PER_ERROR * 6];
+std::atomic<uint32_t> Command::pending_errors[6];
 
-void Command::put(uint32_t id, uint32_t value) {
-  uint64_t toQueue = (uint64_t)(((uint64_t)id) << 32) | (uint64_t)(value & 0xFFFFFFFF);
-  command_queue.enqueue(toQueue);
+namespace {
+const char * lane_names[Command::NUM_PRIORITIES] = {"critical", "error", "normal"};
+
+Command::Queued_Command make_queued(uint32_t id, uint32_t value, bool coalesced, int64_t now) {
+  Command::Queued_Command toQueue;
+  toQueue.command = (uint64_t)(((uint64_t)id) << 32) | (uint64_t)(value & 0xFFFFFFFF);
+  toQueue.enqueued = now;
+  toQueue.coalesced = coalesced;
+  return toQueue;
+}
+
+bool enqueue(uint32_t id, uint32_t value, bool coalesced) {
+  Command::Queued_Command toQueue = make_queued(id, value, coalesced, LatencyHistogram::now());
+  Command::Priority lane = Command::priority_of(id);
+  bool queued = Command::command_queue[lane].enqueue(toQueue);
+  if (!queued && Command::command_queue[lane].overflows() == 1) {
+    // Only the first one, printing every drop would make the storm worse
+    Utils::print(Utils::LogLevel::LOG_ERROR, "Command queue %s full, dropping commands\n", lane_names[lane]);
+  }
+  Notifications::logic_loop.notify();  // In case the logic loop is waiting for something to happen
+  return queued;
+}
+}  // namespace
+
+Command::Priority Command::priority_of(uint32_t id) {
+  switch (id) {
+    case TRANS_ABORT:
+    case TRANS_FLIGHT_BRAKE:
+      return PRIORITY_CRITICAL;
+    default:
+      if (id >= SET_ADC_ERROR && id <= CLR_OTHER_ERROR) {
+        return PRIORITY_ERROR;
+      }
+      return PRIORITY_NORMAL;
+  }
+}
+
+bool Command::put(uint32_t id, uint32_t value) {
+  return enqueue(id, value, false);
+}
+
+size_t Command::put_batch(const Network_Command * commands, size_t count) {
+  int64_t now = LatencyHistogram::now();
+  size_t queued = 0;
+  while (queued < count) {
+    const Network_Command & command = commands[queued];
+    Priority lane = priority_of(command.id);
+    // Checked first so waiting for room isn't counted as a drop. Another producer can still fill the lane
+    // in between, then the enqueue fails and this command is retried all the same
+    if (command_queue[lane].size() >= (int) COMMAND_QUEUE_SIZE ||
+        !command_queue[lane].enqueue(make_queued(command.id, command.value, false, now))) {
+      break;
+    }
+    queued++;
+  }
+  if (queued > 0) {
+    Notifications::logic_loop.notify();
+  }
+  return queued;
 }
 
-bool Command::get(Network_Command * com) {
-  uint64_t preShift;
-  if (!command_queue.dequeue(&preShift)) {
+bool Command::get(Network_Command * com, CommandTrace * trace) {
+  Queued_Command heads[NUM_PRIORITIES];
+  bool ready[NUM_PRIORITIES];
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    ready[i] = command_queue[i].front(&heads[i]);
+  }
+
+  // Highest priority lane with something in it, unless a lower lane has a command that waited too long
+  int lane = -1;
+  for (int i = 0; i < NUM_PRIORITIES && lane < 0; i++) {
+    if (ready[i]) {
+      lane = i;
+    }
+  }
+  if (lane < 0) {
     return false;
   }
-  com->value = static_cast<uint32_t>(preShift & 0xFFFFFFFF);
-  com->id = static_cast<uint32_t>(preShift >> 32);
+  if (lane != PRIORITY_CRITICAL) {
+    int64_t now = LatencyHistogram::now();
+    for (int i = lane + 1; i < NUM_PRIORITIES; i++) {
+      if (ready[i] && now - heads[i].enqueued > COMMAND_MAX_WAIT && heads[i].enqueued < heads[lane].enqueued) {
+        lane = i;
+      }
+    }
+  }
+
+  Queued_Command queued;
+  command_queue[lane].dequeue(&queued);
+  int64_t dequeued = LatencyHistogram::now();
+  queue_wait[lane].record(dequeued - queued.enqueued);
+  com->value = static_cast<uint32_t>(queued.command & 0xFFFFFFFF);
+  com->id = static_cast<uint32_t>(queued.command >> 32);
+  if (queued.coalesced) {
+    // Everything set_error_flag() OR'd in since this placeholder was queued. After the exchange the next bit
+    // queues a new placeholder
+    com->value |= pending_errors[com->id - SET_ADC_ERROR].exchange(0);
+    if (com->value == 0) {
+      return get(com, trace);  // Already taken by a flush(), nothing to apply
+    }
+  }
+  if (trace != nullptr) {
+    trace->id = com->id;
+    trace->value = com->value;
+    trace->created = queued.enqueued;
+    trace->dequeued = dequeued;
+    trace->transitioned = 0;
+    trace->actuated = 0;
+  }
   return true;
 }
 
+int Command::size() {
+  int total = 0;
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    total += command_queue[i].size();
+  }
+  return total;
+}
+
 // I would use the function for testing code...
 void Command::wait_for_empty() {
   Event e;
-  while (command_queue.size() != 0) {
+  while (size() != 0) {
     e.wait_for(5000);
   }
 }
 
 void Command::flush() {
-  uint64_t tmp;
-  while (command_queue.dequeue(&tmp)) {}
+  Queued_Command tmp;
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    while (command_queue[i].dequeue(&tmp)) {}
+  }
+  for (int i = 0; i < 6; i++) {
+    pending_errors[i].store(0);  // Their placeholders are gone
+  }
 }
 
-std::mutex Command::error_flag_mutex;
+void Command::reset_queue_counters() {
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    command_queue[i].reset_counters();
+  }
+}
+
+void Command::print_queue_stats() {
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    Utils::print(Utils::LogLevel::LOG_INFO, "command_queue %-8s: high water %d/%d, %lu dropped\n", lane_names[i],
+                 command_queue[i].high_water(), COMMAND_QUEUE_SIZE, (unsigned long) command_queue[i].overflows());
+  }
+}
 
 // Used in set_error_flag to not flood the command queue
 // See the .h for more explanation
 void Command::set_error_flag(Network_Command_ID id, uint32_t value) {
-  // Satisfy TSAN. There is a potential data race on `first_time`, even though its not a dangerous one.
-  error_flag_mutex.lock();  
-  // Initialize if this is the first function call
-  static bool first_time = 1;
-  if (first_time) {
-    // Setup error flag timers to -1
-    for (int i = 0; i < FLAGS_PER_ERROR * 6; i++) {
-      Command::error_flag_timers[i] = -1000000;  // negative 1 second. 
-    }
-    first_time = 0;
+  if (value == 0) {
+    return;
   }
-  error_flag_mutex.unlock();
+  int64_t now = LatencyHistogram::now() / 1000;  // One clock read per call, however many bits are set
+  std::atomic<int64_t> * timers = &error_flag_timers[(id - Command::SET_ADC_ERROR) * FLAGS_PER_ERROR];
+  std::atomic<uint32_t> * pending = &pending_errors[id - Command::SET_ADC_ERROR];
 
-  int error_index = (id-Command::SET_ADC_ERROR) * FLAGS_PER_ERROR;
+  uint32_t send = 0;
+  while (value != 0) {  // Only visit the bits that are on, lowest first
+    int bit = __builtin_ctz(value);
+    value &= value - 1;  // Clear that bit
+    int64_t last = timers[bit].load(std::memory_order_relaxed);
+    // Only send once per ERROR_FLAG_PERIOD. If several threads hit the same bit at once, the CAS picks one sender
+    if ((last <= 0 || now - last > ERROR_FLAG_PERIOD) &&
+        timers[bit].compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+      send |= ((uint32_t) 1) << bit;
+    }
+  }
+  if (send == 0) {
+    return;
+  }
 
-  for (int i = 0, j = 1; i < FLAGS_PER_ERROR; i++, j*=2) {  // Go through each bit of the flag  
-    if (value & ((uint32_t) j)) {  // if the specific bit is on
-      // Determine the time delta, use the error_flag_timers
-      int64_t delta = Utils::microseconds() - error_flag_timers[error_index + i]; 
-      if (delta > 1000000) {  // Delta is greater than 1 second. This means we only send once per second!
-        error_flag_timers[error_index + i] = Utils::microseconds();
-        Command::put(id, (value & (uint32_t)j));  // put command on queue
-      }
+  // Only the first bits since the logic loop last took them queue a command, the rest ride along with it
+  if (pending->fetch_or(send) == 0 && !enqueue(id, 0, true)) {
+    // Lane full. Forget whatever never made it in and let those bits be sent again next time they fire
+    uint32_t lost = pending->exchange(0);
+    while (lost != 0) {
+      timers[__builtin_ctz(lost)].store(0, std::memory_order_relaxed);
+      lost &= lost - 1;
     }
   }
 }
@@ -99,12 +229,23 @@ std::string Command::get_network_command_ID_string(uint command) {
     "SET_HV_RELAY_PRE_CHARGE",
     "CALC_ACCEL_ZERO_G",
     "RESET_PRU",
+    "REQUEST_KEYFRAME",
     "SENTINEL -- INVALID COMMAND",
   };
   return commands[command];
 }
 
 std::string Command::get_network_command_value_string(Network_Command * com) {
+  if (com->id >= SET_ADC_ERROR && com->id <= CLR_OTHER_ERROR && (com->value & (com->value - 1)) != 0) {
+    // Several error bits (coalesced by set_error_flag), name each one
+    std::string names;
+    Network_Command bit = *com;
+    for (uint32_t rest = com->value; rest != 0; rest &= rest - 1) {
+      bit.value = rest & (~rest + 1);
+      names += (names.empty() ? "" : "|") + get_network_command_value_string(&bit);
+    }
+    return names;
+  }
   if (com->id == SET_ADC_ERROR || com->id == CLR_ADC_ERROR) {
     if (com->value >= ADCErrors::ADC_SENTINEL || com->value == 0) {
       return "INVALID";
@@ -121,6 +262,7 @@ std::string Command::get_network_command_value_string(Network_Command * com) {
       "ADC_BATTERY_BOX_UNDER_PRESSURE_ERROR",
       "ADC_POSITIVE_SANITY_ERROR",
       "ADC_NEGATIVE_SANITY_ERROR",
+      "ADC_STALE_DATA",
       "ADC_SENTINEL",
     };
     int val = std::log2(com->value);
@@ -155,6 +297,7 @@ std::string Command::get_network_command_value_string(Network_Command * com) {
       "CAN_MOTOR_CONTROLLER_FAULT",
       "CAN_MOTOR_CONTROLLER_WARN",
       "CAN_BMS_ROLLING_COUNTER_ERROR",
+      "CAN_STALE_DATA",
       "CAN_SENTINEL",
     };
     int val = std::log2(com->value);
@@ -170,6 +313,7 @@ std::string Command::get_network_command_value_string(Network_Command * com) {
       "I2C_OVER_TEMP_ONE",
       "I2C_OVER_TEMP_TWO",
       "I2C_OVER_TEMP_THREE",
+      "I2C_STALE_DATA",
       "I2C_SENTINEL",
     };
     int val = std::log2(com->value);
@@ -185,6 +329,7 @@ std::string Command::get_network_command_value_string(Network_Command * com) {
       "PRU_ORANGE_DIFF_ERROR",
       "PRU_WHEEL_DIFF_ERROR",
       "PRU_WATCHDOG_FAIL",
+      "PRU_STALE_DATA",
       "PRU_SENTINEL",
     };
     int val = std::log2(com->value);
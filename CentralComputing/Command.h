@@ -2,7 +2,9 @@
 #define COMMAND_H_
 
 #include "Utils.h"
-#include "SafeQueue.hpp"
+#include "MPSCRing.hpp"
+#include "LatencyHistogram.h"
+#include "Trace.h"
 #include "Event.h"
 #include "Defines.hpp"
 #include <sys/socket.h>
@@ -13,17 +15,49 @@
 #include <poll.h>
 #include <atomic>
 #include <thread> // NOLINT
+#include <mutex> // NOLINT
 #include <memory>
 #include <sys/ioctl.h>
 
 namespace Command {
 
-extern SafeQueue<uint64_t> command_queue;
+// Commands from every thread (source managers, TCP, UDP, the state machine) go through bounded lock free queues,
+// read only by the logic loop. If one fills up (ex: an error storm) new commands are dropped and counted
+//
+// Each command has a priority lane (see priority_of()). get() always serves the CRITICAL lane first, then
+// the ERROR lane, then NORMAL, unless the head of a lower lane has waited longer than COMMAND_MAX_WAIT,
+// in which case the oldest such command goes first so nothing starves. Order within a lane is FIFO
+enum Priority {
+  PRIORITY_CRITICAL = 0,  // TRANS_ABORT and TRANS_FLIGHT_BRAKE, valid from any state they apply in
+                          // ENABLE_BRAKE/ DISABLE_BRAKE stay NORMAL: they depend on the transitions queued before them
+  PRIORITY_ERROR = 1,     // SET_XXX_ERROR and CLR_XXX_ERROR, kept together so a set and clear stay in order
+  PRIORITY_NORMAL = 2,    // Everything else
+  NUM_PRIORITIES = 3
+};
+
+#define COMMAND_QUEUE_SIZE 256  // Per lane
+#define COMMAND_MAX_WAIT 10000000  // nanoseconds
+
+struct Queued_Command {
+  uint64_t command;  // id << 32 | value
+  int64_t enqueued;  // LatencyHistogram::now() when put()
+  bool coalesced;    // Placeholder from set_error_flag(), get() fills in the value from pending_errors
+};
+
+extern MPSCRing<Queued_Command, COMMAND_QUEUE_SIZE> command_queue[NUM_PRIORITIES];
+extern LatencyHistogram queue_wait[NUM_PRIORITIES];  // put() to get(), per lane
 struct Network_Command;
-void put(uint32_t id, uint32_t value);
-bool get(Network_Command * com);
+Priority priority_of(uint32_t id);
+bool put(uint32_t id, uint32_t value);  // false if the lane was full and the command dropped
+// Queues commands in order and wakes the logic loop once. Stops at the first one whose lane is full instead of
+// dropping it. @return the number queued, the caller retries the rest
+size_t put_batch(const Network_Command * commands, size_t count);
+bool get(Network_Command * com, CommandTrace * trace = nullptr);  // Logic loop only. Fills in trace's timestamps
+int size();  // Commands queued in all lanes
 void wait_for_empty();
 void flush();
+void reset_queue_counters();
+void print_queue_stats();  // High water mark and dropped commands per lane, since the last reset_queue_counters()
   
 enum Network_Command_ID {
   // state transitions
@@ -58,7 +92,8 @@ enum Network_Command_ID {
   SET_HV_RELAY_PRE_CHARGE = 28,
   CALC_ACCEL_ZERO_G = 29,
   RESET_PRU = 30,
-  SENTINEL = 31,  // Any Command above this value is an invalid command
+  REQUEST_KEYFRAME = 31,  // Next telemetry sends every record whole (see Telemetry::Encoder)
+  SENTINEL = 32,  // Any Command above this value is an invalid command
   // MUST ADD THESE TO TRANSITION LIST
   // Update the get_string() function bellow with additional commands, or suffer segfaults
 };
@@ -92,10 +127,16 @@ std::string get_network_command_value_string(Network_Command * com);
 // This function is "safe" and will not spam the queue.
 // Say something is faulting every cycle. Initially it will set the error flag
 // But then it send another command to the Unified Queue once every second. 
-// This helper function, and the int64_t array of timers makes that possible
+// This helper function, and the array of timers makes that possible. Lock free, safe to call from any thread
+//
+// Bits for the same SET_XXX_ERROR are coalesced: they are OR'd into pending_errors, and only the first one since
+// the logic loop last looked queues a command. get() swaps the pending bits into that command's value, so a burst
+// of faults from one source is one command (one set_error_code() and transition) per logic loop iteration
 #define FLAGS_PER_ERROR 32
-extern int64_t error_flag_timers[FLAGS_PER_ERROR * 6];  // 32 flags per error ID, 6 errors
-extern std::mutex error_flag_mutex;
+#define ERROR_FLAG_PERIOD 1000000  // microseconds
+// When each bit was last sent, CLOCK_MONOTONIC microseconds. 0 or negative means never
+extern std::atomic<int64_t> error_flag_timers[FLAGS_PER_ERROR * 6];  // 32 flags per error ID, 6 errors
+extern std::atomic<uint32_t> pending_errors[6];  // Bits waiting for the logic loop, per SET_XXX_ERROR
 void set_error_flag(Network_Command_ID id, uint32_t value);
 
 }  // namespace Command
@@ -0,0 +1,59 @@
+#include "CommandReader.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+uint32_t get_u32(const uint8_t * bytes) {
+  return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+}  // namespace
+
+CommandReader::CommandReader(int fd) {
+  reset(fd);
+}
+
+void CommandReader::reset(int fd) {
+  socket = fd;
+  end = 0;
+  reads = 0;
+  commands = 0;
+}
+
+ssize_t CommandReader::fill() {
+  if (end == sizeof(buffer)) {
+    errno = ENOBUFS;
+    return -1;
+  }
+  ssize_t bytes_read;
+  do {
+    bytes_read = read(socket, buffer + end, sizeof(buffer) - end);
+  } while (bytes_read < 0 && errno == EINTR);
+  if (bytes_read > 0) {
+    end += (size_t) bytes_read;
+    reads++;
+  }
+  return bytes_read;
+}
+
+size_t CommandReader::append(const uint8_t * data, size_t size) {
+  size_t taken = size < sizeof(buffer) - end ? size : sizeof(buffer) - end;
+  memcpy(buffer + end, data, taken);
+  end += taken;
+  return taken;
+}
+
+size_t CommandReader::decode(Command::Network_Command * out, size_t max) {
+  size_t count = 0;
+  size_t at = 0;
+  while (count < max && end - at >= COMMAND_FRAME_SIZE) {
+    out[count].id = get_u32(buffer + at);
+    out[count].value = get_u32(buffer + at + 4);
+    at += COMMAND_FRAME_SIZE;
+    count++;
+  }
+  end -= at;
+  memmove(buffer, buffer + at, end);  // Usually just part of a command, if anything
+  commands += count;
+  return count;
+}
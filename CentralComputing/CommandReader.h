@@ -0,0 +1,62 @@
+#ifndef COMMANDREADER_H_
+#define COMMANDREADER_H_
+
+#include "Command.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+#define COMMAND_FRAME_SIZE 8       // [uint32 id][uint32 value], little endian
+#define COMMAND_READ_BUFFER 4096   // Bytes one read() can take, COMMAND_READ_BUFFER / COMMAND_FRAME_SIZE commands
+
+// Splits the byte stream from the base station into Network_Commands
+//
+// TCP doesn't keep the sender's writes apart: one read() can end part way through a command, or hold dozens
+// of them. Each fill() is a single read() of as much as is waiting, appended to whatever partial command the
+// last one left, and decode() takes out every complete command, so a burst costs one syscall rather than
+// one per command, and a command split across reads is put back together instead of being read as garbage.
+//
+// One per connection, used by one thread
+class CommandReader {
+ public:
+  static const size_t MAX_COMMANDS = COMMAND_READ_BUFFER / COMMAND_FRAME_SIZE;
+
+  explicit CommandReader(int fd = -1);
+
+  /*
+   * Starts over on a new connection, dropping any partial command
+   */
+  void reset(int fd);
+
+  /*
+   * One read() from the socket, blocking if it is blocking and nothing is waiting.
+   * Call decode() in between, or there may be no room left
+   * @return bytes read, 0 once the other end closed, -1 if failed
+   */
+  ssize_t fill();
+
+  /*
+   * Bytes that arrived some other way, treated like a read()
+   * @return bytes taken, less than size if the buffer filled up
+   */
+  size_t append(const uint8_t * data, size_t size);
+
+  /*
+   * Takes out every complete command, oldest first. A partial command stays for the next fill()
+   * @return commands put in out, at most max (MAX_COMMANDS always empties the buffer)
+   */
+  size_t decode(Command::Network_Command * out, size_t max);
+
+  size_t buffered() const { return end; }  // Bytes not decoded yet
+  int fd() const { return socket; }
+
+  // Since the last reset()
+  uint64_t reads;     // read() calls that returned data
+  uint64_t commands;  // Decoded
+
+ private:
+  int socket;
+  size_t end;  // Bytes in buffer
+  uint8_t buffer[COMMAND_READ_BUFFER];
+};
+
+#endif  // COMMANDREADER_H_
@@ -168,7 +168,8 @@ enum ADCErrors {
   ADC_BATTERY_BOX_UNDER_PRESSURE_ERROR = 0x100,
   ADC_POSITIVE_SANITY_ERROR = 0x200,
   ADC_NEGATIVE_SANITY_ERROR = 0x400,
-  ADC_SENTINEL = 0x800  // Not an error, but a way to easily keep track of the number of errors
+  ADC_STALE_DATA = 0x800,
+  ADC_SENTINEL = 0x1000  // Not an error, but a way to easily keep track of the number of errors
   // Update Command.cpp with additional errors, or suffer segfaults
 };
 
@@ -198,7 +199,8 @@ enum CANErrors {
   CAN_MOTOR_CONTROLLER_FAULT = 0x400000,
   CAN_MOTOR_CONTROLLER_WARN = 0x800000,
   CAN_BMS_ROLLING_COUNTER_ERROR = 0x1000000,
-  CAN_SENTINEL = 0x2000000  // Not an error, but a way to easily keep track of the number of errors
+  CAN_STALE_DATA = 0x2000000,
+  CAN_SENTINEL = 0x4000000  // Not an error, but a way to easily keep track of the number of errors
   // Update Command.cpp with additional errors, or suffer segfaults
 };
 
@@ -209,7 +211,8 @@ enum I2CErrors {
   I2C_OVER_TEMP_ONE = 0x8,
   I2C_OVER_TEMP_TWO = 0x10,
   I2C_OVER_TEMP_THREE = 0x20,
-  I2C_SENTINEL = 0x40  // Not an error, but a way to easily keep track of the number of errors
+  I2C_STALE_DATA = 0x40,
+  I2C_SENTINEL = 0x80  // Not an error, but a way to easily keep track of the number of errors
   // Update Command.cpp with additional errors, or suffer segfaults
 };
 
@@ -220,7 +223,8 @@ enum PRUErrors {
   PRU_ORANGE_DIFF_ERROR = 0x8,
   PRU_WHEEL_DIFF_ERROR = 0x10,
   PRU_WATCHDOG_FAIL = 0x20,
-  PRU_SENTINEL = 0x40  // Not an error, but a way to easily keep track of the number of errors
+  PRU_STALE_DATA = 0x40,
+  PRU_SENTINEL = 0x80  // Not an error, but a way to easily keep track of the number of errors
   // Update Command.cpp with additional errors, or suffer segfaults
 };
 
@@ -252,6 +256,13 @@ struct Errors{
   // [5] Other Errors
 };
 
+// Filled in by SourceManagerBase every time a manager publishes new data
+struct SampleHeader {
+  int64_t timestamp;  // CLOCK_MONOTONIC nanoseconds when the data was captured, 0 if never captured
+  uint32_t sequence;  // Incremented on every publish
+  uint32_t PADDING;
+};
+
 struct UnifiedState{
   std::shared_ptr<MotionData> motion_data;
   std::shared_ptr<ADCData> adc_data;
@@ -260,6 +271,12 @@ struct UnifiedState{
   std::shared_ptr<PRUData> pru_data;
   std::shared_ptr<Errors> errors;
   E_States state;
+
+  // When each of the above sensor snapshots was captured
+  SampleHeader adc_header;
+  SampleHeader can_header;
+  SampleHeader i2c_header;
+  SampleHeader pru_header;
 };
 
 #endif
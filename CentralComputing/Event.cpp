@@ -1,26 +1,105 @@
 #include "Event.h"
+#include "Utils.h"
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono> // NOLINT
+
+using Utils::print;
+using Utils::LogLevel;
+
+Event::Event() : condition(false) {
+  event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0) {
+    PRINT_ERRNO("Event eventfd failed, falling back to a condition_variable");
+  }
+}
+
+Event::~Event() {
+  if (event_fd >= 0) {
+    close(event_fd);
+  }
+}
+
+void Event::poll_until(int64_t monotonic_nanos) {
+  if (event_fd < 0) {
+    // steady_clock is CLOCK_MONOTONIC
+    std::unique_lock<std::mutex> lk(mutex);
+    if (monotonic_nanos < 0) {
+      cond.wait(lk, [&]{ return condition.load(); });
+    } else {
+      std::chrono::steady_clock::time_point deadline{std::chrono::nanoseconds(monotonic_nanos)};
+      cond.wait_until(lk, deadline, [&]{ return condition.load(); });
+    }
+    return;
+  }
+
+  struct pollfd pfd;
+  pfd.fd = event_fd;
+  pfd.events = POLLIN;
+  while (!condition.load()) {
+    struct timespec timeout;
+    struct timespec * timeout_ptr = nullptr;
+    if (monotonic_nanos >= 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int64_t left = monotonic_nanos - (static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec);
+      if (left <= 0) {
+        return;
+      }
+      timeout.tv_sec = static_cast<time_t>(left / 1000000000LL);
+      timeout.tv_nsec = static_cast<long>(left % 1000000000LL);  // NOLINT
+      timeout_ptr = &timeout;
+    }
+    int rv = ppoll(&pfd, 1, timeout_ptr, nullptr);
+    if (rv > 0 || (rv < 0 && errno != EINTR)) {
+      return;  // Set (or a broken fd, don't spin on it)
+    }
+  }
+}
 
 void Event::wait() {
-  std::unique_lock<std::mutex> lk(mutex);
-  cond.wait(lk, [&]{ return condition; });
-  lk.unlock();
+  poll_until(-1);
 }
 
 void Event::wait_for(int64_t micros) {
-  std::unique_lock<std::mutex> lk(mutex);
-  cond.wait_for(lk, std::chrono::microseconds(micros), [&]{ return condition; });
-  lk.unlock();
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  poll_until(static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec + micros * 1000);
+}
+
+void Event::wait_until(int64_t monotonic_nanos) {
+  poll_until(monotonic_nanos < 0 ? 0 : monotonic_nanos);
+}
+
+bool Event::is_set() {
+  return condition.load();
 }
 
 void Event::invoke() {
-  std::unique_lock<std::mutex> lk(mutex);
-  condition = true;
-  lk.unlock();
-  cond.notify_all(); 
+  std::lock_guard<std::mutex> guard(mutex);
+  if (!condition.load()) {
+    uint64_t one = 1;
+    if (event_fd >= 0 && write(event_fd, &one, sizeof(one)) < 0) {
+      PRINT_ERRNO("Event write failed");
+    }
+    condition.store(true);
+    if (event_fd < 0) {
+      cond.notify_all();
+    }
+  }
 }
 
 void Event::reset() {
-  std::unique_lock<std::mutex> lk(mutex);
-  condition = false;
-  lk.unlock();
+  std::lock_guard<std::mutex> guard(mutex);
+  if (condition.load()) {
+    uint64_t count;
+    if (event_fd >= 0 && read(event_fd, &count, sizeof(count)) < 0) {}  // Clears the eventfd counter
+    condition.store(false);
+  }
+}
+
+int Event::fd() {
+  return event_fd;
 }
@@ -1,15 +1,24 @@
 #ifndef EVENT_H_
 #define EVENT_H_
 
+#include <stdint.h>
+#include <atomic>
 #include <mutex> // NOLINT
 #include <condition_variable> // NOLINT
 
 
 // The Event object helps manage the pod's threads and is useful to wait for something to occur
-// It's a pretty basic wrapper on a mutex/condition variable
 // You can reuse an event by calling reset()
+//
+// It is backed by an eventfd, which is readable for as long as the event is set. Along with wait(), a loop can
+// put fd() in the same poll()/ epoll (see Poller.h) as its sockets and timers, and wake up on whichever comes first
+// If the eventfd can't be created (ex: out of file descriptors), fd() is -1 and waits fall back to a
+// condition_variable, so wait()/ invoke() keep working
 class Event {
  public:
+  Event();
+  ~Event();
+
   /*
    * Causes this thread to wait for another thread to invoke the event
    */
@@ -20,6 +29,17 @@ class Event {
    */
   void wait_for(int64_t micros);
 
+  /*
+   * Causes this thread to wait until an absolute CLOCK_MONOTONIC time (in nanoseconds)
+   * or until the event is invoked
+   */
+  void wait_until(int64_t monotonic_nanos);
+
+  /*
+   * True if the event has been invoked since the last reset(). Never blocks
+   */
+  bool is_set();
+
   /*
    * Wakes up all waiting threads
    */
@@ -30,9 +50,18 @@ class Event {
    */
   void reset();
 
+  /*
+   * File descriptor that polls readable (POLLIN/ EPOLLIN) while the event is set. Don't read from it, use reset()
+   */
+  int fd();
+
  private:
-  std::mutex mutex;
-  std::condition_variable cond;
-  bool condition = false;
+  // Blocks until the fd is readable or the deadline (absolute nanoseconds, negative for none) passes
+  void poll_until(int64_t monotonic_nanos);
+
+  int event_fd;
+  std::atomic<bool> condition;  // Mirrors the eventfd, so is_set() and waits on a set event skip the syscall
+  std::mutex mutex;  // Keeps invoke() and reset() from interleaving
+  std::condition_variable cond;  // Only used without an eventfd
 };
 #endif  // EVENT_H_
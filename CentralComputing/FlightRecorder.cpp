@@ -0,0 +1,409 @@
+#include "FlightRecorder.h"
+#include "ThreadConfig.h"
+#include "Utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <utility>
+
+using Utils::print;
+using Utils::LogLevel;
+
+static_assert(FLIGHT_RECORDER_BLOCK_HEADER_SIZE + FLIGHT_RECORDER_ENTRY_HEADER_SIZE + Telemetry::MAX_PACKET_SIZE <=
+              FLIGHT_RECORDER_BLOCK_SIZE, "A whole keyframe must fit in a block");
+
+namespace {
+const size_t COMMAND_SIZE = 16;  // Payload of a FLIGHT_RECORD_COMMAND entry
+
+template <class T>
+void put(uint8_t * out, T value) {
+  uint64_t bits = (uint64_t) value;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    out[i] = (uint8_t) (bits >> (8 * i));
+  }
+}
+
+template <class T>
+T get(const uint8_t * in) {
+  uint64_t bits = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    bits |= (uint64_t) in[i] << (8 * i);
+  }
+  return (T) bits;
+}
+
+template <class T>
+bool read_record(const uint8_t * fields, size_t size, bool delta, T * dst) {
+  return delta ? Telemetry::apply_delta(fields, size, dst) : Telemetry::decode(fields, size, dst);
+}
+}  // namespace
+
+FlightRecorder::FlightRecorder() : snapshots(0), commands(0), dropped(0), bytes(0), blocks(0), recording(false),
+  next_sequence(0), fd(-1), map(nullptr), map_size(0), block_total(0), sequence(0), block(nullptr), used(0),
+  entries(0), first_timestamp(-1), last_timestamp(-1) {
+}
+
+FlightRecorder::~FlightRecorder() {
+  close();
+}
+
+bool FlightRecorder::open(const std::string & path, size_t size) {
+  if (recording.load()) {
+    return false;
+  }
+  block_total = size / FLIGHT_RECORDER_BLOCK_SIZE;
+  if (block_total < 2) {
+    print(LogLevel::LOG_ERROR, "Flight recorder needs at least 2 blocks of %d bytes\n", FLIGHT_RECORDER_BLOCK_SIZE);
+    return false;
+  }
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    print(LogLevel::LOG_ERROR, "Flight recorder can't open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  map_size = FLIGHT_RECORDER_HEADER_SIZE + block_total * FLIGHT_RECORDER_BLOCK_SIZE;
+  // Claim the disk space now, running out part way through would be a SIGBUS in the writer
+  int error = posix_fallocate(fd, 0, (off_t) map_size);
+  void * mapped = error == 0 ? mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  if (mapped == MAP_FAILED) {
+    print(LogLevel::LOG_ERROR, "Flight recorder can't allocate %lu bytes for %s: %s\n", (unsigned long) map_size,
+          path.c_str(), strerror(error != 0 ? error : errno));  // NOLINT
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  map = static_cast<uint8_t *>(mapped);
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  put<uint32_t>(map, FLIGHT_RECORDER_MAGIC);
+  put<uint16_t>(map + 4, FLIGHT_RECORDER_VERSION);
+  put<uint16_t>(map + 6, TELEMETRY_VERSION);
+  put<uint32_t>(map + 8, FLIGHT_RECORDER_BLOCK_SIZE);
+  put<uint32_t>(map + 12, (uint32_t) block_total);
+  put<int64_t>(map + 16, (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000);
+
+  // Anything left from the last recording
+  Snapshot snapshot;
+  CommandRecord command;
+  while (snapshot_queue.dequeue(&snapshot)) {}
+  while (command_queue.dequeue(&command)) {}
+  snapshots.store(0);
+  commands.store(0);
+  dropped.store(0);
+  bytes.store(0);
+  blocks.store(0);
+  next_sequence.store(0);
+  sequence = 0;
+  block = nullptr;
+  first_timestamp = -1;
+  last_timestamp = -1;
+  encoder.set_keyframe_period(INT64_MAX);  // Deltas, keyframes only at the start of each block
+
+  closing.reset();
+  recording.store(true);
+  writer = std::thread(&FlightRecorder::write_loop, this);
+  print(LogLevel::LOG_INFO, "Flight recorder writing to %s, %lu blocks of %d bytes\n", path.c_str(),
+        (unsigned long) block_total, FLIGHT_RECORDER_BLOCK_SIZE);  // NOLINT
+  return true;
+}
+
+void FlightRecorder::close() {
+  if (!recording.exchange(false)) {
+    return;
+  }
+  closing.invoke();
+  writer.join();
+  msync(map, map_size, MS_SYNC);
+  munmap(map, map_size);
+  ::close(fd);
+  map = nullptr;
+  block = nullptr;
+  fd = -1;
+  print_stats();
+}
+
+bool FlightRecorder::record(const UnifiedState & state) {
+  if (!recording.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  Snapshot snapshot;
+  snapshot.sequence = next_sequence.fetch_add(1);
+  snapshot.timestamp = Utils::microseconds();
+  snapshot.motion = *state.motion_data;
+  snapshot.adc = *state.adc_data;
+  snapshot.can = *state.can_data;
+  snapshot.i2c = *state.i2c_data;
+  snapshot.pru = *state.pru_data;
+  snapshot.errors = *state.errors;
+  snapshot.state = state.state;
+  if (!snapshot_queue.enqueue(snapshot)) {
+    dropped++;
+    return false;
+  }
+  return true;
+}
+
+bool FlightRecorder::record(const Command::Network_Command & command) {
+  if (!recording.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  CommandRecord queued;
+  queued.before = next_sequence.load();
+  queued.timestamp = Utils::microseconds();
+  queued.command = command;
+  if (!command_queue.enqueue(queued)) {
+    dropped++;
+    return false;
+  }
+  return true;
+}
+
+void FlightRecorder::write_loop() {
+  ThreadConfig::apply("flight_recorder");
+  while (recording.load()) {
+    closing.wait_for(FLIGHT_RECORDER_WRITE_PERIOD);
+    drain();
+  }
+  drain();  // What came in while closing
+}
+
+void FlightRecorder::drain() {
+  Snapshot snapshot;
+  CommandRecord command;
+  bool has_snapshot = false;
+  bool has_command = false;
+  while (true) {
+    // The snapshot is taken first: any command queued before it is then visible too
+    has_snapshot = has_snapshot || snapshot_queue.dequeue(&snapshot);
+    has_command = has_command || command_queue.dequeue(&command);
+    if (!has_snapshot && !has_command) {
+      return;
+    }
+    // In the order they were recorded: a logic loop iteration applies its commands, then is snapshot
+    if (has_command && (!has_snapshot || command.before <= snapshot.sequence)) {
+      uint8_t payload[COMMAND_SIZE];
+      put<int64_t>(payload, command.timestamp);
+      put<uint32_t>(payload + 8, command.command.id);
+      put<uint32_t>(payload + 12, command.command.value);
+      if (block == nullptr || used + FLIGHT_RECORDER_ENTRY_HEADER_SIZE + COMMAND_SIZE >
+          FLIGHT_RECORDER_BLOCK_SIZE - FLIGHT_RECORDER_BLOCK_HEADER_SIZE) {
+        start_block();
+      }
+      write_entry(FLIGHT_RECORD_COMMAND, payload, COMMAND_SIZE);
+      commands++;
+      has_command = false;
+    } else {
+      // Encoded as deltas against the last snapshot written, unless it doesn't fit and a new block (starting with a
+      // keyframe) is needed
+      for (int attempt = 0; attempt < 2; attempt++) {
+        size_t size = encoder.begin_packet(packet, snapshot.sequence, snapshot.timestamp);
+        size += encoder.encode(snapshot.motion, packet + size);
+        size += encoder.encode(snapshot.errors, packet + size);
+        size += encoder.encode(snapshot.state, packet + size);
+        size += encoder.encode(snapshot.can, packet + size);
+        size += encoder.encode(snapshot.pru, packet + size);
+        size += encoder.encode(snapshot.i2c, packet + size);
+        size += encoder.encode(snapshot.adc, packet + size);
+        Telemetry::finish_packet(packet, size);
+        if (block != nullptr && used + FLIGHT_RECORDER_ENTRY_HEADER_SIZE + size <=
+            FLIGHT_RECORDER_BLOCK_SIZE - FLIGHT_RECORDER_BLOCK_HEADER_SIZE) {
+          write_entry(FLIGHT_RECORD_SNAPSHOT, packet, size);
+          break;
+        }
+        start_block();
+      }
+      snapshots++;
+      if (first_timestamp < 0) {
+        first_timestamp = snapshot.timestamp;
+      }
+      last_timestamp = snapshot.timestamp;
+      has_snapshot = false;
+    }
+  }
+}
+
+void FlightRecorder::write_entry(uint8_t kind, const uint8_t * payload, size_t size) {
+  uint8_t * out = block + FLIGHT_RECORDER_BLOCK_HEADER_SIZE + used;
+  out[0] = kind;
+  put<uint16_t>(out + 1, (uint16_t) size);
+  memcpy(out + FLIGHT_RECORDER_ENTRY_HEADER_SIZE, payload, size);
+  used += FLIGHT_RECORDER_ENTRY_HEADER_SIZE + size;
+  entries++;
+  std::atomic_thread_fence(std::memory_order_release);  // The entry is there before the block header counts it
+  put<uint32_t>(block + 8, (uint32_t) used);
+  put<uint32_t>(block + 12, entries);
+  bytes.fetch_add(FLIGHT_RECORDER_ENTRY_HEADER_SIZE + size);
+}
+
+void FlightRecorder::start_block() {
+  if (block != nullptr) {
+    msync(block, FLIGHT_RECORDER_BLOCK_SIZE, MS_ASYNC);  // Finished, start it on its way to the disk
+  }
+  sequence++;
+  block = map + FLIGHT_RECORDER_HEADER_SIZE + ((sequence - 1) % block_total) * FLIGHT_RECORDER_BLOCK_SIZE;
+  // Marked unwritten while it is emptied, so a reader never mixes the oldest block's entries with new ones
+  put<uint32_t>(block + 4, 0);
+  std::atomic_thread_fence(std::memory_order_release);
+  put<uint32_t>(block, FLIGHT_RECORDER_BLOCK_MAGIC);
+  put<uint32_t>(block + 8, 0);
+  put<uint32_t>(block + 12, 0);
+  std::atomic_thread_fence(std::memory_order_release);
+  put<uint32_t>(block + 4, sequence);
+  used = 0;
+  entries = 0;
+  encoder.request_keyframe();  // So the block decodes without the one it overwrote
+  blocks++;
+}
+
+void FlightRecorder::print_stats() {
+  uint64_t total = bytes.load();
+  uint64_t count = snapshots.load();
+  print(LogLevel::LOG_INFO, "flight_recorder: %lu snapshots, %lu commands, %lu dropped, %lu bytes "
+        "(%.1f bytes/snapshot), %lu blocks of %lu\n", (unsigned long) count, (unsigned long) commands.load(),
+        (unsigned long) dropped.load(), (unsigned long) total, count > 0 ? (double) total / (double) count : 0.0,
+        (unsigned long) blocks.load(), (unsigned long) block_total);  // NOLINT
+  double seconds = (double) (last_timestamp - first_timestamp) / 1000000.0;
+  if (total > 0 && seconds > 0) {
+    double capacity = (double) (block_total * (FLIGHT_RECORDER_BLOCK_SIZE - FLIGHT_RECORDER_BLOCK_HEADER_SIZE));
+    print(LogLevel::LOG_INFO, "flight_recorder: %.0f bytes/s, the file holds the last %.1f s at this rate\n",
+          (double) total / seconds, capacity / ((double) total / seconds));
+  }
+}
+
+bool FlightRecordReader::open(const std::string & path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  corrupt = 0;
+  order.clear();
+  if (file.size() < FLIGHT_RECORDER_HEADER_SIZE || get<uint32_t>(file.data()) != FLIGHT_RECORDER_MAGIC) {
+    return false;
+  }
+  block_size = get<uint32_t>(&file[8]);
+  size_t count = get<uint32_t>(&file[12]);
+  start_time = get<int64_t>(&file[16]);
+  if (block_size <= FLIGHT_RECORDER_BLOCK_HEADER_SIZE) {
+    return false;
+  }
+
+  std::vector<std::pair<uint32_t, size_t>> written;  // Sequence, offset
+  for (size_t i = 0; i < count; i++) {
+    size_t at = FLIGHT_RECORDER_HEADER_SIZE + i * block_size;
+    if (at + block_size > file.size()) {
+      break;  // Cut short
+    }
+    uint32_t block_sequence = get<uint32_t>(&file[at + 4]);
+    if (get<uint32_t>(&file[at]) == FLIGHT_RECORDER_BLOCK_MAGIC && block_sequence != 0) {
+      written.push_back(std::make_pair(block_sequence, at));
+    }
+  }
+  std::sort(written.begin(), written.end());
+  for (auto & block : written) {
+    order.push_back(block.second);
+  }
+  current = 0;
+  offset = FLIGHT_RECORDER_BLOCK_HEADER_SIZE;
+  memset(&last, 0, sizeof(last));
+  return true;
+}
+
+bool FlightRecordReader::next(Entry * entry) {
+  while (current < order.size()) {
+    const uint8_t * block = &file[order[current]];
+    size_t end = FLIGHT_RECORDER_BLOCK_HEADER_SIZE +
+                 std::min((size_t) get<uint32_t>(block + 8), block_size - FLIGHT_RECORDER_BLOCK_HEADER_SIZE);
+    if (offset + FLIGHT_RECORDER_ENTRY_HEADER_SIZE > end) {
+      current++;
+      offset = FLIGHT_RECORDER_BLOCK_HEADER_SIZE;
+      memset(&last, 0, sizeof(last));  // The next block starts with a keyframe
+      continue;
+    }
+    uint8_t kind = block[offset];
+    size_t length = get<uint16_t>(block + offset + 1);
+    const uint8_t * payload = block + offset + FLIGHT_RECORDER_ENTRY_HEADER_SIZE;
+    bool ok = offset + FLIGHT_RECORDER_ENTRY_HEADER_SIZE + length <= end;
+    offset += FLIGHT_RECORDER_ENTRY_HEADER_SIZE + length;
+    if (ok && kind == FLIGHT_RECORD_SNAPSHOT) {
+      ok = decode_snapshot(payload, length, entry);
+    } else if (ok && kind == FLIGHT_RECORD_COMMAND && length >= COMMAND_SIZE) {
+      entry->kind = FLIGHT_RECORD_COMMAND;
+      entry->timestamp = get<int64_t>(payload);
+      entry->command.id = get<uint32_t>(payload + 8);
+      entry->command.value = get<uint32_t>(payload + 12);
+    } else {
+      ok = false;
+    }
+    if (ok) {
+      return true;
+    }
+    corrupt++;
+    offset = end;  // Nothing after it can be trusted
+  }
+  return false;
+}
+
+bool FlightRecordReader::decode_snapshot(const uint8_t * data, size_t size, Entry * entry) {
+  Telemetry::Header header;
+  if (!Telemetry::decode_header(data, size, &header) || TELEMETRY_HEADER_SIZE + (size_t) header.length > size) {
+    return false;
+  }
+  size_t at = TELEMETRY_HEADER_SIZE;
+  size_t end = at + header.length;
+  while (at + TELEMETRY_RECORD_HEADER_SIZE <= end) {
+    uint8_t type = data[at];
+    size_t length = get<uint16_t>(data + at + 1);
+    at += TELEMETRY_RECORD_HEADER_SIZE;
+    if (at + length > end) {
+      return false;
+    }
+    const uint8_t * fields = data + at;
+    bool delta = (type & TELEMETRY_DELTA) != 0;
+    bool ok = true;
+    switch (type & ~TELEMETRY_DELTA) {
+      case Telemetry::MOTION:
+        ok = read_record(fields, length, delta, &last.motion);
+        break;
+      case Telemetry::ERRORS:
+        ok = read_record(fields, length, delta, &last.errors);
+        break;
+      case Telemetry::STATE: {
+        Telemetry::StateData state = {last.state};
+        ok = read_record(fields, length, delta, &state);
+        last.state = state.state;
+        break;
+      }
+      case Telemetry::CAN:
+        ok = read_record(fields, length, delta, &last.can);
+        break;
+      case Telemetry::PRU:
+        ok = read_record(fields, length, delta, &last.pru);
+        break;
+      case Telemetry::I2C:
+        ok = read_record(fields, length, delta, &last.i2c);
+        break;
+      case Telemetry::ADC:
+        ok = read_record(fields, length, delta, &last.adc);
+        break;
+      default:
+        break;  // Not part of a snapshot, skipped like any unknown record
+    }
+    if (!ok) {
+      return false;
+    }
+    at += length;
+  }
+  last.sequence = header.sequence;
+  last.timestamp = header.timestamp;
+  entry->kind = FLIGHT_RECORD_SNAPSHOT;
+  entry->timestamp = header.timestamp;
+  entry->snapshot = last;
+  return true;
+}
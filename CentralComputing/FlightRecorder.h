@@ -0,0 +1,185 @@
+#ifndef FLIGHTRECORDER_H_
+#define FLIGHTRECORDER_H_
+
+#include "Command.h"
+#include "Defines.hpp"
+#include "Event.h"
+#include "MPSCRing.hpp"
+#include "Telemetry.h"
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread> // NOLINT
+#include <vector>
+
+// Records every UnifiedState snapshot and every command the logic loop sees, at full rate, so a run can be
+// looked at afterwards in more detail than the telemetry the base station got (see Pod::logic_loop())
+//
+// The logic loop only copies into lock free queues (record() never blocks, a full queue drops and counts).
+// A writer thread empties them every FLIGHT_RECORDER_WRITE_PERIOD into a file preallocated at open() and
+// mapped into memory, so storage is never waited on and the disk can't fill up mid run.
+//
+// File: [header, FLIGHT_RECORDER_HEADER_SIZE bytes][block][block]...  every number little endian
+//   header
+//     uint32_t magic             FLIGHT_RECORDER_MAGIC
+//     uint16_t version           FLIGHT_RECORDER_VERSION
+//     uint16_t telemetry_version TELEMETRY_VERSION, the snapshots are telemetry packets
+//     uint32_t block_size        bytes, FLIGHT_RECORDER_BLOCK_SIZE
+//     uint32_t block_count
+//     int64_t  started           wall clock microseconds since the epoch, to line the recording up with other logs
+//   block, used as a ring: once every block has been written the oldest is overwritten
+//     uint32_t magic             FLIGHT_RECORDER_BLOCK_MAGIC
+//     uint32_t sequence          1 for the first block written, 0 if never written
+//     uint32_t used              bytes of entries after the block header, only ever grows while it is written
+//     uint32_t entries
+//     entries, never split across blocks
+//   entry
+//     uint8_t  kind              FLIGHT_RECORD_SNAPSHOT or FLIGHT_RECORD_COMMAND
+//     uint16_t length            bytes after the entry header
+//     FLIGHT_RECORD_SNAPSHOT: a telemetry packet (Telemetry.h), deltas against the block's previous snapshot.
+//                             The first snapshot of a block is a keyframe, so every block decodes on its own.
+//                             Its sequence counts every snapshot recorded, a gap is one the queue dropped
+//     FLIGHT_RECORD_COMMAND:  int64_t timestamp (Utils::microseconds()), uint32_t id, uint32_t value
+#define FLIGHT_RECORDER_MAGIC 0x31434552        // "REC1"
+#define FLIGHT_RECORDER_BLOCK_MAGIC 0x4B4C4252  // "RBLK"
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_HEADER_SIZE 4096        // A page, so every block is page aligned
+#define FLIGHT_RECORDER_BLOCK_HEADER_SIZE 16
+#define FLIGHT_RECORDER_ENTRY_HEADER_SIZE 3
+#define FLIGHT_RECORDER_BLOCK_SIZE 65536
+#define FLIGHT_RECORDER_QUEUE_SIZE 512          // Snapshots waiting for the writer, half a second at 1 kHz
+#define FLIGHT_RECORDER_COMMAND_QUEUE_SIZE 1024
+#define FLIGHT_RECORDER_WRITE_PERIOD 10000      // Microseconds between writer passes
+
+enum FlightRecordKind : uint8_t {
+  FLIGHT_RECORD_SNAPSHOT = 1,
+  FLIGHT_RECORD_COMMAND = 2
+};
+
+class FlightRecorder {
+ public:
+  // What the logic loop had at the end of one iteration
+  struct Snapshot {
+    uint32_t sequence;  // Counts every snapshot recorded, so a gap shows one was dropped
+    int64_t timestamp;  // Utils::microseconds()
+    MotionData motion;
+    ADCData adc;
+    CANData can;
+    I2CData i2c;
+    PRUData pru;
+    Errors errors;
+    E_States state;
+  };
+
+  struct CommandRecord {
+    uint32_t before;    // Sequence of the snapshot recorded after it
+    int64_t timestamp;  // Utils::microseconds()
+    Command::Network_Command command;
+  };
+
+  FlightRecorder();
+  ~FlightRecorder();
+
+  /*
+   * Creates (or starts over) the file at path with room for size bytes of blocks, maps it and starts the writer
+   * @return false if the file could not be created, preallocated or mapped
+   */
+  bool open(const std::string & path, size_t size);
+
+  /*
+   * Writes out everything queued, stops the writer and syncs and unmaps the file
+   */
+  void close();
+
+  bool is_open() const { return recording.load(); }
+
+  /*
+   * Queues a snapshot/ command for the writer. Never blocks
+   * @return false if not open, or the queue was full and it was dropped
+   */
+  bool record(const UnifiedState & state);
+  bool record(const Command::Network_Command & command);
+
+  // Since open()
+  std::atomic<uint64_t> snapshots;  // Written to the file
+  std::atomic<uint64_t> commands;
+  std::atomic<uint64_t> dropped;    // Queue was full
+  std::atomic<uint64_t> bytes;      // Of entries, headers included
+  std::atomic<uint64_t> blocks;     // Started, more than block_count() once it has wrapped
+
+  size_t block_count() const { return block_total; }
+
+  /*
+   * Prints the counters, and how many seconds of recording the file holds at the rate seen so far
+   */
+  void print_stats();
+
+ private:
+  void write_loop();
+  void drain();  // Writes out everything queued, oldest first
+  void write_entry(uint8_t kind, const uint8_t * payload, size_t size);
+  void start_block();
+
+  MPSCRing<Snapshot, FLIGHT_RECORDER_QUEUE_SIZE> snapshot_queue;
+  MPSCRing<CommandRecord, FLIGHT_RECORDER_COMMAND_QUEUE_SIZE> command_queue;
+  std::atomic<bool> recording;
+  std::atomic<uint32_t> next_sequence;  // Of the next snapshot recorded
+  Event closing;
+  std::thread writer;
+
+  // Writer thread only
+  int fd;
+  uint8_t * map;
+  size_t map_size;
+  size_t block_total;
+  uint32_t sequence;  // Of the block being written
+  uint8_t * block;
+  size_t used;
+  uint32_t entries;
+  int64_t first_timestamp;
+  int64_t last_timestamp;
+  Telemetry::Encoder encoder;
+  uint8_t packet[Telemetry::MAX_PACKET_SIZE];
+};
+
+// Reads a recording back, oldest entry first. Works on a file still being written, or cut short by a crash,
+// up to the last entry written completely
+class FlightRecordReader {
+ public:
+  struct Entry {
+    FlightRecordKind kind;
+    int64_t timestamp;
+    FlightRecorder::Snapshot snapshot;  // FLIGHT_RECORD_SNAPSHOT: the whole state, deltas applied
+    Command::Network_Command command;   // FLIGHT_RECORD_COMMAND
+  };
+
+  FlightRecordReader() : corrupt(0), start_time(0), block_size(0), current(0), offset(0) {}
+
+  /*
+   * Reads the whole file in
+   * @return false if it can't be read or isn't a recording
+   */
+  bool open(const std::string & path);
+
+  /*
+   * @return false once every entry has been read
+   */
+  bool next(Entry * entry);
+
+  int64_t started() const { return start_time; }  // Wall clock microseconds since the epoch
+  size_t blocks() const { return order.size(); }   // Written, in the ring
+  uint64_t corrupt;  // Entries (and the rest of their block) skipped because they didn't make sense
+
+ private:
+  bool decode_snapshot(const uint8_t * data, size_t size, Entry * entry);
+
+  std::vector<uint8_t> file;
+  std::vector<size_t> order;  // Offsets of the blocks, oldest first
+  int64_t start_time;
+  size_t block_size;
+  size_t current;  // Index into order
+  size_t offset;   // Of the next entry in the current block
+  FlightRecorder::Snapshot last;
+};
+
+#endif  // FLIGHTRECORDER_H_
@@ -0,0 +1,138 @@
+#ifndef HISTORY_RING_HPP
+#define HISTORY_RING_HPP
+
+#include "SeqLock.hpp"
+#include "Defines.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// What a SourceManager publishes: the data plus when it was captured
+template <class Data>
+struct Sample {
+  SampleHeader header;
+  Data data;
+};
+
+// Summary of one value over a window of samples, see HistoryRing::stats()
+struct WindowStats {
+  size_t count;
+  double mean;
+  double min;
+  double max;
+  double variance;  // Population variance
+};
+
+// Fixed size history of the most recent samples from one producer, readable from any number of threads
+//
+// Each slot is its own SeqLock, so the writer never waits on readers and readers never block the writer.
+// Sample i (counting from 0) always lands in slot i % N, so a slot that has been written k times holds
+// sample (k - 1) * N + slot. A reader that finds a slot already holding a newer sample than the one it asked for
+// knows the writer lapped it, and stops there instead of returning a mix of old and new history.
+template <class Data, size_t N>
+class HistoryRing {
+ public:
+  HistoryRing() : count(0) {}
+
+  /*
+   * Append a sample, overwriting the oldest once full. Only ONE thread may call push()
+   */
+  void push(const Sample<Data> & sample) {
+    uint64_t index = count.load(std::memory_order_relaxed);
+    slots[index % N].store(sample);
+    count.store(index + 1, std::memory_order_release);
+  }
+
+  /*
+   * Number of samples pushed so far (only the last N are kept)
+   */
+  uint64_t size() const {
+    return count.load(std::memory_order_acquire);
+  }
+
+  /*
+   * Copies up to n of the most recent samples into out, oldest first
+   * @return number of samples copied
+   */
+  size_t last(size_t n, Sample<Data> * out) const {
+    Sample<Data> sample;
+    uint64_t newest = count.load(std::memory_order_acquire);
+    size_t copied = 0;
+    // Walk backwards from the newest, then flip so the caller gets them in order
+    while (copied < n && copied < N && copied < newest && read(newest - 1 - copied, &sample)) {
+      out[copied++] = sample;
+    }
+    reverse(out, copied);
+    return copied;
+  }
+
+  /*
+   * Copies the samples captured after timestamp (see SampleHeader), oldest first, up to max_samples of them
+   * @return number of samples copied
+   */
+  size_t since(int64_t timestamp, Sample<Data> * out, size_t max_samples) const {
+    Sample<Data> sample;
+    uint64_t newest = count.load(std::memory_order_acquire);
+    size_t copied = 0;
+    while (copied < max_samples && copied < N && copied < newest && read(newest - 1 - copied, &sample) &&
+           sample.header.timestamp > timestamp) {
+      out[copied++] = sample;
+    }
+    reverse(out, copied);
+    return copied;
+  }
+
+  /*
+   * Mean/min/max/variance of field(data) over the last n samples captured after timestamp.
+   * Pass timestamp 0 for just the last n, or n = N for everything since timestamp
+   * @param field callable taking a const Data & and returning the value to summarize
+   */
+  template <class Field>
+  WindowStats stats(size_t n, int64_t timestamp, Field field) const {
+    WindowStats ret = {0, 0.0, 0.0, 0.0, 0.0};
+    double m2 = 0;  // Welford's running sum of squared differences
+    Sample<Data> sample;
+    uint64_t newest = count.load(std::memory_order_acquire);
+    while (ret.count < n && ret.count < N && ret.count < newest && read(newest - 1 - ret.count, &sample) &&
+           sample.header.timestamp > timestamp) {
+      double value = static_cast<double>(field(sample.data));
+      ret.count++;
+      if (ret.count == 1) {
+        ret.min = value;
+        ret.max = value;
+      }
+      ret.min = std::fmin(ret.min, value);
+      ret.max = std::fmax(ret.max, value);
+      double delta = value - ret.mean;
+      ret.mean += delta / static_cast<double>(ret.count);
+      m2 += delta * (value - ret.mean);
+    }
+    if (ret.count > 0) {
+      ret.variance = m2 / static_cast<double>(ret.count);
+    }
+    return ret;
+  }
+
+  static const size_t CAPACITY = N;
+
+ private:
+  // Copies sample index into out. False if it has already been overwritten
+  bool read(uint64_t index, Sample<Data> * out) const {
+    uint32_t writes = slots[index % N].load(out);
+    return writes == index / N + 1;
+  }
+
+  static void reverse(Sample<Data> * samples, size_t n) {
+    for (size_t i = 0; i < n / 2; i++) {
+      Sample<Data> tmp = samples[i];
+      samples[i] = samples[n - 1 - i];
+      samples[n - 1 - i] = tmp;
+    }
+  }
+
+  SeqLock<Sample<Data>> slots[N];
+  std::atomic<uint64_t> count;
+};
+
+#endif  // HISTORY_RING_HPP
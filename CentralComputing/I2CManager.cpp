@@ -322,7 +322,7 @@ std::shared_ptr<I2CData> I2CManager::refresh() {
   old_data->temp[index] = value;
 
   // duplicate the "old_data" here into the "new_data"
-  std::shared_ptr<I2CData> new_data = std::make_shared<I2CData>(*old_data);
+  std::shared_ptr<I2CData> new_data = DataPool::make<I2CData>(*old_data);
 
   // new_data contains both the new and old readings.
   return new_data;
@@ -0,0 +1,93 @@
+#include "LatencyHistogram.h"
+#include "Utils.h"
+#include <time.h>
+
+using Utils::print;
+using Utils::LogLevel;
+
+LatencyHistogram::LatencyHistogram() {
+  reset();
+}
+
+int64_t LatencyHistogram::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Values below SUB_BUCKETS map 1:1 onto bucket 0.
+// Above that, bucket b holds [2^(b+3), 2^(b+4)) split into SUB_BUCKETS linear steps
+int LatencyHistogram::index_of(int64_t value) {
+  uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+  if (v < SUB_BUCKETS) {
+    return static_cast<int>(v);
+  }
+  int msb = 63 - __builtin_clzll(v);
+  int bucket = msb - SUB_BUCKET_BITS + 1;
+  int sub = static_cast<int>((v >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+  return bucket * SUB_BUCKETS + sub;
+}
+
+int64_t LatencyHistogram::upper_bound_of(int index) {
+  int bucket = index / SUB_BUCKETS;
+  int64_t sub = index % SUB_BUCKETS;
+  if (bucket == 0) {
+    return sub;
+  }
+  return ((SUB_BUCKETS + sub + 1) << (bucket - 1)) - 1;
+}
+
+void LatencyHistogram::record(int64_t nanos) {
+  counts[index_of(nanos)].fetch_add(1, std::memory_order_relaxed);
+  total_count.fetch_add(1, std::memory_order_relaxed);
+  total_sum.fetch_add(nanos, std::memory_order_relaxed);
+  int64_t current = max_value.load(std::memory_order_relaxed);
+  while (nanos > current && !max_value.compare_exchange_weak(current, nanos, std::memory_order_relaxed)) {}
+}
+
+uint64_t LatencyHistogram::count() {
+  return total_count.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::max() {
+  return max_value.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::mean() {
+  uint64_t n = count();
+  return n == 0 ? 0 : total_sum.load(std::memory_order_relaxed) / static_cast<int64_t>(n);
+}
+
+int64_t LatencyHistogram::percentile(double percentile) {
+  uint64_t n = count();
+  if (n == 0) {
+    return 0;
+  }
+  uint64_t target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(n) + 0.5);
+  if (target < 1) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    seen += counts[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      return std::min(upper_bound_of(i), max());
+    }
+  }
+  return max();
+}
+
+void LatencyHistogram::reset() {
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    counts[i].store(0, std::memory_order_relaxed);
+  }
+  total_count.store(0);
+  total_sum.store(0);
+  max_value.store(0);
+}
+
+void LatencyHistogram::print(const std::string & name) {
+  Utils::print(LogLevel::LOG_INFO, "%-28s n=%-8lu mean %8.1f  p50 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f us\n",
+        name.c_str(), (unsigned long) count(), mean() / 1000.0,  // NOLINT
+        percentile(50.0) / 1000.0, percentile(99.0) / 1000.0, percentile(99.9) / 1000.0, max() / 1000.0);
+}
@@ -0,0 +1,69 @@
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+// Low overhead latency histogram (HDR style, log-linear buckets)
+//
+// Values are nanoseconds. Each power of two range is split into 16 linear sub-buckets, so any
+// recorded value is reported within ~6% while covering 1 ns to over a minute in a fixed array.
+// record() is a handful of relaxed atomic increments: no locks, no allocation, safe from any thread.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  /*
+   * Current CLOCK_MONOTONIC time in nanoseconds. Use this to take the timestamps you record
+   */
+  static int64_t now();
+
+  void record(int64_t nanos);
+
+  uint64_t count();
+  int64_t max();    // nanoseconds
+  int64_t mean();   // nanoseconds
+
+  /*
+   * Value (nanoseconds) at or below which the given fraction of samples fall
+   * @param percentile from 0.0 to 100.0
+   */
+  int64_t percentile(double percentile);
+
+  void reset();
+
+  /*
+   * Prints count, mean, p50/p99/p99.9 and max in microseconds
+   */
+  void print(const std::string & name);
+
+ private:
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int NUM_BUCKETS = 64 - SUB_BUCKET_BITS + 1;
+  static const int NUM_COUNTERS = NUM_BUCKETS * SUB_BUCKETS;
+
+  static int index_of(int64_t value);
+  static int64_t upper_bound_of(int index);
+
+  std::atomic<uint64_t> counts[NUM_COUNTERS];
+  std::atomic<uint64_t> total_count;
+  std::atomic<int64_t> total_sum;
+  std::atomic<int64_t> max_value;
+};
+
+// Records the time from construction to destruction into a histogram
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(LatencyHistogram * hist) : histogram(hist), start(LatencyHistogram::now()) {}
+  ~ScopedLatency() {
+    histogram->record(LatencyHistogram::now() - start);
+  }
+
+ private:
+  LatencyHistogram * histogram;
+  int64_t start;
+};
+
+#endif  // LATENCYHISTOGRAM_H_
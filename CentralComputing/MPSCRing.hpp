@@ -0,0 +1,130 @@
+#ifndef MPSC_RING_HPP
+#define MPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded, lock free, multiple producer single consumer queue
+//
+// A fixed array of cells, each with its own sequence number (the Vyukov bounded queue). A producer claims a
+// position with one CAS on the enqueue counter, fills in the cell, then publishes it by bumping the cell's sequence.
+// The consumer takes cells in order and hands them back to producers by moving their sequence one lap ahead.
+// No locks, and no allocation after construction. When the queue is full enqueue() fails instead of growing,
+// and the failure is counted.
+//
+// N must be a power of two. Only ONE thread may call dequeue().
+template <class T, size_t N>
+class MPSCRing {
+ public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "MPSCRing size must be a power of two");
+
+  MPSCRing() : enqueue_pos(0), dequeue_pos(0), overflow_count(0), max_size(0) {
+    for (size_t i = 0; i < N; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /*
+   * Enqueues an object. Safe from any number of threads
+   * @return false (and counts an overflow) if the queue is full
+   */
+  bool enqueue(const T & object) {
+    Cell * cell;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells[pos & MASK];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // Cell is free for this lap, try to claim it
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Cell still holds an object from the previous lap: full
+        overflow_count.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);  // Another producer got here first
+      }
+    }
+    cell->data = object;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    update_max_size(pos + 1 - dequeue_pos.load(std::memory_order_relaxed));
+    return true;
+  }
+
+  /*
+   * Dequeues the oldest object. Only ONE thread may call this
+   * @return false if the queue is empty (or the oldest object is still being written)
+   */
+  bool dequeue(T * val) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Cell * cell = &cells[pos & MASK];
+    if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+      return false;
+    }
+    *val = cell->data;
+    cell->sequence.store(pos + N, std::memory_order_release);
+    dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /*
+   * Copies the oldest object without removing it. Only the thread that calls dequeue() may call this
+   * @return false if the queue is empty
+   */
+  bool front(T * val) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Cell * cell = &cells[pos & MASK];
+    if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+      return false;
+    }
+    *val = cell->data;
+    return true;
+  }
+
+  /*
+   * Number of queued objects. Only a snapshot when producers are running
+   */
+  int size() {
+    size_t tail = dequeue_pos.load(std::memory_order_relaxed);
+    size_t head = enqueue_pos.load(std::memory_order_relaxed);
+    return head > tail ? static_cast<int>(head - tail) : 0;
+  }
+
+  // Counters, safe to read from any thread
+  uint64_t overflows() { return overflow_count.load(std::memory_order_relaxed); }  // enqueue() calls that failed
+  int high_water() { return static_cast<int>(max_size.load(std::memory_order_relaxed)); }  // Largest size() seen
+
+  void reset_counters() {
+    overflow_count.store(0, std::memory_order_relaxed);
+    max_size.store(0, std::memory_order_relaxed);
+  }
+
+  static const size_t CAPACITY = N;
+
+ private:
+  static const size_t MASK = N - 1;
+
+  void update_max_size(size_t current) {
+    size_t seen = max_size.load(std::memory_order_relaxed);
+    while (current > seen && current <= N &&
+           !max_size.compare_exchange_weak(seen, current, std::memory_order_relaxed)) {}
+  }
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // Producers and the consumer each get their own cache line for their counter
+  alignas(64) Cell cells[N];
+  alignas(64) std::atomic<size_t> enqueue_pos;
+  alignas(64) std::atomic<size_t> dequeue_pos;
+  alignas(64) std::atomic<uint64_t> overflow_count;
+  std::atomic<size_t> max_size;
+};
+
+#endif  // MPSC_RING_HPP
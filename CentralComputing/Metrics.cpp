@@ -0,0 +1,63 @@
+#include "Metrics.h"
+#include "SourceManager.h"
+#include "Command.h"
+
+using Utils::print;
+using Utils::LogLevel;
+
+LatencyHistogram Metrics::update_unified_state;
+LatencyHistogram Metrics::motion_model;
+LatencyHistogram Metrics::steady_function;
+
+namespace {
+struct NamedHistogram {
+  const char * name;
+  LatencyHistogram * histogram;
+};
+
+// Ordered roughly by where they sit in the pipeline
+const NamedHistogram histograms[] = {
+  {"adc_refresh",          &SourceManager::ADC.refresh_latency},
+  {"can_refresh",          &SourceManager::CAN.refresh_latency},
+  {"i2c_refresh",          &SourceManager::I2C.refresh_latency},
+  {"pru_refresh",          &SourceManager::PRU.refresh_latency},
+  {"adc_error_check",      &SourceManager::ADC.error_check_latency},
+  {"can_error_check",      &SourceManager::CAN.error_check_latency},
+  {"i2c_error_check",      &SourceManager::I2C.error_check_latency},
+  {"pru_error_check",      &SourceManager::PRU.error_check_latency},
+  {"adc_sample_age",       &SourceManager::ADC.sample_age},
+  {"can_sample_age",       &SourceManager::CAN.sample_age},
+  {"i2c_sample_age",       &SourceManager::I2C.sample_age},
+  {"pru_sample_age",       &SourceManager::PRU.sample_age},
+  {"update_unified_state", &Metrics::update_unified_state},
+  {"motion_model",         &Metrics::motion_model},
+  {"steady_function",      &Metrics::steady_function},
+  {"command_wait_critical", &Command::queue_wait[Command::PRIORITY_CRITICAL]},
+  {"command_wait_error",    &Command::queue_wait[Command::PRIORITY_ERROR]},
+  {"command_wait_normal",   &Command::queue_wait[Command::PRIORITY_NORMAL]},
+};
+}  // namespace
+
+LatencyHistogram * Metrics::find(const std::string & name) {
+  for (const NamedHistogram & h : histograms) {
+    if (name == h.name) {
+      return h.histogram;
+    }
+  }
+  return nullptr;
+}
+
+void Metrics::reset_all() {
+  for (const NamedHistogram & h : histograms) {
+    h.histogram->reset();
+  }
+}
+
+void Metrics::print_all() {
+  print(LogLevel::LOG_INFO, "Pipeline latency:\n");
+  for (const NamedHistogram & h : histograms) {
+    if (h.histogram->count() > 0) {
+      h.histogram->print(h.name);
+    }
+  }
+}
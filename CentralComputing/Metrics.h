@@ -0,0 +1,34 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "LatencyHistogram.h"
+#include <string>
+
+// Latency histograms for each stage of the sensor-to-actuation pipeline
+//
+// Per SourceManager (see SourceManagerBase.hpp):
+//   <name>_refresh       refresh()
+//   <name>_error_check   check_for_sensor_error()
+//   <name>_sample_age    time from a sample being published to the logic loop picking it up
+// Logic loop (see Pod.cpp):
+//   update_unified_state, motion_model (MotionModel::calculate), steady_function
+// Command queue (see Command.h), time from Command::put() to Command::get() per priority lane:
+//   command_wait_critical, command_wait_error, command_wait_normal
+//
+// Histograms are reset when the Pod starts running and printed when it shuts down.
+namespace Metrics {
+  extern LatencyHistogram update_unified_state;
+  extern LatencyHistogram motion_model;
+  extern LatencyHistogram steady_function;
+
+  /*
+   * Looks up a histogram by the names listed above
+   * @return nullptr if there is no such histogram
+   */
+  LatencyHistogram * find(const std::string & name);
+
+  void reset_all();
+  void print_all();
+}  // namespace Metrics
+
+#endif  // METRICS_H_
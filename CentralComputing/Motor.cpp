@@ -35,6 +35,7 @@ void Motor::set_motor_state(bool enable) {
     print(LogLevel::LOG_INFO, "Motors: %s\n", enable?"Enabled":"Disabled");
     #endif
   #endif
+  Trace::actuated();
 }
 
 bool Motor::is_enabled() {
@@ -61,6 +62,7 @@ void Motor::set_throttle(int16_t value) {
     print(LogLevel::LOG_INFO, "Setting motor throttle: %d\n", value);
     #endif
   #endif
+  Trace::actuated();
   }
 }
 
@@ -78,6 +80,7 @@ void Motor::set_relay_state(HV_Relay_Select relay, HV_Relay_State state) {
   #endif
 
   relay_state_buf[relay] = state;
+  Trace::actuated();
 }
 
 void Motor::get_relay_state(char * buf) {
@@ -0,0 +1,61 @@
+#include "Notifier.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+
+Notifier Notifications::logic_loop;
+
+namespace {
+// std::atomic<int32_t> is a plain int32_t underneath on Linux, which is what the futex calls operate on
+int futex(std::atomic<int32_t> * word, int op, int32_t value, const struct timespec * timeout) {
+  return static_cast<int>(syscall(SYS_futex, reinterpret_cast<int32_t *>(word), op, value, timeout, nullptr,
+                                  FUTEX_BITSET_MATCH_ANY));
+}
+}  // namespace
+
+Notifier::Notifier() : pending(0), notified_count(0), timeout_count(0) {}
+
+void Notifier::notify() {
+  if (pending.exchange(1, std::memory_order_release) == 0) {
+    futex(&pending, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+  }
+}
+
+bool Notifier::wait_until(int64_t monotonic_nanos) {
+  struct timespec deadline;
+  deadline.tv_sec = monotonic_nanos / 1000000000;
+  deadline.tv_nsec = monotonic_nanos % 1000000000;
+  while (true) {
+    if (pending.exchange(0, std::memory_order_acquire) != 0) {
+      notified_count.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    // Only sleeps if pending is still 0, so a notify() between the exchange and here isn't missed.
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline (plain FUTEX_WAIT is relative)
+    int rc = futex(&pending, FUTEX_WAIT_BITSET_PRIVATE, 0, &deadline);
+    if (rc < 0 && errno == ETIMEDOUT) {
+      if (pending.exchange(0, std::memory_order_acquire) != 0) {
+        notified_count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      timeout_count.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    // Woken, interrupted, or pending was already set (EAGAIN). Check again
+  }
+}
+
+void Notifier::reset() {
+  pending.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Notifier::notified_wakeups() {
+  return notified_count.load(std::memory_order_relaxed);
+}
+
+uint64_t Notifier::timeouts() {
+  return timeout_count.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+#ifndef NOTIFIER_H_
+#define NOTIFIER_H_
+
+#include <stdint.h>
+#include <atomic>
+
+// Lets any number of threads tell one waiting thread "something changed"
+//
+// A single futex word: notify() sets it, wait_until() clears it. Notifications that arrive while
+// nobody is waiting aren't lost, the next wait_until() returns right away. Several notifications before
+// the waiter runs collapse into one, the waiter is expected to check everything it cares about when it wakes.
+// notify() only makes a system call when the word goes from clear to set.
+class Notifier {
+ public:
+  Notifier();
+
+  /*
+   * Wakes the waiter, or makes its next wait_until() return immediately
+   */
+  void notify();
+
+  /*
+   * Sleeps until notify() is called or an absolute CLOCK_MONOTONIC time (nanoseconds) passes
+   * @return true if notified, false on timeout
+   */
+  bool wait_until(int64_t monotonic_nanos);
+
+  /*
+   * Clears any pending notification
+   */
+  void reset();
+
+  // Counters, safe to read from any thread
+  uint64_t notified_wakeups();  // wait_until() calls that returned true
+  uint64_t timeouts();          // wait_until() calls that returned false
+
+ private:
+  std::atomic<int32_t> pending;
+  std::atomic<uint64_t> notified_count;
+  std::atomic<uint64_t> timeout_count;
+};
+
+// Everything that should make the logic loop run early (new sensor data, commands, shutdown), see Pod::logic_loop()
+namespace Notifications {
+  extern Notifier logic_loop;
+}  // namespace Notifications
+
+#endif  // NOTIFIER_H_
@@ -0,0 +1,146 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+
+// Fixed capacity pool used to hand out shared_ptrs without touching the heap
+//
+// Every SourceManager's refresh() (and the Simulator/Scenario hooks feeding it) creates a new Data object
+// each cycle. On the single core BBB a malloc/free per cycle shows up directly as loop jitter, so the
+// objects come out of a pool instead. There is one pool per Data type, which in practice means
+// one pool per SourceManager.
+//
+// The shared_ptr control block is allocated together with the object (allocate_shared), so a slot
+// holds both. Slots are claimed with a CAS on a bitmap, so allocate/release are lock free and can
+// happen from any thread. If the pool is exhausted it falls back to the heap and counts a miss.
+template <class T, size_t N = 16>
+class ObjectPool {
+ public:
+  static_assert(N <= 32, "ObjectPool uses a 32 bit free mask");
+
+  // The pool is intentionally leaked. shared_ptrs handed out from it may outlive any static
+  // destructor ordering (ex: Scenario objects held by the Simulator)
+  static ObjectPool & instance() {
+    static ObjectPool * pool = new ObjectPool();
+    return *pool;
+  }
+
+  /*
+   * Returns a zeroed object
+   */
+  std::shared_ptr<T> make() {
+    std::shared_ptr<T> ret = std::allocate_shared<T>(Allocator<T>(this));
+    memset(ret.get(), (uint8_t)0, sizeof(T));
+    return ret;
+  }
+
+  /*
+   * Returns a copy of value
+   */
+  std::shared_ptr<T> make(const T & value) {
+    return std::allocate_shared<T>(Allocator<T>(this), value);
+  }
+
+  /*
+   * Number of slots currently handed out
+   */
+  int in_use() {
+    return __builtin_popcount(used.load(std::memory_order_relaxed));
+  }
+
+  /*
+   * Number of allocations that didn't fit in the pool and went to the heap
+   */
+  uint64_t misses() {
+    return miss_count.load(std::memory_order_relaxed);
+  }
+
+  // Minimal allocator so allocate_shared places the control block + object in a slot.
+  // Rebinding keeps the pool pointer, the control block type is what actually gets allocated.
+  template <class U>
+  struct Allocator {
+    typedef U value_type;
+    template <class V> struct rebind { typedef Allocator<V> other; };
+
+    explicit Allocator(ObjectPool * p) : pool(p) {}
+    template <class V> Allocator(const Allocator<V> & other) : pool(other.pool) {}  // NOLINT
+
+    U * allocate(size_t n) {
+      return static_cast<U *>(pool->allocate(n * sizeof(U)));
+    }
+
+    void deallocate(U * p, size_t) {
+      pool->deallocate(p);
+    }
+
+    template <class V> bool operator==(const Allocator<V> & other) const { return pool == other.pool; }
+    template <class V> bool operator!=(const Allocator<V> & other) const { return pool != other.pool; }
+
+    ObjectPool * pool;
+  };
+
+ private:
+  ObjectPool() : used(0), miss_count(0) {}
+
+  // Room for the shared_ptr control block that sits in front of the object
+  static const size_t CONTROL_BLOCK_SIZE = 64;
+  static const size_t SLOT_SIZE = sizeof(T) + CONTROL_BLOCK_SIZE;
+
+  struct Slot {
+    alignas(alignof(std::max_align_t)) unsigned char bytes[SLOT_SIZE];
+  };
+
+  void * allocate(size_t bytes) {
+    if (bytes <= SLOT_SIZE) {
+      uint32_t mask = used.load(std::memory_order_relaxed);
+      while (true) {
+        uint32_t free_slots = ~mask & FULL_MASK;
+        if (free_slots == 0) {
+          break;
+        }
+        uint32_t bit = free_slots & (~free_slots + 1);  // lowest free slot
+        if (used.compare_exchange_weak(mask, mask | bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+          return slots[__builtin_ctz(bit)].bytes;
+        }
+      }
+    }
+    miss_count.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(bytes);
+  }
+
+  void deallocate(void * p) {
+    Slot * slot = static_cast<Slot *>(p);
+    if (slot >= slots && slot < slots + N) {
+      uint32_t bit = 1u << (slot - slots);
+      used.fetch_and(~bit, std::memory_order_release);
+    } else {
+      ::operator delete(p);
+    }
+  }
+
+  static const uint32_t FULL_MASK = (N == 32) ? 0xFFFFFFFFu : ((1u << (N % 32)) - 1);
+
+  Slot slots[N];
+  std::atomic<uint32_t> used;
+  std::atomic<uint64_t> miss_count;
+};
+
+// Shorthand used by the SourceManagers, Simulator and Scenarios
+namespace DataPool {
+  template <class Data>
+  std::shared_ptr<Data> make() {
+    return ObjectPool<Data>::instance().make();
+  }
+
+  template <class Data>
+  std::shared_ptr<Data> make(const Data & value) {
+    return ObjectPool<Data>::instance().make(value);
+  }
+}  // namespace DataPool
+
+#endif  // OBJECT_POOL_HPP
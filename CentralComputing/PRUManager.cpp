@@ -138,8 +138,7 @@ std::shared_ptr<PRUData> PRUManager::refresh() {
 
 
   // Store in shared_ptr
-  std::shared_ptr<PRUData> ret_data = std::make_shared<PRUData>();
-  *ret_data = new_data;
+  std::shared_ptr<PRUData> ret_data = DataPool::make<PRUData>(new_data);
 
   return ret_data;
 }
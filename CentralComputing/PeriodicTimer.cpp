@@ -0,0 +1,99 @@
+#include "PeriodicTimer.h"
+#include "Utils.h"
+#include <time.h>
+
+using Utils::print;
+using Utils::LogLevel;
+
+PeriodicTimer::PeriodicTimer() :
+  period(0), deadline(0), tick_count(0), overrun_count(0), max_lateness(0), total_lateness(0) {
+}
+
+int64_t PeriodicTimer::monotonic_nanos() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+void PeriodicTimer::start(int64_t period_micros) {
+  period = period_micros * 1000;
+  deadline = monotonic_nanos() + period;
+  tick_count.store(0);
+  overrun_count.store(0);
+  max_lateness.store(0);
+  total_lateness.store(0);
+}
+
+void PeriodicTimer::set_period(int64_t period_micros) {
+  if (period_micros * 1000 != period) {
+    deadline += period_micros * 1000 - period;
+    period = period_micros * 1000;
+  }
+}
+
+int64_t PeriodicTimer::next_deadline() {
+  int64_t now = monotonic_nanos();
+  if (now > deadline && period > 0) {
+    // Missed at least one deadline. Skip ahead to the next one in the future
+    int64_t missed = (now - deadline) / period + 1;
+    overrun_count.fetch_add(static_cast<uint64_t>(missed));
+    deadline += missed * period;
+  }
+  return deadline;
+}
+
+void PeriodicTimer::record_wakeup(int64_t target) {
+  int64_t lateness = monotonic_nanos() - target;
+  if (lateness < 0) {
+    lateness = 0;  // Woken early (shutdown)
+  }
+  tick_count++;
+  total_lateness += lateness;
+  if (lateness > max_lateness.load()) {
+    max_lateness.store(lateness);  // Only the owning thread writes this
+  }
+  deadline = target + period;
+}
+
+void PeriodicTimer::wait() {
+  int64_t target = next_deadline();
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(target / 1000000000LL);
+  ts.tv_nsec = static_cast<long>(target % 1000000000LL);  // NOLINT
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+  record_wakeup(target);
+}
+
+void PeriodicTimer::wait(Event * wake) {
+  int64_t target = next_deadline();
+  wake->wait_until(target);
+  record_wakeup(target);
+}
+
+int64_t PeriodicTimer::remaining() {
+  int64_t left = deadline - monotonic_nanos();
+  return left > 0 ? left / 1000 : 0;
+}
+
+uint64_t PeriodicTimer::ticks() {
+  return tick_count.load();
+}
+
+uint64_t PeriodicTimer::overruns() {
+  return overrun_count.load();
+}
+
+int64_t PeriodicTimer::max_jitter() {
+  return max_lateness.load() / 1000;
+}
+
+int64_t PeriodicTimer::mean_jitter() {
+  uint64_t count = tick_count.load();
+  return count == 0 ? 0 : total_lateness.load() / static_cast<int64_t>(count) / 1000;
+}
+
+void PeriodicTimer::print_stats(const std::string & name) {
+  print(LogLevel::LOG_INFO, "%s timer: period %ld us, %lu ticks, %lu overruns, jitter mean %ld us max %ld us\n",
+                            name.c_str(), (long) (period / 1000), (unsigned long) ticks(),  // NOLINT
+                            (unsigned long) overruns(), (long) mean_jitter(), (long) max_jitter());  // NOLINT
+}
@@ -0,0 +1,75 @@
+#ifndef PERIODICTIMER_H_
+#define PERIODICTIMER_H_
+
+#include "Event.h"
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+// Drift free periodic scheduling for the pod's loops
+//
+// Deadlines are absolute CLOCK_MONOTONIC times: deadline[n+1] = deadline[n] + period, so the time
+// spent doing work doesn't add on to the period the way Event::wait_for(period) does.
+// If a deadline was already missed when wait() is called, it counts an overrun and skips ahead to the
+// next deadline in the future, instead of running a burst of back to back iterations to catch up.
+//
+// Lateness (how long after its deadline the loop actually woke up) is recorded as the jitter.
+class PeriodicTimer {
+ public:
+  PeriodicTimer();
+
+  /*
+   * Sets the period, makes the first deadline one period from now, and clears the counters
+   */
+  void start(int64_t period_micros);
+
+  /*
+   * Changes the period, takes effect from the next deadline
+   */
+  void set_period(int64_t period_micros);
+
+  /*
+   * Sleeps until the next deadline with clock_nanosleep(TIMER_ABSTIME)
+   */
+  void wait();
+
+  /*
+   * Sleeps until the next deadline, or until wake is invoked (used for shutdown)
+   */
+  void wait(Event * wake);
+
+  /*
+   * Microseconds until the next deadline (0 if already passed)
+   */
+  int64_t remaining();
+
+  // Counters, safe to read from any thread
+  uint64_t ticks();          // Deadlines waited on
+  uint64_t overruns();       // Deadlines that had already passed when wait() was called (missed periods)
+  int64_t max_jitter();      // Worst lateness in microseconds
+  int64_t mean_jitter();     // Average lateness in microseconds
+
+  /*
+   * Prints the counters, labeled with the loop's name
+   */
+  void print_stats(const std::string & name);
+
+  /*
+   * Current CLOCK_MONOTONIC time in nanoseconds
+   */
+  static int64_t monotonic_nanos();
+
+ private:
+  // Moves deadline to the next one that hasn't passed yet. Returns the deadline to sleep until
+  int64_t next_deadline();
+  void record_wakeup(int64_t deadline);
+
+  int64_t period;    // nanoseconds
+  int64_t deadline;  // absolute, nanoseconds
+  std::atomic<uint64_t> tick_count;
+  std::atomic<uint64_t> overrun_count;
+  std::atomic<int64_t> max_lateness;  // nanoseconds
+  std::atomic<int64_t> total_lateness;  // nanoseconds
+};
+
+#endif  // PERIODICTIMER_H_
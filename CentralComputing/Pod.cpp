@@ -19,61 +19,88 @@ void Pod::logic_loop() {
   bool error_processed = false;
   #endif
 
+  ThreadConfig::apply("logic_loop");
+
   // Start processing/pod logic
+  logic_timer.start(logic_loop_timeout);
+  Notifications::logic_loop.reset();
+  uint64_t notified_start = Notifications::logic_loop.notified_wakeups();
+  uint64_t timeouts_start = Notifications::logic_loop.timeouts();
   while (running.load()) {
+    // Drain up to logic_loop_command_budget commands, applying each in the order it was queued
     Command::Network_Command com;
-    bool loaded = Command::get(&com);
-
-    if (loaded) {
+    CommandTrace trace;
+    int32_t loaded = 0;
+    while (loaded < logic_loop_command_budget && Command::get(&com, &trace)) {
+      loaded++;
+      recorder.record(com);
       print(LogLevel::LOG_INFO, "Command : %d %d\n", com.id, com.value);
       print(LogLevel::LOG_INFO, "Which is: %s %s\n", Command::get_network_command_ID_string(com.id).c_str(), 
                                                      Command::get_network_command_value_string(&com).c_str());
       // Capture any bad commands before they cause a segfault
       if (com.id >= Command::Network_Command_ID::SENTINEL) {
         print(LogLevel::LOG_ERROR, "INVALID COMMAND ID: %d\n", com.id);
-        com.id = 0;
-        com.value = 0;
+        continue;
+      }
+
+      // Parse the command and call the appropriate state machine function
+      Trace::begin(trace);
+      auto transition = state_machine->get_transition_function(&com);
+      ((*state_machine).*(transition))(); 
+      Trace::transitioned();
+      #ifdef SIM  // Used to indicate to the Simulator that we have processed a command
+      if (!(com.id >= Command::Network_Command_ID::SET_ADC_ERROR &&
+            com.id <= Command::Network_Command_ID::CLR_OTHER_ERROR)) {
+        command_processed = true;  // Processed a command, not an error
       } else {
-        // Parse the command and call the appropriate state machine function
-        auto transition = state_machine->get_transition_function(&com);
-        ((*state_machine).*(transition))(); 
-        #ifdef SIM  // Used to indicate to the Simulator that we have processed a command
-        if (!(com.id >= Command::Network_Command_ID::SET_ADC_ERROR &&
-              com.id <= Command::Network_Command_ID::CLR_OTHER_ERROR)) {
-          command_processed = true;  // Processed a command, not an error
-        } else {
-          error_processed = true;  // Processed an error, not a command
-        }
-        #endif
-
-        // Set the currerent State in each Source Manager. 
-        // The SouceManagers use the state while checking for errors, to emit different errors at different times.
-        // We do this here because only after a command would the state have changed - don't need to do this every loop
-        // The SourceManagers don't have access to the StateMachine variable, and this is the easiest way of
-        // getting the state to the SMs. Also, this is the minimal ammount of updates required, and is better
-        // than the SMs accessing the state machine every single time they loop.
-        E_States current_state = state_machine->get_current_state();
-        SourceManager::PRU.set_state(current_state);
-        SourceManager::CAN.set_state(current_state);
-        SourceManager::ADC.set_state(current_state);
-        SourceManager::I2C.set_state(current_state);
+        error_processed = true;  // Processed an error, not a command
+      }
+      #endif
+
+      // Set the currerent State in each Source Manager. 
+      // The SouceManagers use the state while checking for errors, to emit different errors at different times.
+      // We do this here because only after a command would the state have changed - don't need to do this every loop
+      // The SourceManagers don't have access to the StateMachine variable, and this is the easiest way of
+      // getting the state to the SMs. Also, this is the minimal ammount of updates required, and is better
+      // than the SMs accessing the state machine every single time they loop.
+      E_States current_state = state_machine->get_current_state();
+      SourceManager::PRU.set_state(current_state);
+      SourceManager::CAN.set_state(current_state);
+      SourceManager::ADC.set_state(current_state);
+      SourceManager::I2C.set_state(current_state);
+
+      if (com.id == Command::Network_Command_ID::REQUEST_KEYFRAME) {
+        TCPManager::request_keyframe();
+      }
+
+      // Set error codes if command contained any
+      TCPManager::data_mutex.lock();
+      set_error_code(&com);
+      TCPManager::data_mutex.unlock();
+
+      // Commands that act on hardware (motor, brakes, relays) are carried out by the action function of the state
+      // the commands before them put us in. Do that now, so the next command in the batch sees their effect
+      if (is_action_command(com.id)) {
+        auto action = state_machine->get_action_function();
+        ((*state_machine).*(action))(&com);
       }
-    } else {  // Create a "do nothing" command. This will be passed into the steady state caller below
-      com.id = 0;
-      com.value = 0;
+      Trace::end();
     }
 
     TCPManager::data_mutex.lock();
-    // Set error codes if command contained any
-    set_error_code(&com);
-    // Collect sensor data and set motion model
+    // Collect sensor data and set motion model, once per tick however many commands there were
     update_unified_state();    
     TCPManager::data_mutex.unlock();
 
-    // Calls the steady state function for the current state
-    // Passes in command, and current state. 
+    // Calls the steady state function for the current state once, on this tick's data, with a "do nothing" command
+    // The commands above have already been applied
+    com.id = 0;
+    com.value = 0;
     auto func = state_machine->get_steady_function();
+    int64_t steady_start = LatencyHistogram::now();
     ((*state_machine).*(func))(&com, &unified_state); 
+    Metrics::steady_function.record(LatencyHistogram::now() - steady_start);
+    recorder.record(unified_state);  // Only copied, the recorder's thread writes it out
 
     #ifdef BBB
     // Set WD reset pin to high == WD is on
@@ -104,13 +131,33 @@ void Pod::logic_loop() {
     error_processed = false;
     #endif 
 
-    // Sleep for the given timeout
-    closing.wait_for(logic_loop_timeout);
+    if (!logic_loop_event_driven) {
+      // Sleep until the next period starts
+      logic_timer.wait(&closing);
+    } else if (loaded == 0) {
+      // Sleep until new data/ a command arrives, or the heartbeat is due
+      // If commands were just processed, go straight back around in case there are more queued
+      Notifications::logic_loop.wait_until(LatencyHistogram::now() + logic_loop_heartbeat * 1000);
+    }
   } 
+  if (logic_loop_event_driven) {
+    print(LogLevel::LOG_INFO, "logic_loop: %lu notified wakeups, %lu heartbeats\n",
+          (unsigned long) (Notifications::logic_loop.notified_wakeups() - notified_start),
+          (unsigned long) (Notifications::logic_loop.timeouts() - timeouts_start));
+  } else {
+    logic_timer.print_stats("logic_loop");
+  }
   print(LogLevel::LOG_INFO, "Exiting Pod Logic Loop\n");
 }
 
 
+// Helper function called from logic_loop()
+// True for commands the action functions act on, rather than the transition functions or set_error_code
+bool Pod::is_action_command(uint32_t id) {
+  return (id >= Command::Network_Command_ID::ENABLE_MOTOR && id <= Command::Network_Command_ID::DISABLE_BRAKE) ||
+         (id >= Command::Network_Command_ID::SET_HV_RELAY_HV_POLE && id <= Command::Network_Command_ID::RESET_PRU);
+}
+
 // Helper function called from logic_loop()
 // Updates the unified_state based on if there is SET or CLR error code
 void Pod::set_error_code(Command::Network_Command * com) {
@@ -129,10 +176,29 @@ void Pod::set_error_code(Command::Network_Command * com) {
 // Updates the unified_state
 // Calls MotionModel::calculate()
 void Pod::update_unified_state() {
-  unified_state.adc_data = SourceManager::ADC.Get();
-  unified_state.can_data = SourceManager::CAN.Get();
-  unified_state.i2c_data = SourceManager::I2C.Get();
-  unified_state.pru_data = SourceManager::PRU.Get();
+  ScopedLatency latency(&Metrics::update_unified_state);
+
+  // Copy the latest snapshots into the buffers allocated in the constructor.
+  // Lock free, the SourceManagers are never blocked by this.
+  SourceManager::ADC.Get(unified_state.adc_data.get(), &unified_state.adc_header);
+  SourceManager::CAN.Get(unified_state.can_data.get(), &unified_state.can_header);
+  SourceManager::I2C.Get(unified_state.i2c_data.get(), &unified_state.i2c_header);
+  SourceManager::PRU.Get(unified_state.pru_data.get(), &unified_state.pru_header);
+
+  // A refresh thread that stalled (ex: blocked in read()) keeps serving its last sample, make sure we notice
+  int64_t now = LatencyHistogram::now();
+  if (SourceManager::ADC.check_sample_age(unified_state.adc_header, now)) {
+    Command::set_error_flag(Command::Network_Command_ID::SET_ADC_ERROR, ADCErrors::ADC_STALE_DATA);
+  }
+  if (SourceManager::CAN.check_sample_age(unified_state.can_header, now)) {
+    Command::set_error_flag(Command::Network_Command_ID::SET_CAN_ERROR, CANErrors::CAN_STALE_DATA);
+  }
+  if (SourceManager::I2C.check_sample_age(unified_state.i2c_header, now)) {
+    Command::set_error_flag(Command::Network_Command_ID::SET_I2C_ERROR, I2CErrors::I2C_STALE_DATA);
+  }
+  if (SourceManager::PRU.check_sample_age(unified_state.pru_header, now)) {
+    Command::set_error_flag(Command::Network_Command_ID::SET_PRU_ERROR, PRUErrors::PRU_STALE_DATA);
+  }
   unified_state.state = state_machine->get_current_state();
   unified_state.motion_data->motor_state = (int32_t) state_machine->motor.is_enabled();
   unified_state.motion_data->brake_state = (int32_t) state_machine->brakes.is_enabled();
@@ -151,6 +217,7 @@ void Pod::update_unified_state() {
 
   // Update motion_data
   // Pass current state into Motion Model
+  ScopedLatency motion_latency(&Metrics::motion_model);
   #ifndef SIM
   motion_model->calculate(&unified_state);
   #else
@@ -205,6 +272,33 @@ Pod::Pod(const std::string & config_to_open, const std::string & flight_plan_to_
     exit(1);  // Crash hard on this error
   }
 
+  // Optional, defaults to running the logic loop every logic_loop_timeout
+  logic_loop_event_driven = 0;
+  logic_loop_heartbeat = 10000;
+  ConfiguratorManager::config.getValue("logic_loop_event_driven", logic_loop_event_driven);
+  ConfiguratorManager::config.getValue("logic_loop_heartbeat", logic_loop_heartbeat);
+
+  // Optional, where to write the command trace (see Trace.h) at shutdown
+  command_trace_file = "";
+  ConfiguratorManager::config.getValue("command_trace_file", command_trace_file);
+
+  // Optional, how many queued commands one logic loop iteration may apply
+  logic_loop_command_budget = 16;
+  ConfiguratorManager::config.getValue("logic_loop_command_budget", logic_loop_command_budget);
+  if (logic_loop_command_budget < 1) {
+    logic_loop_command_budget = 1;
+  }
+
+  // Optional, where the flight recorder (see FlightRecorder.h) writes every snapshot and command
+  flight_recorder_file = "";
+  flight_recorder_size = 16 * 1024 * 1024;
+  ConfiguratorManager::config.getValue("flight_recorder_file", flight_recorder_file);
+  ConfiguratorManager::config.getValue("flight_recorder_size", flight_recorder_size);
+
+  // Optional, defaults to a thread per source
+  reactor_mode = 0;
+  ConfiguratorManager::config.getValue("reactor_mode", reactor_mode);
+
   // Setup any other member variables here
   state_machine = make_shared<Pod_State>();
   motion_model = make_shared<MotionModel>();
@@ -215,6 +309,10 @@ Pod::Pod(const std::string & config_to_open, const std::string & flight_plan_to_
   unified_state.pru_data = make_shared<PRUData>();
   unified_state.errors = make_shared<Errors>();
   unified_state.state = E_States::ST_SAFE_MODE;
+  memset(&unified_state.adc_header, 0, sizeof(SampleHeader));
+  memset(&unified_state.can_header, 0, sizeof(SampleHeader));
+  memset(&unified_state.i2c_header, 0, sizeof(SampleHeader));
+  memset(&unified_state.pru_header, 0, sizeof(SampleHeader));
   running.store(false);
   switchVal = false;
 }
@@ -237,11 +335,21 @@ void Pod::run() {
   print(LogLevel::LOG_EDEBUG, "SANITY_CHECK Struct Size: ADC: %d; CANData: %d;  BMSCellBroadcastData (should be 8) %d; BMSCells  (should be 8 * 30) %d; I2C: %d; PRU: %d; Motion: %d\n", 
                                                             sizeof(ADCData), sizeof(CANData), sizeof(BMSCellBroadcastData), sizeof(BMSCells), sizeof(I2CData), sizeof(PRUData), sizeof(MotionData));
 
-  // Start all SourceManager threads
-  SourceManager::PRU.initialize();
-  SourceManager::CAN.initialize();
-  SourceManager::ADC.initialize();
-  SourceManager::I2C.initialize();
+  // Fresh latency numbers for this run. Printed once everything has shut down
+  Metrics::reset_all();
+  Command::reset_queue_counters();
+  Trace::reset();
+
+  // Start all SourceManager threads, or host them all in the reactor
+  Reactor * source_reactor = nullptr;
+  if (reactor_mode && reactor.start()) {
+    print(LogLevel::LOG_INFO, "Running sources in reactor mode\n");
+    source_reactor = &reactor;
+  }
+  SourceManager::PRU.initialize(source_reactor);
+  SourceManager::CAN.initialize(source_reactor);
+  SourceManager::ADC.initialize(source_reactor);
+  SourceManager::I2C.initialize(source_reactor);
 
   // Transition into SafeMode
   // technically we are already in SafeMode. However, when initialized the 
@@ -273,6 +381,10 @@ void Pod::run() {
     Command::set_error_flag(Command::Network_Command_ID::SET_OTHER_ERROR, OTHERErrors::GPIO_SWITCH_ERROR);
   }
   #endif
+  if (!flight_recorder_file.empty() && flight_recorder_size > 0) {
+    recorder.open(flight_recorder_file, (size_t) flight_recorder_size);  // The pod runs without it if it can't
+  }
+
   // I don't know how to use member functions as a thread function, but lambdas work
   running.store(true);
   thread logic_thread([&](){ logic_loop(); });  
@@ -289,11 +401,20 @@ void Pod::run() {
   tcp_fully_setup.wait();  // Wait for the simulator to give the go-ahead
   #endif 
   // UDP
-  thread udp_thread([&](){ UDPManager::connection_monitor(udp_addr.c_str(), udp_send.c_str(), udp_recv.c_str()); });
+  thread udp_thread;
+  bool udp_attached = false;
+  if (source_reactor != nullptr) {
+    udp_attached = UDPManager::attach(source_reactor, udp_addr.c_str(), udp_send.c_str(), udp_recv.c_str());
+  } else {
+    udp_thread = thread([&](){ UDPManager::connection_monitor(udp_addr.c_str(), udp_send.c_str(), udp_recv.c_str()); });
+  }
   #ifdef SIM
   udp_fully_setup.wait();  // Wait for the simulator to give the go-ahead
   #endif 
 
+  // Once the threads and the flight recorder are up, so everything they mapped is locked
+  ThreadConfig::lock_memory();
+
   print(LogLevel::LOG_INFO, "Finished Initialization\n");
   print(LogLevel::LOG_INFO, "================\n");
   
@@ -302,15 +423,29 @@ void Pod::run() {
 
   // Join all threads
   logic_thread.join();
+  recorder.close();
   // Once logic_loop joins, trigger other threads to stop
+  // The reactor goes first, its handlers must not run once their sockets/devices are closed
+  reactor.stop();
   TCPManager::close_client();
   UDPManager::close_client();
   tcp_thread.join();
-  udp_thread.join();
+  if (udp_attached) {
+    UDPManager::close_connection();
+  } else if (udp_thread.joinable()) {
+    udp_thread.join();
+  }
   SourceManager::PRU.stop();
   SourceManager::CAN.stop();
   SourceManager::ADC.stop();
   SourceManager::I2C.stop();
+  Metrics::print_all();
+  Command::print_queue_stats();
+  Trace::print_summary();
+  if (!command_trace_file.empty()) {
+    Trace::export_chrome(command_trace_file);
+  }
+  ThreadConfig::print_report();
   print(LogLevel::LOG_INFO, "All threads closed, Pod shutting down\n");
 }
 
@@ -318,6 +453,7 @@ void Pod::run() {
 void Pod::trigger_shutdown() {
   running.store(false);  
   closing.invoke();
+  Notifications::logic_loop.notify();
 }
 
 // Parse any command line arguments passed into the Pod
@@ -5,6 +5,12 @@
 #include "Command.h"
 #include "UDPManager.h"
 #include "Event.h"
+#include "PeriodicTimer.h"
+#include "Reactor.h"
+#include "ThreadConfig.h"
+#include "Notifier.h"
+#include "Metrics.h"
+#include "FlightRecorder.h"
 #include "Pod_State.h"
 #include "Configurator.h"
 #include "MotionModel.h"
@@ -38,12 +44,16 @@ class Pod {
   Event closing;
   Event tcp_fully_setup;
   Event udp_fully_setup;
+  PeriodicTimer logic_timer;  // Schedules logic_loop() every logic_loop_timeout
+  Reactor reactor;  // Hosts the SourceManagers and UDP when reactor_mode is set
+  FlightRecorder recorder;  // Every logic_loop snapshot and command, while running with flight_recorder_file set
 
  private:
   void logic_loop();  
   void update_unified_state();
   // IF the command is an error command, set the unified state appropriatly
   void set_error_code(Command::Network_Command * com);    
+  static bool is_action_command(uint32_t id);
   bool switchVal;
   string tcp_port;
   string tcp_addr;
@@ -51,6 +61,13 @@ class Pod {
   string udp_recv;  // port we recv packets from
   string udp_addr; 
   int64_t logic_loop_timeout;  // logic_loop sleep (timeout) value
+  int32_t logic_loop_event_driven;  // 1: run when notified (see Notifier.h) instead of every logic_loop_timeout
+  int64_t logic_loop_heartbeat;  // Longest the event driven logic loop sleeps (microseconds), keeps the watchdog fed
+  int32_t logic_loop_command_budget;  // Most commands applied per logic_loop iteration
+  string command_trace_file;  // Chrome trace JSON of the last commands is written here at shutdown, if set
+  string flight_recorder_file;  // Ring file the recorder writes to, recording is off if empty
+  int64_t flight_recorder_size;  // Bytes preallocated for it
+  int32_t reactor_mode;  // 1: ADC/CAN/I2C/PRU/UDP share one reactor thread instead of a thread each
 };
 
 namespace podtest_global {
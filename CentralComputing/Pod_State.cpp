@@ -39,6 +39,7 @@ Pod_State::Pod_State()
   transition_map[Command::SET_HV_RELAY_PRE_CHARGE] = &Pod_State::no_transition;
   transition_map[Command::CALC_ACCEL_ZERO_G] = &Pod_State::no_transition;
   transition_map[Command::RESET_PRU] = &Pod_State::no_transition;
+  transition_map[Command::REQUEST_KEYFRAME] = &Pod_State::no_transition;
   steady_state_map[ST_SAFE_MODE] = &Pod_State::steady_safe_mode;
   steady_state_map[ST_FUNCTIONAL_TEST_OUTSIDE] = &Pod_State::steady_function_outside;
   steady_state_map[ST_LOADING] = &Pod_State::steady_loading;
@@ -48,6 +49,15 @@ Pod_State::Pod_State()
   steady_state_map[ST_FLIGHT_COAST] = &Pod_State::steady_flight_coast;
   steady_state_map[ST_FLIGHT_BRAKE] = &Pod_State::steady_flight_brake;
   steady_state_map[ST_FLIGHT_ABORT] = &Pod_State::steady_flight_abort;
+  action_map[ST_SAFE_MODE] = &Pod_State::action_safe_mode;
+  action_map[ST_FUNCTIONAL_TEST_OUTSIDE] = &Pod_State::action_function_outside;
+  action_map[ST_LOADING] = &Pod_State::action_loading;
+  action_map[ST_FUNCTIONAL_TEST_INSIDE] = &Pod_State::action_function_inside;
+  action_map[ST_LAUNCH_READY] = &Pod_State::no_action;
+  action_map[ST_FLIGHT_ACCEL] = &Pod_State::no_action;
+  action_map[ST_FLIGHT_COAST] = &Pod_State::no_action;
+  action_map[ST_FLIGHT_BRAKE] = &Pod_State::no_action;
+  action_map[ST_FLIGHT_ABORT] = &Pod_State::no_action;
 
   if (!(ConfiguratorManager::config.getValue("acceleration_timeout", acceleration_timeout) && 
       ConfiguratorManager::config.getValue("precharge_timeout", launch_ready_precharge_timeout) &&
@@ -330,6 +340,110 @@ void Pod_State::ST_Flight_Abort() {
 ///////////////////////////
 void Pod_State::steady_safe_mode(Command::Network_Command * command, 
                                   UnifiedState * state) {
+}
+
+void Pod_State::steady_function_outside(Command::Network_Command * command, 
+                                  UnifiedState * state) {
+}
+
+void Pod_State::steady_loading(Command::Network_Command * command, 
+                                UnifiedState* state) {
+}
+
+void Pod_State::steady_function_inside(Command::Network_Command * command, 
+                                  UnifiedState * state) {
+}
+
+void Pod_State::steady_launch_ready(Command::Network_Command * command, 
+                                    UnifiedState* state) {
+  // check if precharge complete
+  int64_t timeout_check = microseconds() - launch_ready_start_time;
+  if (timeout_check > launch_ready_precharge_timeout && !ready_for_launch) {
+    // Precharge complete, turn of precharge relay, turn on HV relay
+    motor.set_relay_state(HV_Relay_Select::RELAY_PRE_CHARGE, HV_Relay_State::RELAY_OFF);
+    motor.set_relay_state(HV_Relay_Select::RELAY_HV_POLE, HV_Relay_State::RELAY_ON);
+    ready_for_launch = true;  // Set true so we can't get into this IF again
+  }
+
+  std::lock_guard<std::mutex> guard(timeout_mutex);
+  p_counter = timeout_check;
+}
+
+void Pod_State::steady_flight_accelerate(Command::Network_Command * command, 
+                                        UnifiedState* state) {
+  // Access Pos, Vel, and Accel from Motion Model
+  int32_t pos = state->motion_data->x[0];
+  int32_t vel = state->motion_data->x[1];
+  int32_t acc = state->motion_data->x[2];
+  int64_t timeout_check = microseconds() - acceleration_start_time;
+
+  int16_t motor_throttle = ConfiguratorManager::config.getFlightPlan(timeout_check, &flight_plan_index);
+  if (motor_throttle != old_motor_throttle) {
+    old_motor_throttle = motor_throttle;
+    motor.set_throttle(motor_throttle);
+  }
+  
+  // Transition if kinematics demand it, or we exceed our timeout
+  if (shouldBrake(vel, pos) || timeout_check >= acceleration_timeout) {
+    Command::put(Command::Network_Command_ID::TRANS_FLIGHT_COAST, 0);
+    auto_transition_coast.invoke();
+  }
+
+  std::lock_guard<std::mutex> guard(timeout_mutex);
+  a_counter = timeout_check;
+}
+
+void Pod_State::steady_flight_coast(Command::Network_Command * command, 
+                                    UnifiedState* state) {
+  // Transition after we exceed our timeout
+  int64_t timeout_check = microseconds() - coast_start_time;
+  if (timeout_check >= coast_timeout) {
+    Command::put(Command::Network_Command_ID::TRANS_FLIGHT_BRAKE, 0);
+    auto_transition_brake.invoke();
+  }
+
+  std::lock_guard<std::mutex> guard(timeout_mutex);
+  c_counter = timeout_check;
+}
+
+void Pod_State::steady_flight_brake(Command::Network_Command * command, 
+                                    UnifiedState* state) {
+  int32_t acc = state->motion_data->x[2];
+  int32_t vel = state->motion_data->x[1];
+  int64_t timeout_check = microseconds() - brake_start_time;
+
+  // Transition after we exceed our timeout AND acceleration AND Velocity are under a configurable value.
+  if (std::abs(acc) < not_moving_acceleration
+      && std::abs(vel) < not_moving_velocity 
+      && timeout_check >= brake_timeout) {
+    Command::put(Command::Network_Command_ID::TRANS_SAFE_MODE, 0);
+    auto_transition_safe_mode.invoke();
+  }
+
+  std::lock_guard<std::mutex> guard(timeout_mutex);
+  b_counter = timeout_check;
+}
+
+bool Pod_State::shouldBrake(int64_t vel, int64_t pos) {
+  int64_t target_distance = length_of_track - brake_buffer_length;
+  int64_t stopping_distance = pos + (vel * vel) / (2*estimated_brake_deceleration);
+
+  if (stopping_distance >= target_distance) {
+    print(LogLevel::LOG_INFO, "Pod Should Brake, vel: %.2f pos: %.2f\n", vel, pos);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+void Pod_State::steady_flight_abort(Command::Network_Command * command, 
+                                    UnifiedState * state) {
+}
+
+//////////////////////
+// ACTION FUNCTIONS //
+//////////////////////
+void Pod_State::action_safe_mode(Command::Network_Command * command) {
   switch (command->id) {
     case Command::CALC_ACCEL_ZERO_G:
       // trigger calculate zero g
@@ -340,8 +454,7 @@ void Pod_State::steady_safe_mode(Command::Network_Command * command,
   }
 }
 
-void Pod_State::steady_function_outside(Command::Network_Command * command, 
-                                  UnifiedState * state) {
+void Pod_State::action_function_outside(Command::Network_Command * command) {
   // process command, let manual commands go through
   switch (command->id) {
     case Command::ENABLE_MOTOR: 
@@ -393,8 +506,7 @@ void Pod_State::steady_function_outside(Command::Network_Command * command,
   }
 }
 
-void Pod_State::steady_loading(Command::Network_Command * command, 
-                                UnifiedState* state) {
+void Pod_State::action_loading(Command::Network_Command * command) {
   switch (command->id) {
     case Command::CALC_ACCEL_ZERO_G:
       // trigger calculate zero g
@@ -405,8 +517,7 @@ void Pod_State::steady_loading(Command::Network_Command * command,
   }
 }
 
-void Pod_State::steady_function_inside(Command::Network_Command * command, 
-                                  UnifiedState * state) {
+void Pod_State::action_function_inside(Command::Network_Command * command) {
   switch (command->id) {
     case Command::ENABLE_MOTOR: 
       motor.enable_motors();
@@ -447,94 +558,5 @@ void Pod_State::steady_function_inside(Command::Network_Command * command,
   }
 }
 
-void Pod_State::steady_launch_ready(Command::Network_Command * command, 
-                                    UnifiedState* state) {
-  switch (command->id) {
-    case Command::RESET_PRU:
-      break;
-    default:
-      break;
-  }
-  // check if precharge complete
-  int64_t timeout_check = microseconds() - launch_ready_start_time;
-  if (timeout_check > launch_ready_precharge_timeout && !ready_for_launch) {
-    // Precharge complete, turn of precharge relay, turn on HV relay
-    motor.set_relay_state(HV_Relay_Select::RELAY_PRE_CHARGE, HV_Relay_State::RELAY_OFF);
-    motor.set_relay_state(HV_Relay_Select::RELAY_HV_POLE, HV_Relay_State::RELAY_ON);
-    ready_for_launch = true;  // Set true so we can't get into this IF again
-  }
-
-  std::lock_guard<std::mutex> guard(timeout_mutex);
-  p_counter = timeout_check;
-}
-
-void Pod_State::steady_flight_accelerate(Command::Network_Command * command, 
-                                        UnifiedState* state) {
-  // Access Pos, Vel, and Accel from Motion Model
-  int32_t pos = state->motion_data->x[0];
-  int32_t vel = state->motion_data->x[1];
-  int32_t acc = state->motion_data->x[2];
-  int64_t timeout_check = microseconds() - acceleration_start_time;
-
-  int16_t motor_throttle = ConfiguratorManager::config.getFlightPlan(timeout_check, &flight_plan_index);
-  if (motor_throttle != old_motor_throttle) {
-    old_motor_throttle = motor_throttle;
-    motor.set_throttle(motor_throttle);
-  }
-  
-  // Transition if kinematics demand it, or we exceed our timeout
-  if (shouldBrake(vel, pos) || timeout_check >= acceleration_timeout) {
-    Command::put(Command::Network_Command_ID::TRANS_FLIGHT_COAST, 0);
-    auto_transition_coast.invoke();
-  }
-
-  std::lock_guard<std::mutex> guard(timeout_mutex);
-  a_counter = timeout_check;
-}
-
-void Pod_State::steady_flight_coast(Command::Network_Command * command, 
-                                    UnifiedState* state) {
-  // Transition after we exceed our timeout
-  int64_t timeout_check = microseconds() - coast_start_time;
-  if (timeout_check >= coast_timeout) {
-    Command::put(Command::Network_Command_ID::TRANS_FLIGHT_BRAKE, 0);
-    auto_transition_brake.invoke();
-  }
-
-  std::lock_guard<std::mutex> guard(timeout_mutex);
-  c_counter = timeout_check;
-}
-
-void Pod_State::steady_flight_brake(Command::Network_Command * command, 
-                                    UnifiedState* state) {
-  int32_t acc = state->motion_data->x[2];
-  int32_t vel = state->motion_data->x[1];
-  int64_t timeout_check = microseconds() - brake_start_time;
-
-  // Transition after we exceed our timeout AND acceleration AND Velocity are under a configurable value.
-  if (std::abs(acc) < not_moving_acceleration
-      && std::abs(vel) < not_moving_velocity 
-      && timeout_check >= brake_timeout) {
-    Command::put(Command::Network_Command_ID::TRANS_SAFE_MODE, 0);
-    auto_transition_safe_mode.invoke();
-  }
-
-  std::lock_guard<std::mutex> guard(timeout_mutex);
-  b_counter = timeout_check;
-}
-
-bool Pod_State::shouldBrake(int64_t vel, int64_t pos) {
-  int64_t target_distance = length_of_track - brake_buffer_length;
-  int64_t stopping_distance = pos + (vel * vel) / (2*estimated_brake_deceleration);
-
-  if (stopping_distance >= target_distance) {
-    print(LogLevel::LOG_INFO, "Pod Should Brake, vel: %.2f pos: %.2f\n", vel, pos);
-    return true;
-  } else {
-    return false;
-  }
-}
-
-void Pod_State::steady_flight_abort(Command::Network_Command * command, 
-                                    UnifiedState * state) {
+void Pod_State::no_action(Command::Network_Command * command) {
 }
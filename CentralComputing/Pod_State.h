@@ -14,6 +14,7 @@ class Pod_State;
 typedef void (Pod_State::*steady_state_function) (Command::Network_Command * command, 
                                                   UnifiedState* state);
 typedef void (Pod_State::*transition_function) ();
+typedef void (Pod_State::*action_function) (Command::Network_Command * command);
 
 class Pod_State : public StateMachine {
  public:
@@ -80,6 +81,17 @@ class Pod_State : public StateMachine {
   void steady_flight_brake(Command::Network_Command*,      UnifiedState *);
   void steady_flight_abort(Command::Network_Command*,      UnifiedState *);
 
+  /**
+  * Action functions
+  * Carry out a command that acts on hardware (motor, brakes, relays), if the current state allows it.
+  * Called once per such command, as it is dequeued. The periodic work stays in the steady functions
+  **/
+  void action_safe_mode(Command::Network_Command*);
+  void action_function_outside(Command::Network_Command*);
+  void action_loading(Command::Network_Command*);
+  void action_function_inside(Command::Network_Command*);
+  void no_action(Command::Network_Command*);  // used in map for states that take no manual commands
+
   /*
   * Gets the steady state function for the current state
   * @return a member function pointer
@@ -88,6 +100,14 @@ class Pod_State : public StateMachine {
     return steady_state_map[get_current_state()];
   }
 
+  /*
+  * Gets the action function for the current state
+  * @return a member function pointer
+  */
+  action_function get_action_function() {
+    return action_map[get_current_state()];
+  }
+
   /*
   * Gets the transition function for the given network command
   * @return a member function pointer
@@ -131,6 +151,8 @@ class Pod_State : public StateMachine {
   std::map<Command::Network_Command_ID, transition_function> transition_map; 
   
   std::map<E_States, steady_state_function> steady_state_map;
+
+  std::map<E_States, action_function> action_map;
   void ST_Safe_Mode();
   void ST_Functional_Test_Outside();
   void ST_Loading();
@@ -0,0 +1,103 @@
+#include "Poller.h"
+#include "Utils.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using Utils::print;
+using Utils::LogLevel;
+
+Poller::Poller() : epoll_fd(-1), wake_fd(-1), hung_up(-1) {}
+
+Poller::~Poller() {
+  close();
+}
+
+bool Poller::open() {
+  close();
+  hung_up = -1;
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    PRINT_ERRNO("Poller epoll_create1 failed");
+    return false;
+  }
+  wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    PRINT_ERRNO("Poller eventfd failed");
+    close();
+    return false;
+  }
+  return add(wake_fd);
+}
+
+bool Poller::add(int fd) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    PRINT_ERRNO("Poller epoll_ctl failed");
+    return false;
+  }
+  return true;
+}
+
+int Poller::wait(int64_t micros) {
+  int ready[MAX_EVENTS];
+  int n = wait(micros, ready, MAX_EVENTS);
+  return n > 0 ? READY : n;
+}
+
+int Poller::wait(int64_t micros, int * ready, int max_ready) {
+  struct epoll_event events[MAX_EVENTS];
+  int timeout_ms = micros < 0 ? -1 : static_cast<int>((micros + 999) / 1000);
+  int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+  if (n < 0) {
+    if (errno == EINTR) {
+      return TIMEOUT;
+    }
+    PRINT_ERRNO("Poller epoll_wait failed");
+    return FAILED;
+  }
+
+  int ret = 0;
+  for (int i = 0; i < n; i++) {
+    if (events[i].data.fd == wake_fd) {
+      uint64_t value;
+      if (read(wake_fd, &value, sizeof(value)) < 0) {}  // Clear the wakeup
+      return WOKEN;
+    }
+    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+      // Readable fds are reported again by the next wait()
+      hung_up = events[i].data.fd;
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, hung_up, nullptr);
+      return HANGUP;
+    }
+    if (ret < max_ready) {
+      ready[ret++] = events[i].data.fd;
+    }
+  }
+  return ret;
+}
+
+int Poller::hung_up_fd() {
+  return hung_up;
+}
+
+void Poller::wake() {
+  if (wake_fd >= 0) {
+    uint64_t value = 1;
+    if (write(wake_fd, &value, sizeof(value)) < 0) {}  // Only fails if the counter is saturated
+  }
+}
+
+void Poller::close() {
+  if (wake_fd >= 0) {
+    ::close(wake_fd);
+    wake_fd = -1;
+  }
+  if (epoll_fd >= 0) {
+    ::close(epoll_fd);
+    epoll_fd = -1;
+  }
+}
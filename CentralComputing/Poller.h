@@ -0,0 +1,70 @@
+#ifndef POLLER_H_
+#define POLLER_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Small epoll wrapper used to sleep until a file descriptor is readable
+// Along with the watched fds, it owns an eventfd so another thread can wake the waiter up
+// (ex: on shutdown), the same way Event::invoke() wakes an Event::wait_for()
+class Poller {
+ public:
+  Poller();
+  ~Poller();
+
+  /*
+   * Creates the epoll instance and wake eventfd
+   * @return false on failure
+   */
+  bool open();
+
+  /*
+   * Watch fd for readability
+   */
+  bool add(int fd);
+
+  // What wait() returns when no watched fd is readable
+  enum Result {
+    FAILED = -3,   // epoll_wait() failed
+    HANGUP = -2,   // A watched fd reported EPOLLERR/ EPOLLHUP. It is no longer watched, see hung_up_fd()
+    WOKEN = -1,    // wake() was called
+    TIMEOUT = 0,
+    READY = 1
+  };
+
+  /*
+   * Wait until a watched fd is readable, wake() is called, or the timeout expires
+   * @param micros timeout, rounded up to the next millisecond. Negative waits forever
+   * @return READY if a watched fd is readable, otherwise one of the Result values above
+   */
+  int wait(int64_t micros);
+
+  /*
+   * Same as wait(micros), but also reports which watched fds are readable
+   * @param ready filled in with up to max_ready readable fds
+   * @return number of fds put in ready, otherwise one of the Result values above
+   */
+  int wait(int64_t micros, int * ready, int max_ready);
+
+  /*
+   * The fd removed by the latest wait() that returned HANGUP.
+   * epoll is level triggered, so watching it any longer would make every wait() return at once
+   */
+  int hung_up_fd();
+
+  /*
+   * Wakes up the waiting thread. The wakeup stays pending until the next wait() consumes it
+   */
+  void wake();
+
+  void close();
+
+  static const int MAX_EVENTS = 8;
+
+ private:
+  int epoll_fd;
+  int wake_fd;
+  int hung_up;
+};
+
+#endif  // POLLER_H_
@@ -0,0 +1,173 @@
+#include "Reactor.h"
+#include "Utils.h"
+#include "ThreadConfig.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using Utils::print;
+using Utils::LogLevel;
+
+Reactor::Reactor() : timer_fd(-1), running(false), num_entries(0), num_pending(0), num_added(0) {
+  for (int i = 0; i < MAX_HANDLERS; i++) {
+    entries[i].handler = nullptr;
+    entries[i].fd = -1;
+    pending[i] = nullptr;
+  }
+}
+
+bool Reactor::add(ReactorHandler * handler) {
+  std::lock_guard<std::mutex> guard(pending_mutex);
+  if (num_added >= MAX_HANDLERS) {
+    print(LogLevel::LOG_ERROR, "Reactor full, can't host %s\n", handler->handler_name().c_str());
+    return false;
+  }
+  pending[num_pending++] = handler;
+  num_added++;
+  poller.wake();  // Picked up at the top of the next loop iteration
+  return true;
+}
+
+bool Reactor::start() {
+  if (!poller.open()) {
+    return false;
+  }
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    PRINT_ERRNO("Reactor timerfd_create failed");
+    poller.close();
+    return false;
+  }
+  if (!poller.add(timer_fd)) {
+    close(timer_fd);
+    timer_fd = -1;
+    poller.close();
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(pending_mutex);
+    num_entries = 0;
+    num_added = num_pending;
+  }
+  running.store(true);
+  worker = std::thread([&] { loop(); });
+  return true;
+}
+
+void Reactor::stop() {
+  if (!running.load()) {
+    return;
+  }
+  running.store(false);
+  poller.wake();
+  worker.join();
+
+  std::lock_guard<std::mutex> guard(pending_mutex);
+  for (int i = 0; i < num_entries; i++) {
+    entries[i].lateness.print(entries[i].handler->handler_name() + "_reactor_lateness");
+  }
+  num_pending = 0;
+  num_added = 0;
+  poller.close();
+  close(timer_fd);
+  timer_fd = -1;
+}
+
+bool Reactor::is_running() {
+  return running.load();
+}
+
+LatencyHistogram * Reactor::lateness(ReactorHandler * handler) {
+  std::lock_guard<std::mutex> guard(pending_mutex);
+  for (int i = 0; i < num_entries; i++) {
+    if (entries[i].handler == handler) {
+      return &entries[i].lateness;
+    }
+  }
+  return nullptr;
+}
+
+void Reactor::take_pending() {
+  std::lock_guard<std::mutex> guard(pending_mutex);
+  for (int i = 0; i < num_pending; i++) {
+    Entry & entry = entries[num_entries];
+    entry.handler = pending[i];
+    entry.fd = pending[i]->handler_fd();
+    entry.lateness.reset();
+    if (entry.fd >= 0 && !poller.add(entry.fd)) {
+      print(LogLevel::LOG_ERROR, "Reactor can't watch %s, running it on its deadline only\n",
+                                  entry.handler->handler_name().c_str());
+      entry.fd = -1;
+    }
+    num_entries++;
+  }
+  num_pending = 0;
+}
+
+void Reactor::arm_timer() {
+  int64_t next = 0;
+  for (int i = 0; i < num_entries; i++) {
+    int64_t deadline = entries[i].handler->deadline;
+    if (deadline != 0 && (next == 0 || deadline < next)) {
+      next = deadline;
+    }
+  }
+
+  // An all zero it_value disarms the timer
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = next / 1000000000;
+  spec.it_value.tv_nsec = next % 1000000000;
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    PRINT_ERRNO("Reactor timerfd_settime failed");
+  }
+}
+
+void Reactor::loop() {
+  ThreadConfig::apply("reactor");
+  int ready[Poller::MAX_EVENTS];
+  while (running.load()) {
+    take_pending();
+
+    // Deadlines first, in the order handlers were added
+    for (int i = 0; i < num_entries; i++) {
+      ReactorHandler * handler = entries[i].handler;
+      int64_t now = LatencyHistogram::now();
+      if (handler->deadline != 0 && handler->deadline <= now) {
+        entries[i].lateness.record(now - handler->deadline);
+        handler->on_deadline();
+      }
+    }
+
+    arm_timer();
+    int n = poller.wait(-1, ready, Poller::MAX_EVENTS);
+    if (n == Poller::HANGUP) {
+      for (int i = 0; i < num_entries; i++) {
+        if (entries[i].fd >= 0 && entries[i].fd == poller.hung_up_fd()) {
+          print(LogLevel::LOG_ERROR, "Reactor: %s fd reported an error, running it on its deadline only\n",
+                                      entries[i].handler->handler_name().c_str());
+          entries[i].fd = -1;
+        }
+      }
+    }
+    if (n <= 0) {
+      continue;  // Woken up (new handler or stop()), deadlines are checked at the top
+    }
+
+    // Then readable fds, in the same order
+    for (int i = 0; i < num_entries; i++) {
+      for (int r = 0; r < n; r++) {
+        if (entries[i].fd >= 0 && entries[i].fd == ready[r]) {
+          entries[i].handler->on_readable();
+          break;
+        }
+      }
+    }
+    for (int r = 0; r < n; r++) {
+      if (ready[r] == timer_fd) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {}  // Clear it, deadlines are checked at the top
+      }
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef REACTOR_H_
+#define REACTOR_H_
+
+#include "Poller.h"
+#include "LatencyHistogram.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex> // NOLINT
+#include <string>
+#include <thread> // NOLINT
+
+// Something the Reactor can run: called when its fd is readable, and/or when its deadline passes
+// Handlers must never block, everything else hosted by the same Reactor waits on them
+class ReactorHandler {
+ public:
+  ReactorHandler() : deadline(0) {}
+  virtual ~ReactorHandler() {}
+
+  virtual std::string handler_name() = 0;
+
+  // fd to watch for readability, or -1 to only run on the deadline. Read once when the handler is added
+  virtual int handler_fd() {
+    return -1;
+  }
+
+  virtual void on_readable() {}
+
+  // Called once deadline has passed. Should move deadline forward (or set it to 0), otherwise it runs again right away
+  virtual void on_deadline() = 0;
+
+  // Absolute CLOCK_MONOTONIC time (nanoseconds) on_deadline() should run at, 0 for never.
+  // Only touched from the Reactor's thread once the handler has been added
+  int64_t deadline;
+};
+
+// Runs several handlers from a single thread, instead of a thread (and a wakeup) per source
+//
+// One epoll wait covers every handler fd plus a timerfd armed at the earliest deadline, so a handler
+// runs as soon as its fd is readable or its deadline passes. Expired deadlines are run first, then readable fds,
+// both in the order the handlers were added, so the ordering is the same every iteration.
+// How late each deadline was serviced is recorded per handler.
+class Reactor {
+ public:
+  Reactor();
+
+  /*
+   * Host handler. Safe to call from any thread, before or after start().
+   * The handler must stay alive until stop() returns
+   * @return false if MAX_HANDLERS are already hosted
+   */
+  bool add(ReactorHandler * handler);
+
+  /*
+   * Starts the reactor thread
+   * @return false if the epoll/timerfd setup failed
+   */
+  bool start();
+
+  /*
+   * Stops the reactor thread and forgets every handler. Prints the deadline lateness of each one
+   */
+  void stop();
+
+  bool is_running();
+
+  /*
+   * Lateness of the handler's deadlines (nanoseconds), or nullptr if it isn't hosted
+   */
+  LatencyHistogram * lateness(ReactorHandler * handler);
+
+  static const int MAX_HANDLERS = 6;  // Poller::MAX_EVENTS, minus the timerfd and the wake eventfd
+
+ private:
+  struct Entry {
+    ReactorHandler * handler;
+    int fd;
+    LatencyHistogram lateness;
+  };
+
+  void loop();
+  void take_pending();
+  void arm_timer();
+
+  Poller poller;
+  int timer_fd;
+  std::atomic<bool> running;
+  std::thread worker;
+
+  Entry entries[MAX_HANDLERS];
+  int num_entries;  // Only touched by the reactor thread while it is running
+
+  std::mutex pending_mutex;
+  ReactorHandler * pending[MAX_HANDLERS];
+  int num_pending;
+  int num_added;  // entries + pending, guarded by pending_mutex
+};
+
+#endif  // REACTOR_H_
@@ -0,0 +1,88 @@
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <thread> // NOLINT
+
+// Single writer, multiple reader sequence lock for plain-old-data structs
+//
+// The writer never blocks, and readers never block the writer. A reader copies the
+// payload out and retries if the writer was in the middle of a store while it was copying.
+// The sequence counter is odd while a store is in progress, and is bumped by 2 for every completed store.
+//
+// The payload is kept as an array of atomic words (accessed relaxed) so concurrent copies
+// are well defined, and so the thread sanitizer builds don't report the (expected) racing reads.
+// Data must be trivially copyable; every struct in Defines.hpp is.
+template <class Data>
+class SeqLock {
+ public:
+  SeqLock() : seq(0) {
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /*
+   * Publish a new value. Only ONE thread may call store()
+   */
+  void store(const Data & value) {
+    uint32_t buf[WORDS];
+    buf[WORDS - 1] = 0;  // pad bytes, if sizeof(Data) isn't a multiple of 4
+    memcpy(buf, &value, sizeof(Data));
+
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i].store(buf[i], std::memory_order_relaxed);
+    }
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  /*
+   * Copy the latest consistent value into out. Never blocks the writer.
+   * Returns the sequence number of the copied value (0 means nothing was ever stored)
+   */
+  uint32_t load(Data * out) const {
+    uint32_t buf[WORDS];
+    uint32_t before;
+    uint32_t after;
+    int spins = 0;
+    do {
+      before = seq.load(std::memory_order_acquire);
+      while (before & 1) {
+        // Writer is mid-store. On a single core BBB spinning would just burn the writer's timeslice
+        if (++spins > SPINS_BEFORE_YIELD) {
+          std::this_thread::yield();
+        }
+        before = seq.load(std::memory_order_acquire);
+      }
+      for (size_t i = 0; i < WORDS; i++) {
+        buf[i] = words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = seq.load(std::memory_order_relaxed);
+    } while (before != after);
+
+    memcpy(out, buf, sizeof(Data));
+    return before / 2;
+  }
+
+  /*
+   * Number of completed stores
+   */
+  uint32_t sequence() const {
+    return seq.load(std::memory_order_acquire) / 2;
+  }
+
+ private:
+  static const size_t WORDS = (sizeof(Data) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  static const int SPINS_BEFORE_YIELD = 64;
+
+  std::atomic<uint32_t> seq;
+  std::atomic<uint32_t> words[WORDS];
+};
+
+#endif  // SEQLOCK_HPP
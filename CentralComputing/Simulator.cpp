@@ -102,6 +102,12 @@ bool Simulator::send_command(std::shared_ptr<Command::Network_Command> command)
   return bytes_written == size;
 }
 
+bool Simulator::send_commands(const std::vector<Command::Network_Command> & commands) {
+  std::vector<uint8_t> bytes(commands.size() * sizeof(Command::Network_Command));
+  memcpy(bytes.data(), commands.data(), bytes.size());
+  return Utils::write_all_to_socket(clientfd_tcp, bytes.data(), bytes.size()) == (ssize_t) bytes.size();
+}
+
 void Simulator::read_loop_tcp() {
   while (active_connection.load()) {
     // dump the data because we don't need it or do anything with it.
@@ -448,9 +454,7 @@ std::shared_ptr<ADCData> Simulator::sim_get_adc() {
   if (scenario != nullptr && (!scenario->use_sensor_free_motion())) {
     return scenario->sim_get_adc();
   } else {
-    std::shared_ptr<ADCData> d = std::make_shared<ADCData>();
-    memset(d.get(), (uint8_t)0, sizeof(ADCData));
-    return d;
+    return DataPool::make<ADCData>();
   }
 }
 
@@ -459,9 +463,7 @@ std::shared_ptr<CANData> Simulator::sim_get_can() {
   if (scenario != nullptr && (!scenario->use_sensor_free_motion())) {
     return scenario->sim_get_can();
   } else {
-    std::shared_ptr<CANData> d = std::make_shared<CANData>();
-    memset(d.get(), (uint8_t)0, sizeof(CANData));
-    return d;
+    return DataPool::make<CANData>();
   }
 }
 
@@ -470,9 +472,7 @@ std::shared_ptr<I2CData> Simulator::sim_get_i2c() {
   if (scenario != nullptr && (!scenario->use_sensor_free_motion())) {
     return scenario->sim_get_i2c();
   } else {
-    std::shared_ptr<I2CData> d = std::make_shared<I2CData>();
-    memset(d.get(), (uint8_t)0, sizeof(I2CData));
-    return d;
+    return DataPool::make<I2CData>();
   }
 }
 
@@ -481,9 +481,7 @@ std::shared_ptr<PRUData> Simulator::sim_get_pru() {
   if (scenario != nullptr && (!scenario->use_sensor_free_motion())) {
     return scenario->sim_get_pru();
   } else {
-    std::shared_ptr<PRUData> d = std::make_shared<PRUData>();
-    memset(d.get(), (uint8_t)0, sizeof(PRUData));
-    return d;
+    return DataPool::make<PRUData>();
   }
 }
 
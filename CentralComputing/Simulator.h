@@ -5,6 +5,7 @@
 #include "Defines.hpp"
 #include "Scenario.hpp"
 #include "MotionModel.h"
+#include <vector>
 
 /**
  * This class is designed to be the "glue" between the tests, and the rest of the codebase. There are two parts
@@ -48,6 +49,12 @@ class Simulator {
    */
   bool send_command(std::shared_ptr<Command::Network_Command> command);
 
+  /**
+   * Sends the given commands back to back in one write, the way a burst can arrive over TCP
+   * @return true if all of them were written
+   */
+  bool send_commands(const std::vector<Command::Network_Command> & commands);
+
   /**
    * Thread function, reads continually and updates the internal simulate state variables
    */
@@ -5,26 +5,48 @@
 #include "Event.h"
 #include "Simulator.h"
 #include "Configurator.h"
+#include "SeqLock.hpp"
+#include "HistoryRing.hpp"
+#include "ObjectPool.hpp"
+#include "AllocationCounter.h"
+#include "Poller.h"
+#include "PeriodicTimer.h"
+#include "LatencyHistogram.h"
+#include "Reactor.h"
+#include "ThreadConfig.h"
+#include "Notifier.h"
 #include <memory>
 #include <thread> // NOLINT
-#include <mutex>  // NOLINT
 #include <atomic>
+#include <mutex> // NOLINT
 
 using Utils::print;
 using Utils::LogLevel;
 
 template <class Data>
-class SourceManagerBase {
+class SourceManagerBase : public ReactorHandler {
  public:
+  // Copies the latest published data (and its header, if requested) into out. Never blocks the refresh thread.
+  // Preferred over Get() in the logic loop, since the caller owns (and reuses) the buffer
+  void Get(Data * out, SampleHeader * header = nullptr) {
+    Sample<Data> sample;
+    snapshot.load(&sample);
+    *out = sample.data;
+    if (header != nullptr) {
+      *header = sample.header;
+    }
+  }
+
   std::shared_ptr<Data> Get() {
-    mutex.lock();
-    std::shared_ptr<Data> ret = data;
-    mutex.unlock();
+    std::shared_ptr<Data> ret = std::make_shared<Data>();
+    Get(ret.get());
     return ret;
   }
 
-  void initialize() {
+  // Starts the refresh thread. If reactor is given, the manager is hosted by it instead of getting its own thread
+  void initialize(Reactor * reactor = nullptr) {
     current_state = E_States::ST_SAFE_MODE;
+    hosted = false;
 
     #ifdef SIM
       initialized_correctly = true;
@@ -37,22 +59,36 @@ class SourceManagerBase {
     // Should be used to load configuration values regarding what would trigger an error
     initialize_sensor_error_configs();
 
+    stale_timeout = stale_timeout_config() * 1000;
+
     // Make sure event is setup correctly
     closing.reset();
+    refresh_allocations.store(0);
+    sequence = 0;
 
     if (initialized_correctly) {
       // If initialized correcly, setup the worker
       
       #ifdef SIM
-        data = refresh_sim();
+        // Not timestamped, the refresh loop doesn't start publishing until a scenario is loaded
+        publish(*refresh_sim(), 0);
       #else
-        data = refresh();
+        publish(*refresh(), LatencyHistogram::now());
       #endif
 
       running.store(true);
 
-      // I don't know how to start a thread using a member function, but I know how to use lambdas so suck it C++
-      worker = std::thread([&] { refresh_loop(); });
+      if (reactor != nullptr) {
+        period = refresh_timeout() * 1000;
+        deadline = LatencyHistogram::now() + period;
+        hosted = reactor->add(this);
+      }
+      if (!hosted) {
+        use_poller = setup_poller();  // Before the worker starts, so stop() can always wake it
+
+        // I don't know how to start a thread using a member function, but I know how to use lambdas so suck it C++
+        worker = std::thread([&] { refresh_loop(); });
+      }
     } else {
       // Did not setup correctly. Print error and set garbage data
       #ifdef SIM
@@ -63,13 +99,16 @@ class SourceManagerBase {
       running.store(false);
 
       // Set garbage data
-      data = std::make_shared<Data>();
-      memset(data.get(), (uint8_t)0, sizeof(Data));
+      publish(*empty_data(), 0);
     }
   }
   
+  // If hosted by a Reactor, the Reactor must be stopped first
   void stop() {
-    if (initialized_correctly) {
+    if (initialized_correctly && hosted) {
+      running.store(false);
+      stop_source();
+    } else if (initialized_correctly) {
       running.store(false);
       #ifdef SIM
       // Make sure we arn't waiting on this
@@ -77,16 +116,91 @@ class SourceManagerBase {
       SimulatorManager::sim.loaded_scenario.invoke();  
       #endif
       closing.invoke();
+      {
+        std::lock_guard<std::mutex> guard(poller_mutex);  // The worker may be closing it (see refresh_loop())
+        poller.wake();
+      }
 
       worker.join();
+      poller.close();
       stop_source();
     }
   }
 
+  // Records how old the sample described by header is at time now (see LatencyHistogram::now()),
+  // and returns true if it is older than <name>_stale_timeout. Called by the reader (logic loop) right after Get()
+  bool check_sample_age(const SampleHeader & header, int64_t now) {
+    if (header.timestamp == 0) {
+      return false;  // Not captured by the refresh loop yet
+    }
+    int64_t age = now - header.timestamp;
+    sample_age.record(age);
+    return stale_timeout > 0 && age > stale_timeout;
+  }
+
+  // The last HISTORY_LENGTH samples, for anything that needs more than the latest one (filters, calibration, diagnostics).
+  // Lock free to read from any thread, see HistoryRing.hpp
+  static const size_t HISTORY_LENGTH = 64;
+  HistoryRing<Data, HISTORY_LENGTH> history;
+
+  // Stage latencies, see Metrics.h
+  LatencyHistogram refresh_latency;
+  LatencyHistogram error_check_latency;
+  LatencyHistogram sample_age;
+
+  // Jitter / overrun counters of the refresh loop (when not event driven)
+  PeriodicTimer & refresh_timer() {
+    return timer;
+  }
+
+  std::string handler_name() {
+    return name() + "_manager";
+  }
+
+  // Reactor mode: event driven managers refresh as soon as their fd is readable, the deadline is the fallback
+  int handler_fd() {
+    #ifdef SIM
+    return -1;
+    #else
+    return event_driven() ? source_fd() : -1;
+    #endif
+  }
+
+  void on_readable() {
+    refresh_step();
+    deadline = LatencyHistogram::now() + period;
+  }
+
+  void on_deadline() {
+    #ifdef SIM
+    // Same as the wait at the start of refresh_loop(), but the reactor thread can't block on it
+    if (!SimulatorManager::sim.loaded_scenario.is_set()) {
+      deadline += period;
+      return;
+    }
+    #endif
+    refresh_step();
+
+    // Skip any deadlines that were missed rather than refreshing back to back, same as PeriodicTimer
+    int64_t now = LatencyHistogram::now();
+    deadline += period;
+    if (deadline <= now) {
+      deadline += ((now - deadline) / period + 1) * period;
+    }
+  }
+
   bool is_running() {
     return running.load();
   }
 
+  // True if the refresh loop should wake on data arriving on source_fd(), 
+  // rather than only every refresh_timeout(). refresh_timeout() is still used as a fallback
+  bool event_driven() {
+    int32_t value = 0;
+    ConfiguratorManager::config.getValue(name()+"_manager_event_driven", value);
+    return value != 0;
+  }
+
   // returns how long this thread should sleep
   int64_t refresh_timeout() {
     int64_t value;
@@ -98,16 +212,26 @@ class SourceManagerBase {
     }
   }
 
+  // How old (in microseconds) a sample can get before it is reported as stale. 0 disables the check
+  int64_t stale_timeout_config() {
+    int64_t value = 0;
+    ConfiguratorManager::config.getValue(name()+"_stale_timeout", value);
+    return value;
+  }
+
   std::shared_ptr<Data> empty_data() {
-    std::shared_ptr<Data> d = std::make_shared<Data>();
-    memset(d.get(), (uint8_t)0, sizeof(Data));
-    return d;
+    return DataPool::make<Data>();
   }
 
+  #ifdef SIM
+  // Heap allocations made by refresh + publish since initialize(). Should stay 0, see ObjectPool.hpp
+  uint64_t steady_state_allocations() {
+    return refresh_allocations.load();
+  }
+  #endif
+
   void set_state(E_States new_state) {
-    mutex.lock();
-    current_state = new_state;
-    mutex.unlock();
+    current_state.store(new_state);
   }
 
   // Need to be public for testing purposes
@@ -128,8 +252,75 @@ class SourceManagerBase {
   // constructs a new Data object and fills it in with data from the simulator
   virtual std::shared_ptr<Data> refresh_sim() = 0;  
 
+  // fd that becomes readable when new data is available, or -1 if the source can't signal readiness.
+  // Only used if <name>_manager_event_driven is set. refresh() must not block when it is called after a wakeup
+  virtual int source_fd() {
+    return -1;
+  }
+
+  // Sets up the Poller if this manager should run event driven. Returns false if it should run on the timer
+  bool setup_poller() {
+    #ifdef SIM
+    return false;  // Simulated sources have no file descriptors
+    #else
+    if (!event_driven()) {
+      return false;
+    }
+    int fd = source_fd();
+    if (fd < 0) {
+      print(LogLevel::LOG_ERROR, "%s manager has no fd to wait on, using timer refresh\n", name().c_str());
+      return false;
+    }
+    if (!poller.open() || !poller.add(fd)) {
+      print(LogLevel::LOG_ERROR, "%s manager poller setup failed, using timer refresh\n", name().c_str());
+      poller.close();
+      return false;
+    }
+    print(LogLevel::LOG_INFO, "%s manager running event driven\n", name().c_str());
+    return true;
+    #endif
+  }
+
+  // Stamps data with the capture time (0 if it wasn't captured) and the next sequence number, then publishes it
+  void publish(const Data & data, int64_t timestamp) {
+    Sample<Data> sample;
+    sample.header.timestamp = timestamp;
+    sample.header.sequence = ++sequence;
+    sample.data = data;
+    snapshot.store(sample);
+    history.push(sample);
+    Notifications::logic_loop.notify();
+  }
+
+  // Refresh, publish and check for errors once. Returns the (possibly updated, in SIM) refresh period
+  int64_t refresh_step() {
+    int64_t delayInUsecs = period / 1000;
+    int64_t start = LatencyHistogram::now();
+    #ifndef SIM
+      std::shared_ptr<Data> new_data = refresh();
+    #else
+      uint64_t allocations = AllocationCounter::thread_allocations();
+      std::shared_ptr<Data> new_data = refresh_sim();
+    #endif
+    int64_t refreshed = LatencyHistogram::now();
+    publish(*new_data, refreshed);
+    refresh_latency.record(refreshed - start);
+    #ifdef SIM
+      refresh_allocations += AllocationCounter::thread_allocations() - allocations;
+      delayInUsecs = refresh_timeout();  // could be updated by SIM
+      period = delayInUsecs * 1000;
+    #endif
+
+    int64_t check_start = LatencyHistogram::now();
+    check_for_sensor_error(new_data, current_state.load());
+    error_check_latency.record(LatencyHistogram::now() - check_start);
+    return delayInUsecs;
+  }
+
   void refresh_loop() {
-    int64_t delayInUsecs = refresh_timeout();
+    ThreadConfig::apply(name() + "_manager");
+    period = refresh_timeout() * 1000;
+    int64_t delayInUsecs = period / 1000;
 
     // Solves a problem where the scenario isn't loaded yet, so we end up throwing errors because
     //   all the data defaults to Zeros.
@@ -138,27 +329,47 @@ class SourceManagerBase {
     SimulatorManager::sim.loaded_scenario.wait();  // Wait for loaded 
     #endif
 
+    timer.start(delayInUsecs);
+
     while (running.load()) {
-      #ifndef SIM
-        std::shared_ptr<Data> new_data = refresh();
-      #else
-        std::shared_ptr<Data> new_data = refresh_sim();
-        delayInUsecs = refresh_timeout();  // could be updated by SIM
-      #endif
-      mutex.lock();
-      data = new_data;
-      check_for_sensor_error(new_data, current_state);
-      mutex.unlock();
-      
-      closing.wait_for(delayInUsecs);
+      delayInUsecs = refresh_step();
+      timer.set_period(delayInUsecs);
+
+      if (use_poller) {
+        int result = poller.wait(delayInUsecs);  // Wakes on new data, stop(), or the timeout
+        if (result == Poller::HANGUP || result == Poller::FAILED) {
+          // Level triggered: a dead fd (ex: CAN interface down, ADC device removed) would wake it back to back
+          print(LogLevel::LOG_ERROR, "%s manager %s, using timer refresh\n", name().c_str(),
+                result == Poller::HANGUP ? "fd reported an error" : "poll failed");
+          {
+            std::lock_guard<std::mutex> guard(poller_mutex);
+            poller.close();
+          }
+          use_poller = false;
+          timer.start(delayInUsecs);
+        }
+      } else {
+        timer.wait(&closing);
+      }
+    }
+    if (!use_poller) {
+      timer.print_stats(name() + "_manager");
     }
   }
 
-  E_States current_state;
-  std::shared_ptr<Data> data;
-  std::mutex mutex;
+  std::atomic<E_States> current_state;
+  SeqLock<Sample<Data>> snapshot;
+  uint32_t sequence;  // Only touched by whoever is publishing (initialize(), then the refresh loop)
+  int64_t stale_timeout;  // nanoseconds
+  std::atomic<uint64_t> refresh_allocations;
   std::atomic<bool> running;
   Event closing;
+  Poller poller;
+  std::mutex poller_mutex;  // Held to close() or wake() the poller from different threads
+  PeriodicTimer timer;
+  bool use_poller;
+  bool hosted;      // Run by a Reactor rather than refresh_loop()
+  int64_t period;   // nanoseconds, refresh_timeout() as of the latest refresh
   std::thread worker;
   bool initialized_correctly;
 };
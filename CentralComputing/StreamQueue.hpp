@@ -0,0 +1,88 @@
+#ifndef STREAMQUEUE_HPP
+#define STREAMQUEUE_HPP
+
+#include <string.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// What a StreamQueue does with a snapshot while the ones before it are still waiting to be sent
+enum class DropPolicy {
+  LATEST_WINS,  // Only the newest snapshot matters, it replaces the one waiting (counted as a drop)
+  NEVER_DROP    // Every change is kept, in order
+};
+
+// Bounded queue of snapshots of one telemetry stream, between sampling and a socket that may not keep up
+//
+// NEVER_DROP skips a snapshot identical to the last one queued, so it only grows while the value is changing
+// faster than it can be sent. If it still fills up, the newest snapshot overwrites the last one queued: the
+// receiver misses an intermediate value but always ends on the current one. That is counted as a drop too.
+//
+// Only ONE thread may push() and pop(), the counters can be read from any thread
+template <class T, size_t N>
+class StreamQueue {
+ public:
+  explicit StreamQueue(DropPolicy drop_policy) : policy(drop_policy), head(0), count(0), high_water_mark(0),
+                                                 drop_count(0) {}
+
+  void push(const T & value) {
+    size_t size = count.load(std::memory_order_relaxed);
+    if (size > 0) {
+      T & tail = slots[(head + size - 1) % N];
+      if (policy == DropPolicy::NEVER_DROP && memcmp(&tail, &value, sizeof(T)) == 0) {
+        return;  // No change to keep
+      }
+      if (policy == DropPolicy::LATEST_WINS || size == N) {
+        tail = value;
+        drop_count.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    slots[(head + size) % N] = value;
+    count.store(size + 1, std::memory_order_relaxed);
+    if (size + 1 > high_water_mark.load(std::memory_order_relaxed)) {
+      high_water_mark.store(size + 1, std::memory_order_relaxed);
+    }
+  }
+
+  /*
+   * @return false if nothing is waiting
+   */
+  bool pop(T * value) {
+    size_t size = count.load(std::memory_order_relaxed);
+    if (size == 0) {
+      return false;
+    }
+    *value = slots[head];
+    head = (head + 1) % N;
+    count.store(size - 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /*
+   * Empties the queue, keeping the counters
+   */
+  void clear() {
+    head = 0;
+    count.store(0, std::memory_order_relaxed);
+  }
+
+  void reset_stats() {
+    high_water_mark.store(count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    drop_count.store(0, std::memory_order_relaxed);
+  }
+
+  size_t depth() const { return count.load(std::memory_order_relaxed); }
+  size_t high_water() const { return high_water_mark.load(std::memory_order_relaxed); }
+  uint64_t dropped() const { return drop_count.load(std::memory_order_relaxed); }
+
+ private:
+  DropPolicy policy;
+  T slots[N];
+  size_t head;
+  std::atomic<size_t> count;
+  std::atomic<size_t> high_water_mark;
+  std::atomic<uint64_t> drop_count;
+};
+
+#endif  // STREAMQUEUE_HPP
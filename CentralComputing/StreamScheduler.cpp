@@ -0,0 +1,96 @@
+#include "StreamScheduler.h"
+#include "Utils.h"
+#include <algorithm>
+
+using Utils::print;
+using Utils::LogLevel;
+
+const int64_t StreamScheduler::NEVER;
+
+StreamScheduler::Stream::Stream(const std::string & stream_name, int64_t stream_period, int64_t stream_phase,
+                                int32_t stream_priority) :
+  name(stream_name), period(stream_period), phase(stream_phase), priority(stream_priority), deadline(NEVER),
+  runs(0), missed(0) {
+}
+
+StreamScheduler::Stream::Stream(const Stream & other) :
+  name(other.name), period(other.period), phase(other.phase), priority(other.priority), deadline(other.deadline),
+  runs(other.runs.load()), missed(other.missed.load()) {
+}
+
+size_t StreamScheduler::add(const std::string & name, int64_t period, int64_t phase, int32_t priority) {
+  streams.push_back(Stream(name, period, phase, priority));
+  sort_by_priority();
+  return streams.size() - 1;
+}
+
+void StreamScheduler::set(size_t stream, int64_t period, int64_t phase, int32_t priority) {
+  streams[stream].period = period;
+  streams[stream].phase = phase;
+  streams[stream].priority = priority;
+  sort_by_priority();
+}
+
+void StreamScheduler::sort_by_priority() {
+  order.resize(streams.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  // Stable, so streams with the same priority keep the order they were added in
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return streams[a].priority < streams[b].priority;
+  });
+}
+
+void StreamScheduler::start(int64_t now) {
+  for (Stream & stream : streams) {
+    stream.deadline = stream.period > 0 ? now + stream.phase : NEVER;
+    stream.runs.store(0);
+    stream.missed.store(0);
+  }
+}
+
+int64_t StreamScheduler::next_due() const {
+  int64_t next = NEVER;
+  for (const Stream & stream : streams) {
+    next = std::min(next, stream.deadline);
+  }
+  return next;
+}
+
+size_t StreamScheduler::poll(int64_t now, size_t * due, size_t max) {
+  size_t count = 0;
+  for (size_t index : order) {
+    Stream & stream = streams[index];
+    if (stream.deadline > now || count == max) {
+      continue;
+    }
+    due[count++] = index;
+    stream.runs++;
+    stream.deadline += stream.period;
+    if (stream.deadline <= now) {
+      // Missed at least one more deadline. Skip ahead to the next one in the future
+      int64_t skipped = (now - stream.deadline) / stream.period + 1;
+      stream.missed.fetch_add(static_cast<uint64_t>(skipped));
+      stream.deadline += skipped * stream.period;
+    }
+  }
+  return count;
+}
+
+uint64_t StreamScheduler::runs(size_t stream) const {
+  return streams[stream].runs.load();
+}
+
+uint64_t StreamScheduler::missed(size_t stream) const {
+  return streams[stream].missed.load();
+}
+
+void StreamScheduler::print_stats(const std::string & loop_name) const {
+  for (size_t index : order) {
+    const Stream & stream = streams[index];
+    print(LogLevel::LOG_INFO, "%s %-8s period %8ld us phase %8ld us priority %d: %lu runs, %lu missed\n",
+          loop_name.c_str(), stream.name.c_str(), (long) stream.period, (long) stream.phase,  // NOLINT
+          stream.priority, (unsigned long) stream.runs.load(), (unsigned long) stream.missed.load());  // NOLINT
+  }
+}
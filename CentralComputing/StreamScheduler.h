@@ -0,0 +1,89 @@
+#ifndef STREAMSCHEDULER_H_
+#define STREAMSCHEDULER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Decides which of a set of periodic streams are due, for a loop that sleeps until the next one
+//
+// Each stream has its own period, a phase offset (its first deadline is start + phase, so streams with the same
+// period can be spread out instead of all landing together) and a priority (lower runs first when several are due
+// at once). Like PeriodicTimer, deadlines are absolute: next = previous + period, and a stream that fell more than
+// a period behind skips ahead instead of catching up in a burst, counting the periods it missed.
+//
+// Times are CLOCK_MONOTONIC microseconds (PeriodicTimer::monotonic_nanos() / 1000).
+// Only ONE thread may use it, the counters can be read from any thread
+class StreamScheduler {
+ public:
+  static const int64_t NEVER = INT64_MAX;
+
+  /*
+   * Adds a stream. A period <= 0 disables it
+   * @return its index, in the order added
+   */
+  size_t add(const std::string & name, int64_t period, int64_t phase, int32_t priority);
+
+  /*
+   * Changes a stream's schedule, takes effect at the next start()
+   */
+  void set(size_t stream, int64_t period, int64_t phase, int32_t priority);
+
+  /*
+   * Makes every stream first due at now + its phase, and clears the counters
+   */
+  void start(int64_t now);
+
+  /*
+   * When the earliest stream is due, NEVER if every stream is disabled
+   */
+  int64_t next_due() const;
+
+  /*
+   * Collects the streams due at now, highest priority first, and moves each one on to its next deadline
+   * @return the number of stream indexes put in due (all of them if max >= size())
+   */
+  size_t poll(int64_t now, size_t * due, size_t max);
+
+  /*
+   * Stream indexes, highest priority first
+   */
+  const std::vector<size_t> & by_priority() const { return order; }
+
+  size_t size() const { return streams.size(); }
+  const std::string & name(size_t stream) const { return streams[stream].name; }
+  int64_t period(size_t stream) const { return streams[stream].period; }
+  int64_t phase(size_t stream) const { return streams[stream].phase; }
+  int32_t priority(size_t stream) const { return streams[stream].priority; }
+
+  // Counters since start()
+  uint64_t runs(size_t stream) const;    // Times it was due
+  uint64_t missed(size_t stream) const;  // Deadlines skipped because the loop was late by more than a period
+
+  /*
+   * Prints each stream's schedule and counters, labeled with the loop's name
+   */
+  void print_stats(const std::string & loop_name) const;
+
+ private:
+  struct Stream {
+    std::string name;
+    int64_t period;
+    int64_t phase;
+    int32_t priority;
+    int64_t deadline;
+    std::atomic<uint64_t> runs;
+    std::atomic<uint64_t> missed;
+
+    Stream(const std::string & stream_name, int64_t stream_period, int64_t stream_phase, int32_t stream_priority);
+    Stream(const Stream & other);
+  };
+
+  void sort_by_priority();
+
+  std::vector<Stream> streams;
+  std::vector<size_t> order;
+};
+
+#endif  // STREAMSCHEDULER_H_
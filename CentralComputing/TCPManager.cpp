@@ -1,5 +1,10 @@
 #include "TCPManager.h"
 #include "Command.h"
+#include "ThreadConfig.h"
+#include "Telemetry.h"
+#include "PeriodicTimer.h"
+#include <algorithm>
+#include <map>
 
 using std::vector;
 using std::thread;
@@ -29,9 +34,23 @@ E_States TCPManager::state;
 
 std::mutex TCPManager::data_mutex;  
 int64_t TCPManager::write_loop_timeout;
-
-int64_t TCPManager::stagger_times[4];   // For sendig data to the TCP Write loop
-int64_t TCPManager::last_sent_times[4];   // For sending data to the TCP Write loop
+int32_t TCPManager::mode = TCP_MODE_CLIENT;
+std::shared_ptr<TelemetryFanout> TCPManager::fanout;
+int32_t TCPManager::telemetry_format;
+int64_t TCPManager::write_stall_timeout;
+uint32_t TCPManager::telemetry_sequence = 0;
+Telemetry::Encoder TCPManager::encoder;
+std::atomic<bool> TCPManager::keyframe_requested(false);
+
+StreamScheduler TCPManager::scheduler;
+
+std::atomic<uint64_t> TCPManager::bytes_written(0);
+std::atomic<uint64_t> TCPManager::write_syscalls(0);
+std::atomic<uint64_t> TCPManager::write_batches(0);
+std::atomic<int64_t> TCPManager::write_stats_start(0);
+std::atomic<uint64_t> TCPManager::commands_read(0);
+std::atomic<uint64_t> TCPManager::read_syscalls(0);
+std::atomic<uint64_t> TCPManager::command_waits(0);
 
 int TCPManager::connect_to_server(const char * hostname, const char * port) {
   std::lock_guard<std::mutex> guard(setup_shutdown_mutex);  // Used to protect socketfd (TSan datarace)
@@ -60,134 +79,501 @@ int TCPManager::connect_to_server(const char * hostname, const char * port) {
   }
 
   freeaddrinfo(servinfo);
+  // Each write is a whole batch of frames, let it go out now instead of waiting on Nagle
+  int nodelay = 1;
+  setsockopt(socketfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
   return socketfd;
 }
 
+int TCPManager::listen_for_clients(const char * hostname, const char * port) {
+  struct addrinfo hints, *servinfo;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if (getaddrinfo(hostname, port, &hints, &servinfo) != 0) {
+    print(LogLevel::LOG_ERROR, "TCP Error getaddrinfo()\n");
+    return -1;
+  }
+  int fd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol);
+  if (fd == -1) {
+    freeaddrinfo(servinfo);
+    print(LogLevel::LOG_ERROR, "TCP Error getting socket: socket()\n");
+    return -1;
+  }
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(fd, servinfo->ai_addr, servinfo->ai_addrlen) == -1 || listen(fd, 8) == -1) {
+    close(fd);
+    freeaddrinfo(servinfo);
+    print(LogLevel::LOG_ERROR, "TCP Error listening on %s:%s\n", hostname, port);
+    return -1;
+  }
+  freeaddrinfo(servinfo);
+  return fd;
+}
+
+namespace {
+// Sampled snapshots waiting on the socket. Errors and state changes all reach the base station, of everything else
+// only the latest is worth sending
+struct Outbound {
+  StreamQueue<MotionData, 1> motion{DropPolicy::LATEST_WINS};
+  StreamQueue<Errors, TCP_QUEUE_CAPACITY> errors{DropPolicy::NEVER_DROP};
+  StreamQueue<E_States, TCP_QUEUE_CAPACITY> state{DropPolicy::NEVER_DROP};
+  StreamQueue<CANData, 1> can{DropPolicy::LATEST_WINS};
+  StreamQueue<PRUData, 1> pru{DropPolicy::LATEST_WINS};
+  StreamQueue<I2CData, 1> i2c{DropPolicy::LATEST_WINS};
+  StreamQueue<ADCData, 1> adc{DropPolicy::LATEST_WINS};
+  StreamQueue<BMSCells, 1> bms{DropPolicy::LATEST_WINS};
+
+  size_t depth() const {
+    return motion.depth() + errors.depth() + state.depth() + can.depth() + pru.depth() + i2c.depth() +
+           adc.depth() + bms.depth();
+  }
+
+  size_t high_water() const {
+    return motion.high_water() + errors.high_water() + state.high_water() + can.high_water() +
+           pru.high_water() + i2c.high_water() + adc.high_water() + bms.high_water();
+  }
+
+  uint64_t dropped() const {
+    return motion.dropped() + errors.dropped() + state.dropped() + can.dropped() + pru.dropped() +
+           i2c.dropped() + adc.dropped() + bms.dropped();
+  }
+
+  void clear() {
+    motion.clear(); errors.clear(); state.clear(); can.clear(); pru.clear(); i2c.clear(); adc.clear(); bms.clear();
+  }
+
+  void reset_stats() {
+    motion.reset_stats(); errors.reset_stats(); state.reset_stats(); can.reset_stats(); pru.reset_stats();
+    i2c.reset_stats(); adc.reset_stats(); bms.reset_stats();
+  }
+};
+
+Outbound outbound;
+
+struct StreamDefaults {
+  const char * name;
+  int64_t period;
+  int32_t priority;
+};
+
+// Indexed by TelemetryStream. The rates the write loop always had, errors and state ahead of everything else
+const StreamDefaults stream_defaults[TCPManager::STREAM_COUNT] = {
+  {"motion", 1000000, 1}, {"errors", 1000000, 0}, {"state", 1000000, 0}, {"can", 3000000, 2},
+  {"pru", 6000000, 3}, {"i2c", 6000000, 3}, {"adc", 6000000, 3}, {"bms", 2000000, 2}
+};
+
+// Copies the stream's latest data into its queue
+void sample(size_t stream) {
+  using namespace TCPManager;  // NOLINT
+  switch (stream) {
+    case STREAM_MOTION:
+      data_mutex.lock();  // Protect access to TCPManger::data_to_send
+      memcpy(&motion_data, unified_state->motion_data.get(), sizeof(MotionData));
+      data_mutex.unlock();
+      outbound.motion.push(motion_data);
+      break;
+    case STREAM_ERRORS:
+      data_mutex.lock();
+      memcpy(&error_data, unified_state->errors.get(), sizeof(Errors));
+      data_mutex.unlock();
+      outbound.errors.push(error_data);
+      break;
+    case STREAM_STATE:
+      data_mutex.lock();
+      state = unified_state->state;
+      data_mutex.unlock();
+      outbound.state.push(state);
+      break;
+    case STREAM_CAN:
+      data_mutex.lock();
+      memcpy(&can_data, unified_state->can_data.get(), sizeof(CANData));
+      data_mutex.unlock();
+      outbound.can.push(can_data);
+      break;
+    case STREAM_PRU:
+      data_mutex.lock();
+      memcpy(&pru_data, unified_state->pru_data.get(), sizeof(PRUData));
+      data_mutex.unlock();
+      outbound.pru.push(pru_data);
+      break;
+    case STREAM_I2C:
+      data_mutex.lock();
+      memcpy(&i2c_data, unified_state->i2c_data.get(), sizeof(I2CData));
+      data_mutex.unlock();
+      outbound.i2c.push(i2c_data);
+      break;
+    case STREAM_ADC:
+      data_mutex.lock();
+      memcpy(&adc_data, unified_state->adc_data.get(), sizeof(ADCData));
+      data_mutex.unlock();
+      outbound.adc.push(adc_data);
+      break;
+    case STREAM_BMS:
+      SourceManager::CAN.cell_data_mutex.lock();  
+      memcpy(&bms_data, &SourceManager::CAN.public_cell_data, sizeof(BMSCells));
+      SourceManager::CAN.cell_data_mutex.unlock();  
+      outbound.bms.push(bms_data);
+      break;
+    default:
+      break;
+  }
+}
+
+const size_t RAW_BATCH_SIZE = 8 + sizeof(MotionData) + sizeof(Errors) + sizeof(E_States) + sizeof(CANData) +
+                              sizeof(PRUData) + sizeof(I2CData) + sizeof(ADCData) + sizeof(BMSCells);
+const size_t MAX_BATCH_SIZE = RAW_BATCH_SIZE > Telemetry::MAX_PACKET_SIZE ? RAW_BATCH_SIZE :
+                                                                             Telemetry::MAX_PACKET_SIZE;
+
+// The batch being sent. Once it has started going out it has to finish, the stream would be corrupt otherwise
+uint8_t pending[MAX_BATCH_SIZE];
+size_t pending_size = 0;
+size_t pending_sent = 0;
+int64_t last_progress = 0;  // When the socket last took bytes, or the batch was built
+
+// One snapshot from every stream waiting. Either [1 byte ID][struct] each (TELEMETRY_FORMAT_RAW),
+// or one Telemetry packet with a record each (TELEMETRY_FORMAT_PACKED)
+struct Batch {
+  uint8_t * out;
+  size_t size = 0;
+
+  explicit Batch(uint8_t * buffer) : out(buffer) {}
+
+  template <class T, size_t N>
+  void take(uint8_t id, StreamQueue<T, N> & queue) {
+    T data;
+    if (queue.pop(&data)) {
+      add(id, data);
+    }
+  }
+
+  template <class T>
+  void add(uint8_t id, const T & data) {
+    if (TCPManager::telemetry_format == TELEMETRY_FORMAT_RAW) {
+      out[size] = id;
+      memcpy(out + size + 1, &data, sizeof(T));
+      size += 1 + sizeof(T);
+      return;
+    }
+    if (size == 0) {
+      if (TCPManager::keyframe_requested.exchange(false)) {
+        TCPManager::encoder.request_keyframe();
+      }
+      size = TCPManager::encoder.begin_packet(out, TCPManager::telemetry_sequence++, Utils::microseconds());
+    }
+    size += TCPManager::encoder.encode(data, out + size);  // 0 if unchanged since the last packet
+  }
+
+  // Takes the stream's oldest snapshot waiting
+  void take(size_t stream) {
+    const TCPManager::TCPSendIDs & ids = TCPManager::TCPID;
+    switch (stream) {
+      case TCPManager::STREAM_MOTION: take(ids.motion_id, outbound.motion); break;
+      case TCPManager::STREAM_ERRORS: take(ids.error_id, outbound.errors); break;
+      case TCPManager::STREAM_STATE:  take(ids.state_id, outbound.state); break;
+      case TCPManager::STREAM_CAN:    take(ids.can_id, outbound.can); break;
+      case TCPManager::STREAM_PRU:    take(ids.pru_id, outbound.pru); break;
+      case TCPManager::STREAM_I2C:    take(ids.i2c_id, outbound.i2c); break;
+      case TCPManager::STREAM_ADC:    take(ids.adc_id, outbound.adc); break;
+      case TCPManager::STREAM_BMS:    take(ids.bms_id, outbound.bms); break;
+      default: break;
+    }
+  }
+
+  // Call once everything is added. @return the batch size
+  size_t finish() {
+    if (size > 0 && TCPManager::telemetry_format != TELEMETRY_FORMAT_RAW) {
+      Telemetry::finish_packet(out, size);
+    }
+    return size;
+  }
+};
+
+// Fills out with the next batch, highest priority stream first. @return its size, 0 if nothing is waiting
+size_t build_batch(uint8_t * out) {
+  Batch batch(out);
+  for (size_t stream : TCPManager::scheduler.by_priority()) {
+    batch.take(stream);
+  }
+  return batch.finish();
+}
+
+// Server mode's flush_data(): every batch is encoded once and handed to every client
+int publish_data() {
+  using namespace TCPManager;  // NOLINT
+  uint8_t packet[MAX_BATCH_SIZE];
+  size_t size;
+  while ((size = build_batch(packet)) > 0) {
+    bool resync_point = telemetry_format == TELEMETRY_FORMAT_RAW || encoder.starts_keyframe();
+    if (fanout->publish(packet, size, resync_point)) {
+      keyframe_requested.store(true);  // So the client that fell behind can pick the stream back up soon
+    }
+    write_batches.fetch_add(1, std::memory_order_relaxed);
+  }
+  uint64_t syscalls = fanout->syscalls.load();
+  size_t sent = fanout->flush(write_stall_timeout);
+  write_syscalls.fetch_add(fanout->syscalls.load() - syscalls, std::memory_order_relaxed);
+  bytes_written.fetch_add(sent, std::memory_order_relaxed);
+  return (int) sent;
+}
+
+// Sleeps until a socket with telemetry waiting can take more, closing is invoked, or micros pass
+void wait_writable(int64_t micros) {
+  using namespace TCPManager;  // NOLINT
+  std::vector<struct pollfd> fds;
+  fds.push_back({closing.fd(), POLLIN, 0});
+  if (fanout) {
+    for (int fd : fanout->pending()) {
+      fds.push_back({fd, POLLOUT, 0});
+    }
+  } else {
+    fds.push_back({socketfd, POLLOUT, 0});
+  }
+  poll(fds.data(), fds.size(), (int) std::min<int64_t>(micros / 1000, 1000));
+}
+}  // namespace
+
 int TCPManager::write_data() {
-  int64_t cur_time = Utils::microseconds();
-  
-  // There must be an update, copy in data
-  //  This is the first time threshold
-  if (cur_time - last_sent_times[0] > stagger_times[0]) {
-    data_mutex.lock();  // Protect access to TCPManger::data_to_send
-    memcpy(&motion_data, unified_state->motion_data.get(), sizeof(MotionData));
-    memcpy(&error_data, unified_state->errors.get(), sizeof(Errors));
-    state = unified_state->state;
-    data_mutex.unlock();
-
-    last_sent_times[0] = cur_time;
-    if (
-        (write_all_to_socket(socketfd, &TCPID.motion_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t *>(&motion_data), sizeof(MotionData)) <= 0) ||  // NOLINT
-        (write_all_to_socket(socketfd, &TCPID.error_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&error_data), sizeof(Errors)) <= 0) ||  // NOLINT  
-        (write_all_to_socket(socketfd, &TCPID.state_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&state), sizeof(uint32_t)) <= 0)) {  // NOLINT
-      return -1;
-    }
-  }
-  //  This is the second time threshold 
-  if (cur_time - last_sent_times[1] > stagger_times[1]) {  
-    data_mutex.lock();  // Protect access to TCPManger::data_to_send
-    memcpy(&can_data, unified_state->can_data.get(), sizeof(CANData));
-    data_mutex.unlock();
-
-    last_sent_times[1] = cur_time;
-    if ((write_all_to_socket(socketfd, &TCPID.can_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&can_data), sizeof(CANData)) <= 0)) {  //NOLINT
-      return -1;
-    }
-  }
-  //  This is the third time threshold 
-  if (cur_time - last_sent_times[2] > stagger_times[2]) {  
-    data_mutex.lock();  // Protect access to TCPManger::data_to_send
-    memcpy(&pru_data, unified_state->pru_data.get(), sizeof(PRUData));
-    memcpy(&i2c_data, unified_state->i2c_data.get(), sizeof(I2CData));
-    memcpy(&adc_data, unified_state->adc_data.get(), sizeof(ADCData));
-    data_mutex.unlock();
-    last_sent_times[2] = cur_time;
-    if ((write_all_to_socket(socketfd, &TCPID.pru_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&pru_data), sizeof(PRUData)) <= 0) ||  //NOLINT
-        (write_all_to_socket(socketfd, &TCPID.i2c_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&i2c_data), sizeof(I2CData)) <= 0) ||  //NOLINT
-        (write_all_to_socket(socketfd, &TCPID.adc_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&adc_data), sizeof(ADCData))<= 0)) {  //NOLINT
-      return -1;
-    }
-  }  
-
-  // This is the fourth time threshold
-  if (cur_time - last_sent_times[3] > stagger_times[3]) {  
-    SourceManager::CAN.cell_data_mutex.lock();  
-    memcpy(&bms_data, &SourceManager::CAN.public_cell_data, sizeof(BMSCells));
-    SourceManager::CAN.cell_data_mutex.unlock();  
-    last_sent_times[3] = cur_time;
-    if ((write_all_to_socket(socketfd, &TCPID.bms_id, sizeof(uint8_t)) <= 0) ||
-        (write_all_to_socket(socketfd, reinterpret_cast<uint8_t*>(&bms_data), sizeof(BMSCells)) <= 0)) {  //NOLINT
-      return -1;
-    }
-  }  
-
-  return 1;  // Return success
+  size_t due[STREAM_COUNT];
+  size_t count = scheduler.poll(PeriodicTimer::monotonic_nanos() / 1000, due, STREAM_COUNT);
+  for (size_t i = 0; i < count; i++) {
+    sample(due[i]);
+  }
+  return flush_data();
+}
+
+int TCPManager::flush_data() {
+  if (fanout) {
+    return publish_data();
+  }
+  int total = 0;
+  while (true) {
+    if (pending_sent == pending_size) {
+      pending_size = build_batch(pending);
+      pending_sent = 0;
+      if (pending_size == 0) {
+        return total;  // Everything sent
+      }
+      last_progress = Utils::microseconds();
+    }
+
+    ssize_t sent = send(socketfd, pending + pending_sent, pending_size - pending_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    write_syscalls.fetch_add(1, std::memory_order_relaxed);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN) {  // EWOULDBLOCK is the same value on Linux
+        return -1;
+      }
+      // Socket buffer full, the rest waits for the next call
+      if (Utils::microseconds() - last_progress > write_stall_timeout) {
+        print(LogLevel::LOG_ERROR, "TCP write stalled for %ld us, dropping the connection\n",
+              (long) write_stall_timeout);  // NOLINT
+        return -1;
+      }
+      return total;
+    }
+    pending_sent += (size_t) sent;
+    total += (int) sent;
+    bytes_written.fetch_add((uint64_t) sent, std::memory_order_relaxed);
+    last_progress = Utils::microseconds();
+    if (pending_sent == pending_size) {
+      write_batches.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+bool TCPManager::output_pending() {
+  if (fanout) {
+    return !fanout->pending().empty();
+  }
+  return pending_sent < pending_size;
+}
+
+size_t TCPManager::queue_depth() {
+  return outbound.depth();
+}
+
+size_t TCPManager::queue_high_water() {
+  return outbound.high_water();
+}
+
+uint64_t TCPManager::frames_dropped() {
+  return outbound.dropped();
+}
+
+void TCPManager::request_keyframe() {
+  keyframe_requested.store(true);
+}
+
+void TCPManager::reset_write_stats() {
+  bytes_written.store(0);
+  write_syscalls.store(0);
+  write_batches.store(0);
+  outbound.reset_stats();
+  write_stats_start.store(Utils::microseconds());
+}
+
+void TCPManager::print_write_stats() {
+  double seconds = (Utils::microseconds() - write_stats_start.load()) / 1000000.0;
+  if (seconds <= 0) {
+    return;
+  }
+  uint64_t bytes = bytes_written.load();
+  uint64_t syscalls = write_syscalls.load();
+  print(LogLevel::LOG_INFO, "tcp_write: %lu batches, %lu bytes (%.1f bytes/s), %lu syscalls (%.1f syscalls/s)\n",
+        (unsigned long) write_batches.load(), (unsigned long) bytes, bytes / seconds,
+        (unsigned long) syscalls, syscalls / seconds);
+  print(LogLevel::LOG_INFO, "tcp_write queue: depth %lu, high water %lu, %lu snapshots dropped "
+        "(errors %lu, state %lu)\n", (unsigned long) queue_depth(), (unsigned long) queue_high_water(),
+        (unsigned long) frames_dropped(), (unsigned long) outbound.errors.dropped(),
+        (unsigned long) outbound.state.dropped());
 }
 
 void TCPManager::write_loop() {
+  ThreadConfig::apply("tcp_write_loop");
   bool active_connection = true;
+  scheduler.start(PeriodicTimer::monotonic_nanos() / 1000);
   while (running && active_connection) {
-    closing.wait_for(write_loop_timeout);
+    int64_t due = scheduler.next_due();
+    // While the socket is full, send the rest as it drains, waking up in time for the next stream
+    while (running && active_connection && output_pending() &&
+           due - PeriodicTimer::monotonic_nanos() / 1000 >= 1000) {
+      wait_writable(due - PeriodicTimer::monotonic_nanos() / 1000);
+      active_connection = flush_data() != -1;
+    }
+    if (!running || !active_connection) {
+      break;
+    }
+    if (due == StreamScheduler::NEVER) {
+      closing.wait();  // Every stream is disabled
+    } else {
+      closing.wait_until(due * 1000);
+    }
+    if (!running) {
+      break;
+    }
     int written = write_data();
     // print(LogLevel::LOG_DEBUG, "TCP Wrote %d bytes\n", written);
     active_connection = written != -1;
   }
+  if (!active_connection && !fanout) {
+    // The base station stalled or the write failed. Shut the socket down so read_loop() returns too,
+    // otherwise tcp_loop() would wait on it forever instead of reconnecting
+    std::lock_guard<std::mutex> guard(setup_shutdown_mutex);
+    shutdown(socketfd, SHUT_RDWR);
+  }
+  scheduler.print_stats("tcp_write_loop");
+  print_write_stats();
+  if (fanout) {
+    fanout->print_stats();
+  }
   print(LogLevel::LOG_INFO, "TCP write Loop exiting.\n");
 }
 
-int TCPManager::read_command(uint32_t * id, uint32_t * com) {
-  uint8_t bytes[sizeof(Command::Network_Command)];
-  int bytes_read = read(socketfd, bytes, sizeof(bytes));
-  *id =  *(reinterpret_cast<uint32_t*>(bytes));
-  *com = *(reinterpret_cast<uint32_t*>((bytes+4)));
-  return bytes_read;
+int TCPManager::read_commands(CommandReader * reader) {
+  ssize_t bytes_read = reader->fill();
+  if (bytes_read <= 0) {
+    return (int) bytes_read;
+  }
+  read_syscalls++;
+  Command::Network_Command commands[CommandReader::MAX_COMMANDS];
+  size_t count = reader->decode(commands, CommandReader::MAX_COMMANDS);
+  size_t queued = Command::put_batch(commands, count);
+  while (queued < count && running) {
+    command_waits++;
+    closing.wait_for(TCP_COMMAND_RETRY_WAIT);
+    queued += Command::put_batch(commands + queued, count - queued);
+  }
+  commands_read.fetch_add(queued);
+  return (int) bytes_read;
+}
+
+void TCPManager::configure_streams() {
+  for (size_t stream = 0; stream < STREAM_COUNT; stream++) {
+    const StreamDefaults & defaults = stream_defaults[stream];
+    std::string key = std::string("tcp_stream_") + defaults.name;
+    int64_t period = defaults.period;
+    int64_t phase = 0;
+    int32_t priority = defaults.priority;
+    // All optional
+    ConfiguratorManager::config.getValue(key + "_period", period);
+    ConfiguratorManager::config.getValue(key + "_phase", phase);
+    ConfiguratorManager::config.getValue(key + "_priority", priority);
+    if (stream < scheduler.size()) {
+      scheduler.set(stream, period, phase, priority);
+    } else {
+      scheduler.add(defaults.name, period, phase, priority);
+    }
+  }
 }
 
 void TCPManager::read_loop() {
+  ThreadConfig::apply("tcp_read_loop");
   bool active_connection = true;
-  uint32_t ID;
-  uint32_t Command;
+  CommandReader reader(socketfd);
   while (running && active_connection) {
-    int bytes_read = read_command(&ID, &Command);
-    active_connection = bytes_read > 0;
-    if (bytes_read > 0) {
-      Command::put(ID, Command);
-      // print(LogLevel::LOG_EDEBUG, "Bytes read: %d Read command %d %d\n", bytes_read, ID, Command);
-    }
+    active_connection = read_commands(&reader) > 0;
   }
+  if (reader.buffered() > 0) {
+    print(LogLevel::LOG_ERROR, "TCP connection ended part way through a command (%lu bytes)\n",
+          (unsigned long) reader.buffered());  // NOLINT
+  }
+  print(LogLevel::LOG_INFO, "tcp_read: %lu commands in %lu reads, waited for room %lu times\n",
+        (unsigned long) commands_read.load(), (unsigned long) read_syscalls.load(),  // NOLINT
+        (unsigned long) command_waits.load());  // NOLINT
   print(LogLevel::LOG_INFO, "TCP read Loop exiting.\n");
 }
 
 void TCPManager::tcp_loop(const char * hostname, const char * port, UnifiedState * uni_state) {
+  ThreadConfig::apply("tcp_loop");
   connected.reset();
   closing.reset();
   running.store(true);
 
   unified_state = uni_state;
 
-  if (!( ConfiguratorManager::config.getValue("tcp_write_loop_timeout", write_loop_timeout) &&
-      ConfiguratorManager::config.getValue("tcp_stagger_time1", stagger_times[0]) &&
-      ConfiguratorManager::config.getValue("tcp_stagger_time2", stagger_times[1]) &&
-      ConfiguratorManager::config.getValue("tcp_stagger_time3", stagger_times[2]) &&
-      ConfiguratorManager::config.getValue("tcp_stagger_time4", stagger_times[3]))) {
+  if (!ConfiguratorManager::config.getValue("tcp_write_loop_timeout", write_loop_timeout)) {
     print(LogLevel::LOG_ERROR, "TCP CONFIG FILE ERROR: Missing necessary configuration\n");
     exit(1);  // Crash hard on this error
   }
-  last_sent_times[0] = -1000000;  // Initialize these times to a large negative number, so sending happens right away
-  last_sent_times[1] = -1000000;
-  last_sent_times[2] = -1000000;
+  // Optional, defaults to the packed schema
+  telemetry_format = TELEMETRY_FORMAT_PACKED;
+  ConfiguratorManager::config.getValue("tcp_telemetry_format", telemetry_format);
+  // Optional, microseconds between keyframes. 0 sends every record whole
+  int64_t keyframe_period = 5000000;
+  ConfiguratorManager::config.getValue("tcp_telemetry_keyframe_period", keyframe_period);
+  encoder.set_keyframe_period(keyframe_period);
+  // Optional, how long a base station that stopped reading is waited on
+  write_stall_timeout = 5000000;
+  ConfiguratorManager::config.getValue("tcp_write_stall_timeout", write_stall_timeout);
+  configure_streams();
+  reset_write_stats();
+  commands_read.store(0);
+  read_syscalls.store(0);
+  command_waits.store(0);
+
+  // Optional, defaults to connecting out to the base station
+  mode = TCP_MODE_CLIENT;
+  ConfiguratorManager::config.getValue("tcp_mode", mode);
+  if (mode == TCP_MODE_SERVER) {
+    server_loop(hostname, port);
+    connected.reset();
+    print(LogLevel::LOG_INFO, "TCP Exiting loop\n");
+    return;
+  }
 
   while (running) {
     int fd = connect_to_server(hostname, port);
     if (fd > 0) {
       print(LogLevel::LOG_INFO, "TCP Connection Acquired, starting network threads\n");
+      encoder.request_keyframe();  // A new server has nothing to apply deltas to
+      outbound.clear();  // Or any use for what the last one never got
+      pending_size = 0;
+      pending_sent = 0;
       thread read_thread(read_loop);
       thread write_thread(write_loop);
 
@@ -228,6 +614,92 @@ void TCPManager::tcp_loop(const char * hostname, const char * port, UnifiedState
   print(LogLevel::LOG_INFO, "TCP Exiting loop\n");
 }
 
+void TCPManager::server_loop(const char * hostname, const char * port) {
+  int32_t max_clients = 4;  // Optional
+  ConfiguratorManager::config.getValue("tcp_max_clients", max_clients);
+
+  int listen_fd = -1;
+  while (running && (listen_fd = listen_for_clients(hostname, port)) < 0) {
+    Command::set_error_flag(Command::SET_NETWORK_ERROR, NETWORKErrors::TCP_DISCONNECT_ERROR);
+    closing.wait_for(write_loop_timeout);
+  }
+  if (listen_fd < 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(setup_shutdown_mutex);  // close_client() shuts socketfd down
+    socketfd = listen_fd;
+  }
+  print(LogLevel::LOG_INFO, "TCP listening on %s:%s for up to %d clients\n", hostname, port, max_clients);
+  outbound.clear();
+  fanout = std::make_shared<TelemetryFanout>((size_t) max_clients, TCP_CLIENT_QUEUE_CAPACITY);
+  thread write_thread(write_loop);
+  Command::set_error_flag(Command::SET_NETWORK_ERROR, NETWORKErrors::TCP_DISCONNECT_ERROR);  // Nobody yet
+
+  vector<int> clients;
+  std::map<int, CommandReader> readers;  // Each client's partial command
+  while (running) {
+    vector<struct pollfd> fds;
+    fds.push_back({closing.fd(), POLLIN, 0});
+    fds.push_back({listen_fd, POLLIN, 0});
+    for (int fd : clients) {
+      fds.push_back({fd, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+      print(LogLevel::LOG_ERROR, "TCP server poll() failed\n");
+      break;
+    }
+    if (!running) {
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd >= 0) {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        if (fanout->add(fd)) {
+          print(LogLevel::LOG_INFO, "TCP client %d connected, %lu connected\n", fd,
+                (unsigned long) fanout->clients());  // NOLINT
+          clients.push_back(fd);
+          readers[fd].reset(fd);
+          request_keyframe();  // It has nothing to apply deltas to
+          if (clients.size() == 1) {
+            Command::put(Command::CLR_NETWORK_ERROR, NETWORKErrors::TCP_DISCONNECT_ERROR);
+            connected.invoke();
+          }
+        } else {
+          print(LogLevel::LOG_ERROR, "TCP client refused, already %d connected\n", max_clients);
+          close(fd);
+        }
+      }
+    }
+
+    for (size_t i = 2; i < fds.size(); i++) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      if (read_commands(&readers[fds[i].fd]) > 0) {
+        continue;
+      }
+      readers.erase(fds[i].fd);
+      fanout->remove(fds[i].fd);  // Closed by the client, or shut down by the write loop
+      clients.erase(std::find(clients.begin(), clients.end(), fds[i].fd));
+      print(LogLevel::LOG_INFO, "TCP client %d disconnected, %lu connected\n", fds[i].fd,
+            (unsigned long) clients.size());  // NOLINT
+      if (clients.empty()) {
+        Command::set_error_flag(Command::SET_NETWORK_ERROR, NETWORKErrors::TCP_DISCONNECT_ERROR);
+      }
+    }
+  }
+
+  closing.invoke();
+  write_thread.join();
+  fanout->clear();
+  fanout.reset();
+  close(listen_fd);
+}
+
 void TCPManager::close_client() {
   std::lock_guard<std::mutex> guard(setup_shutdown_mutex);  // Used to protect socketfd (TSan datarace)
   running.store(false);  // Will cause the tcp_loop to exit once threads join.
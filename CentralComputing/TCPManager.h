@@ -7,7 +7,12 @@
 #include "SafeQueue.hpp"
 #include "SourceManager.h"
 #include "Event.h"
+#include "StreamScheduler.h"
 #include "Simulator.h"
+#include "Telemetry.h"
+#include "StreamQueue.hpp"
+#include "TelemetryFanout.h"
+#include "CommandReader.h"
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <stdlib.h>
@@ -19,14 +24,40 @@
 #include <memory>
 #include <mutex> // NOLINT
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #define SETUP_FAILURE -1
 #define SETUP_SUCCESS 0
 
 #define WRITE_FAILURE -1
 
+#define TCP_QUEUE_CAPACITY 16  // Changes of a NEVER_DROP stream (errors, state) that can wait on the socket
+
+#define TCP_MODE_CLIENT 0  // Connects out to one base station at tcp_addr:tcp_port, the original mode
+#define TCP_MODE_SERVER 1  // Listens on tcp_addr:tcp_port and sends telemetry to up to tcp_max_clients subscribers
+#define TCP_CLIENT_QUEUE_CAPACITY 64  // Packets a server mode client can fall behind by before it loses some
+#define TCP_COMMAND_RETRY_WAIT 1000  // Microseconds between tries when a command lane is full
+
+#define TELEMETRY_FORMAT_RAW 0     // [1 byte ID][struct as laid out in memory] per frame, the original format
+#define TELEMETRY_FORMAT_PACKED 1  // One packed, versioned packet per batch, see Telemetry.h
+
 namespace TCPManager {
 
+// Telemetry streams, each sent on its own schedule (tcp_stream_<name>_period, _phase and _priority)
+enum TelemetryStream : size_t {
+  STREAM_MOTION,
+  STREAM_ERRORS,
+  STREAM_STATE,
+  STREAM_CAN,
+  STREAM_PRU,
+  STREAM_I2C,
+  STREAM_ADC,
+  STREAM_BMS,
+  STREAM_COUNT
+};
+
 struct TCPSendIDs {
   uint8_t adc_id = 7;
   uint8_t can_id = 1;
@@ -52,10 +83,27 @@ extern PRUData pru_data;
 extern MotionData motion_data;
 extern Errors  error_data;
 extern E_States state;
-extern int64_t stagger_times[4];  // Used to stagger how frequently data is sent to tcp server 
-extern int64_t last_sent_times[4];   // Used to store the last time a data type was sent
+extern StreamScheduler scheduler;  // When each TelemetryStream is sampled, indexed by TelemetryStream
 extern std::mutex data_mutex;  
-extern int64_t write_loop_timeout;
+extern int64_t write_loop_timeout;  // Wait between connection attempts
+extern int32_t mode;                 // TCP_MODE_XXX, from tcp_mode
+extern std::shared_ptr<TelemetryFanout> fanout;  // Server mode's subscribers, null in client mode
+extern int32_t telemetry_format;     // TELEMETRY_FORMAT_XXX, from tcp_telemetry_format
+extern uint32_t telemetry_sequence;  // Sequence number of the next packet (write_loop() only)
+extern Telemetry::Encoder encoder;   // Packed records as deltas between keyframes (write_loop() only)
+extern std::atomic<bool> keyframe_requested;
+extern int64_t write_stall_timeout;  // Microseconds the socket can take nothing before the connection is dropped
+
+// Counted by write_data() since the last reset_write_stats() (every tcp_loop() start)
+extern std::atomic<uint64_t> bytes_written;
+extern std::atomic<uint64_t> write_syscalls;  // send() calls, one per batch unless the socket buffer filled up
+extern std::atomic<uint64_t> write_batches;
+extern std::atomic<int64_t> write_stats_start;  // Utils::microseconds()
+
+// Counted by read_commands() since tcp_loop() started
+extern std::atomic<uint64_t> commands_read;
+extern std::atomic<uint64_t> read_syscalls;   // read() calls that returned data, each one decoded in full
+extern std::atomic<uint64_t> command_waits;   // Times a full command lane held the rest of a read back
 
 extern Event connected;  // Used within Simulator to check when TCP is connected
 extern Event closing;    // Used to wait between writes in the write_loop()
@@ -64,38 +112,84 @@ extern std::mutex setup_shutdown_mutex;  // Used to eliminate TSan errors
 int connect_to_server(const char * hostname, const char * port);
 
 /**
- * Reads from socketfd, parses read bytes into a Network_Command struct
+ * Server mode: binds and listens on hostname:port
+ * @return the listening socket or -1 if failed
+ **/
+int listen_for_clients(const char * hostname, const char * port);
+
+/**
+ * Reads every stream's schedule from the config, defaulting to the rates the pod always had
+ **/
+void configure_streams();
+
+/**
+ * One read() from reader's socket, then every complete command in it is handed to Command in one batch.
+ * A full lane is waited on (nothing more is read meanwhile, so TCP slows the sender down) rather than dropping
+ * a command. A partial command stays in reader for the next call
  * Note: blocking command, will wait on read until something is sent or FD is closed
- * @param buffer a pointer to the network command that was read
- * @return the number of bytes read
+ * @return the number of bytes read, 0 if the other end closed, -1 if failed
  **/
-int read_command(uint32_t * ID, uint32_t * Command);
+int read_commands(CommandReader * reader);
 /**
  * Collects data from sensor, writes to socket
- * @param times timings for when to send specific data
- * @return bytes written or -1 if failed
+ * Every stream the scheduler has due is sampled into its StreamQueue, then as much as the socket takes without
+ * blocking is sent. Each batch (one snapshot from every stream waiting, highest priority first, in
+ * telemetry_format) goes out in a single send()
+ * @return bytes written (0 if nothing was due or the socket is full) or -1 if failed or stalled
  **/
 int write_data();
 
+/**
+ * Sends the rest of the queued telemetry, never blocks
+ * @return bytes written or -1 if failed or stalled for write_stall_timeout
+ **/
+int flush_data();
+
+/**
+ * True if the socket filled up with telemetry still waiting to be sent
+ **/
+bool output_pending();
+
+// Snapshots waiting on the socket, summed over every stream
+size_t queue_depth();
+size_t queue_high_water();  // Worst depth of each stream since reset_write_stats(), summed
+uint64_t frames_dropped();  // Snapshots replaced by newer ones before being sent
+
+/**
+ * Makes the next packet a keyframe, every record sent whole. Safe from any thread
+ * Sent by the base station (Command::REQUEST_KEYFRAME) when it has lost track of the deltas
+ **/
+void request_keyframe();
+
+void reset_write_stats();
+void print_write_stats();  // bytes/s, syscalls/s, queue depth and drops since reset_write_stats()
+
 /**
  * Thread function, continually reads commands from the socket and
- * pushes them onto the queue
+ * pushes them onto the queue, see read_commands()
  */
 void read_loop();
 
 /**
  * Thread function, continually gets most recent state/motor/brake/sensor
- * data and sends a packet
+ * data and sends a packet. Sleeps until the next stream is due
  */
 void write_loop();
 
 /**
  * Thread function, handles connecting to new clients and starting read/write loop
+ * In TCP_MODE_SERVER it runs server_loop() instead
  * @param hostname the IP address to connect to
  * @param port the port to connect to
  **/
 void tcp_loop(const char * hostname, const char * port, UnifiedState * unified_state);
 
+/**
+ * Server mode: accepts subscribers and reads their commands, while write_loop() sends every packet to all of them.
+ * The network error is set whenever there are no subscribers
+ **/
+void server_loop(const char * hostname, const char * port);
+
 /**
  * Closes the socket, ending all transmission
  **/
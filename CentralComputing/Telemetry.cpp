@@ -0,0 +1,224 @@
+#include "Telemetry.h"
+#include <string.h>
+#include <type_traits>
+
+namespace {
+// Little endian byte by byte, so the host's byte order and struct layout never reach the wire
+template <class T>
+void put(uint8_t ** out, T value) {
+  typedef typename std::make_unsigned<T>::type Bits;
+  Bits bits = static_cast<Bits>(value);
+  for (size_t i = 0; i < sizeof(T); i++) {
+    (*out)[i] = (uint8_t) (bits >> (8 * i));
+  }
+  *out += sizeof(T);
+}
+
+template <class T>
+T take(const uint8_t ** in) {
+  typename std::make_unsigned<T>::type bits = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    bits |= ((typename std::make_unsigned<T>::type) (*in)[i]) << (8 * i);
+  }
+  *in += sizeof(T);
+  return (T) bits;
+}
+
+size_t put_record_header(uint8_t * out, uint8_t type, size_t length) {
+  put<uint8_t>(&out, type);
+  put<uint16_t>(&out, (uint16_t) length);
+  return TELEMETRY_RECORD_HEADER_SIZE;
+}
+}  // namespace
+
+size_t Telemetry::begin_packet(uint8_t * packet, uint32_t sequence, int64_t timestamp) {
+  put<uint8_t>(&packet, TELEMETRY_MAGIC);
+  put<uint8_t>(&packet, TELEMETRY_VERSION);
+  put<uint16_t>(&packet, 0);
+  put<uint32_t>(&packet, sequence);
+  put<int64_t>(&packet, timestamp);
+  return TELEMETRY_HEADER_SIZE;
+}
+
+void Telemetry::finish_packet(uint8_t * packet, size_t size) {
+  packet += 2;
+  put<uint16_t>(&packet, (uint16_t) (size - TELEMETRY_HEADER_SIZE));
+}
+
+bool Telemetry::decode_header(const uint8_t * packet, size_t size, Header * header) {
+  if (size < TELEMETRY_HEADER_SIZE || packet[0] != TELEMETRY_MAGIC) {
+    return false;
+  }
+  header->magic = take<uint8_t>(&packet);
+  header->version = take<uint8_t>(&packet);
+  header->length = take<uint16_t>(&packet);
+  header->sequence = take<uint32_t>(&packet);
+  header->timestamp = take<int64_t>(&packet);
+  return true;
+}
+
+// Encoders, one per record. Fields are cast down to their wire type
+#define ENCODE_FIELD(NAME, TYPE) put<TYPE>(&out, (TYPE) (src.NAME));
+#define ENCODE_ARRAY(NAME, TYPE, COUNT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    put<TYPE>(&out, (TYPE) (src.NAME[i])); \
+  }
+#define ENCODE_ELEMENT_FIELD(NAME, TYPE) put<TYPE>(&out, (TYPE) (element.NAME));
+#define ENCODE_STRUCTS(NAME, COUNT, ELEMENT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    const auto & element = src.NAME[i]; \
+    ELEMENT(ENCODE_ELEMENT_FIELD, ENCODE_ARRAY, ENCODE_STRUCTS) \
+  }
+#define ENCODE(ID, NAME, SOURCE, FIELDS) \
+  size_t Telemetry::encode(const SOURCE & src, uint8_t * out) { \
+    out += put_record_header(out, ID, NAME##_SIZE); \
+    FIELDS(ENCODE_FIELD, ENCODE_ARRAY, ENCODE_STRUCTS) \
+    return TELEMETRY_RECORD_HEADER_SIZE + NAME##_SIZE; \
+  }
+TELEMETRY_RECORDS(ENCODE)
+
+size_t Telemetry::encode(E_States state, uint8_t * out) {
+  StateData data = {state};
+  return encode(data, out);
+}
+
+// Decoders, the reverse. The wire value is converted to the field's own type
+#define DECODE_FIELD(NAME, TYPE) dst->NAME = (decltype(dst->NAME)) take<TYPE>(&fields);
+#define DECODE_ARRAY(NAME, TYPE, COUNT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    dst->NAME[i] = (std::remove_reference<decltype(dst->NAME[i])>::type) take<TYPE>(&fields); \
+  }
+#define DECODE_ELEMENT_FIELD(NAME, TYPE) element.NAME = (decltype(element.NAME)) take<TYPE>(&fields);
+#define DECODE_STRUCTS(NAME, COUNT, ELEMENT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    auto & element = dst->NAME[i]; \
+    ELEMENT(DECODE_ELEMENT_FIELD, DECODE_ARRAY, DECODE_STRUCTS) \
+  }
+#define DECODE(ID, NAME, SOURCE, FIELDS) \
+  bool Telemetry::decode(const uint8_t * fields, size_t size, SOURCE * dst) { \
+    if (size < NAME##_SIZE) { \
+      return false; \
+    } \
+    FIELDS(DECODE_FIELD, DECODE_ARRAY, DECODE_STRUCTS) \
+    return true; \
+  }
+TELEMETRY_RECORDS(DECODE)
+
+// Deltas. Every field is a leaf, numbered in wire order, with its bit in the mask set when it changed
+#define DELTA_LEAF(TYPE, VALUE, PREVIOUS) { \
+    TYPE value = (TYPE) (VALUE); \
+    if (value != (TYPE) (PREVIOUS)) { \
+      mask[leaf / 8] = (uint8_t) (mask[leaf / 8] | (1 << (leaf % 8))); \
+      put<TYPE>(&values, value); \
+    } \
+    leaf++; \
+  }
+#define DELTA_FIELD(NAME, TYPE) DELTA_LEAF(TYPE, src.NAME, prev.NAME)
+#define DELTA_ARRAY(NAME, TYPE, COUNT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    DELTA_LEAF(TYPE, src.NAME[i], prev.NAME[i]) \
+  }
+#define DELTA_ELEMENT_FIELD(NAME, TYPE) DELTA_LEAF(TYPE, element.NAME, previous.NAME)
+#define DELTA_STRUCTS(NAME, COUNT, ELEMENT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    const auto & element = src.NAME[i]; \
+    const auto & previous = prev.NAME[i]; \
+    ELEMENT(DELTA_ELEMENT_FIELD, DELTA_ARRAY, DELTA_STRUCTS) \
+  }
+#define ENCODE_DELTA(ID, NAME, SOURCE, FIELDS) \
+  size_t Telemetry::encode_delta(const SOURCE & src, const SOURCE & prev, uint8_t * out) { \
+    uint8_t * mask = out + TELEMETRY_RECORD_HEADER_SIZE; \
+    uint8_t * values = mask + NAME##_MASK_SIZE; \
+    memset(mask, 0, NAME##_MASK_SIZE); \
+    size_t leaf = 0; \
+    FIELDS(DELTA_FIELD, DELTA_ARRAY, DELTA_STRUCTS) \
+    if (values == mask + NAME##_MASK_SIZE) { \
+      return 0; \
+    } \
+    size_t length = (size_t) (values - mask); \
+    put_record_header(out, ID | TELEMETRY_DELTA, length); \
+    return TELEMETRY_RECORD_HEADER_SIZE + length; \
+  }
+TELEMETRY_RECORDS(ENCODE_DELTA)
+
+#define APPLY_LEAF(TYPE, TARGET) \
+  if (mask[leaf / 8] & (1 << (leaf % 8))) { \
+    if (fields + sizeof(TYPE) > end) { \
+      return false; \
+    } \
+    TARGET = (std::remove_reference<decltype(TARGET)>::type) take<TYPE>(&fields); \
+  } \
+  leaf++;
+#define APPLY_FIELD(NAME, TYPE) APPLY_LEAF(TYPE, dst->NAME)
+#define APPLY_ARRAY(NAME, TYPE, COUNT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    APPLY_LEAF(TYPE, dst->NAME[i]) \
+  }
+#define APPLY_ELEMENT_FIELD(NAME, TYPE) APPLY_LEAF(TYPE, element.NAME)
+#define APPLY_STRUCTS(NAME, COUNT, ELEMENT) \
+  for (size_t i = 0; i < (COUNT); i++) { \
+    auto & element = dst->NAME[i]; \
+    ELEMENT(APPLY_ELEMENT_FIELD, APPLY_ARRAY, APPLY_STRUCTS) \
+  }
+#define APPLY_DELTA(ID, NAME, SOURCE, FIELDS) \
+  bool Telemetry::apply_delta(const uint8_t * fields, size_t size, SOURCE * dst) { \
+    if (size < NAME##_MASK_SIZE) { \
+      return false; \
+    } \
+    const uint8_t * mask = fields; \
+    const uint8_t * end = fields + size; \
+    fields += NAME##_MASK_SIZE; \
+    size_t leaf = 0; \
+    FIELDS(APPLY_FIELD, APPLY_ARRAY, APPLY_STRUCTS) \
+    return true; \
+  }
+TELEMETRY_RECORDS(APPLY_DELTA)
+
+Telemetry::Encoder::Encoder(int64_t period) : keyframe_period(period), last_keyframe(0), keyframe_pending(false),
+                                               keyframe_started(false) {
+  request_keyframe();
+}
+
+void Telemetry::Encoder::set_keyframe_period(int64_t period) {
+  keyframe_period = period;
+}
+
+void Telemetry::Encoder::request_keyframe() {
+  keyframe_pending = true;
+#define WHOLE(ID, NAME, SOURCE, FIELDS) whole_##NAME = true;
+  TELEMETRY_RECORDS(WHOLE)
+#undef WHOLE
+}
+
+size_t Telemetry::Encoder::begin_packet(uint8_t * packet, uint32_t sequence, int64_t timestamp) {
+  if (keyframe_period > 0 && timestamp - last_keyframe >= keyframe_period) {
+    request_keyframe();
+    last_keyframe = timestamp;
+  }
+  keyframe_started = keyframe_pending;
+  keyframe_pending = false;
+  return Telemetry::begin_packet(packet, sequence, timestamp);
+}
+
+#define ENCODER_ENCODE(ID, NAME, SOURCE, FIELDS) \
+  size_t Telemetry::Encoder::encode(const SOURCE & src, uint8_t * out) { \
+    size_t size = 0; \
+    if (keyframe_period > 0 && !whole_##NAME) { \
+      size = encode_delta(src, last_##NAME, out); \
+      if (size == 0) { \
+        return 0;  /* Unchanged */ \
+      } \
+    } \
+    if (size == 0 || size >= TELEMETRY_RECORD_HEADER_SIZE + NAME##_SIZE) { \
+      size = Telemetry::encode(src, out); \
+      whole_##NAME = false; \
+    } \
+    last_##NAME = src; \
+    return size; \
+  }
+TELEMETRY_RECORDS(ENCODER_ENCODE)
+
+size_t Telemetry::Encoder::encode(E_States state, uint8_t * out) {
+  StateData data = {state};
+  return encode(data, out);
+}
@@ -0,0 +1,287 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "Defines.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+// Packed, little endian, versioned telemetry sent to the base station (see TCPManager::write_data())
+//
+// Packet: [header][record][record]...
+//   header (TELEMETRY_HEADER_SIZE bytes)
+//     uint8_t  magic      TELEMETRY_MAGIC, never a record type, so the base station can tell it from raw structs
+//     uint8_t  version    TELEMETRY_VERSION
+//     uint16_t length     bytes of records after the header
+//     uint32_t sequence   write cycle the packet was built in
+//     int64_t  timestamp  Utils::microseconds() when it was built
+//   record
+//     uint8_t  type       RecordType, same numbers as TCPManager::TCPSendIDs
+//     uint16_t length     bytes of fields after the record header
+//     fields, in the order listed below, with no padding
+//   delta record (type | TELEMETRY_DELTA), see encode_delta()
+//     uint8_t  mask[]     one bit per field (each array element is a field), lowest bit of mask[0] first
+//     the fields whose bit is set, in order
+//
+// Every number on the wire is little endian, whatever the host is, and only as wide as its wire type.
+// The schema below is the only definition: the sizes, encoders and decoders are generated from it, and the
+// base station (BaseStation/Backend/podconnect/telemetry.py) parses it out of this file.
+// Fields are only ever appended to a record (and TELEMETRY_VERSION bumped), so older decoders still read
+// the fields they know and skip the rest using the record length. Unknown record types are skipped the same way.
+#define TELEMETRY_MAGIC 0xA5
+#define TELEMETRY_VERSION 2  // 2: delta records
+#define TELEMETRY_HEADER_SIZE 16
+#define TELEMETRY_RECORD_HEADER_SIZE 3
+#define TELEMETRY_DELTA 0x80  // Set in a record's type when it only holds the fields that changed
+
+// RECORD(type id, name, source struct, field list)
+#define TELEMETRY_RECORDS(RECORD) \
+  RECORD(4, MOTION, MotionData, TELEMETRY_MOTION_FIELDS) \
+  RECORD(5, ERRORS, Errors, TELEMETRY_ERRORS_FIELDS) \
+  RECORD(6, STATE, Telemetry::StateData, TELEMETRY_STATE_FIELDS) \
+  RECORD(1, CAN, CANData, TELEMETRY_CAN_FIELDS) \
+  RECORD(3, PRU, PRUData, TELEMETRY_PRU_FIELDS) \
+  RECORD(2, I2C, I2CData, TELEMETRY_I2C_FIELDS) \
+  RECORD(7, ADC, ADCData, TELEMETRY_ADC_FIELDS) \
+  RECORD(9, BMS, BMSCells, TELEMETRY_BMS_FIELDS)
+
+// FIELD(name, wire type), ARRAY(name, wire type, count), STRUCTS(name, count, element field list)
+#define TELEMETRY_MOTION_FIELDS(FIELD, ARRAY, STRUCTS) \
+  ARRAY(x, int32_t, 3) \
+  FIELD(p_timeout, int64_t) \
+  FIELD(a_timeout, int64_t) \
+  FIELD(c_timeout, int64_t) \
+  FIELD(b_timeout, int64_t) \
+  FIELD(p_counter, int64_t) \
+  FIELD(a_counter, int64_t) \
+  FIELD(c_counter, int64_t) \
+  FIELD(b_counter, int64_t) \
+  FIELD(motor_state, uint8_t) \
+  FIELD(brake_state, uint8_t) \
+  FIELD(motor_target_torque, int32_t) \
+  ARRAY(relay_state_buf, uint8_t, 4)
+
+#define TELEMETRY_ERRORS_FIELDS(FIELD, ARRAY, STRUCTS) \
+  ARRAY(error_vector, uint32_t, 6)
+
+#define TELEMETRY_STATE_FIELDS(FIELD, ARRAY, STRUCTS) \
+  FIELD(state, uint8_t)
+
+// CANData keeps everything in uint32_t, these are the real widths (see CANManager::refresh())
+#define TELEMETRY_CAN_FIELDS(FIELD, ARRAY, STRUCTS) \
+  FIELD(status_word, uint16_t) \
+  FIELD(position_val, int32_t) \
+  FIELD(torque_val, int16_t) \
+  FIELD(controller_temp, uint8_t) \
+  FIELD(motor_temp, uint8_t) \
+  FIELD(dc_link_voltage, int32_t) \
+  FIELD(logic_power_supply_voltage, int16_t) \
+  FIELD(current_demand, int16_t) \
+  FIELD(motor_current_val, uint8_t) \
+  FIELD(electrical_angle, int16_t) \
+  FIELD(phase_a_current, int16_t) \
+  FIELD(phase_b_current, int16_t) \
+  FIELD(internal_relay_state, uint8_t) \
+  FIELD(relay_state, uint16_t) \
+  FIELD(rolling_counter, uint8_t) \
+  FIELD(fail_safe_state, uint16_t) \
+  FIELD(pack_current, int16_t) \
+  FIELD(pack_voltage_inst, uint16_t) \
+  FIELD(pack_voltage_open, uint16_t) \
+  FIELD(pack_soc, uint8_t) \
+  FIELD(pack_amphours, uint16_t) \
+  FIELD(pack_resistance, uint16_t) \
+  FIELD(pack_dod, uint8_t) \
+  FIELD(pack_soh, uint8_t) \
+  FIELD(current_limit_status, uint16_t) \
+  FIELD(max_pack_dcl, uint16_t) \
+  FIELD(avg_pack_current, int16_t) \
+  FIELD(highest_temp, uint8_t) \
+  FIELD(highest_temp_id, uint8_t) \
+  FIELD(avg_temp, uint8_t) \
+  FIELD(internal_temp, uint8_t) \
+  FIELD(low_cell_voltage, uint16_t) \
+  FIELD(low_cell_voltage_id, uint8_t) \
+  FIELD(high_cell_voltage, uint16_t) \
+  FIELD(high_cell_voltage_id, uint8_t) \
+  FIELD(low_cell_internalR, uint16_t) \
+  FIELD(low_cell_internalR_id, uint8_t) \
+  FIELD(high_cell_internalR, uint16_t) \
+  FIELD(high_cell_internalR_id, uint8_t) \
+  FIELD(power_voltage_input, uint16_t) \
+  FIELD(dtc_status_one, uint16_t) \
+  FIELD(dtc_status_two, uint16_t) \
+  FIELD(adaptive_total_cap, uint16_t) \
+  FIELD(adaptive_amphours, uint16_t) \
+  FIELD(adaptive_soc, uint8_t)
+
+#define TELEMETRY_PRU_FIELDS(FIELD, ARRAY, STRUCTS) \
+  ARRAY(orange_distance, int32_t, NUM_ORANGE_INPUTS) \
+  ARRAY(orange_velocity, int32_t, NUM_ORANGE_INPUTS) \
+  ARRAY(wheel_distance, int32_t, NUM_WHEEL_INPUTS) \
+  ARRAY(wheel_velocity, int32_t, NUM_WHEEL_INPUTS) \
+  FIELD(watchdog_hz, int32_t)
+
+#define TELEMETRY_I2C_FIELDS(FIELD, ARRAY, STRUCTS) \
+  ARRAY(temp, int16_t, NUM_TMP) \
+  FIELD(pressure_sensor, int32_t) \
+  FIELD(temp_sensor, int32_t)
+
+// 12 bit ADC levels
+#define TELEMETRY_ADC_FIELDS(FIELD, ARRAY, STRUCTS) \
+  ARRAY(data, int16_t, NUM_ADC)
+
+#define TELEMETRY_BMS_FIELDS(FIELD, ARRAY, STRUCTS) \
+  STRUCTS(cell_data, 30, TELEMETRY_BMS_CELL_FIELDS) \
+  FIELD(num_therms_enabled, uint8_t) \
+  FIELD(lowest_therm_value, uint8_t) \
+  FIELD(highest_therm_value, uint8_t) \
+  FIELD(highest_therm_id, uint8_t) \
+  FIELD(lowest_therm_id, uint8_t) \
+  ARRAY(therm_value, int8_t, 40)
+
+#define TELEMETRY_BMS_CELL_FIELDS(FIELD, ARRAY, STRUCTS) \
+  FIELD(cell_id, uint8_t) \
+  FIELD(instant_voltage, uint16_t) \
+  FIELD(internal_resistance, uint16_t) \
+  FIELD(open_voltage, uint16_t) \
+  FIELD(checksum, uint8_t)
+
+namespace Telemetry {
+
+struct StateData {
+  E_States state;
+};
+
+enum RecordType : uint8_t {
+#define TELEMETRY_TYPE(ID, NAME, SOURCE, FIELDS) NAME = ID,
+  TELEMETRY_RECORDS(TELEMETRY_TYPE)
+#undef TELEMETRY_TYPE
+};
+
+// Bytes of fields in each record, MOTION_SIZE, ERRORS_SIZE, ...
+#define TELEMETRY_SIZE_FIELD(NAME, TYPE) + sizeof(TYPE)
+#define TELEMETRY_SIZE_ARRAY(NAME, TYPE, COUNT) + sizeof(TYPE) * (COUNT)
+#define TELEMETRY_SIZE_STRUCTS(NAME, COUNT, ELEMENT) \
+  + (COUNT) * (0 ELEMENT(TELEMETRY_SIZE_FIELD, TELEMETRY_SIZE_ARRAY, TELEMETRY_SIZE_STRUCTS))
+#define TELEMETRY_SIZE(ID, NAME, SOURCE, FIELDS) \
+  const size_t NAME##_SIZE = 0 FIELDS(TELEMETRY_SIZE_FIELD, TELEMETRY_SIZE_ARRAY, TELEMETRY_SIZE_STRUCTS);
+TELEMETRY_RECORDS(TELEMETRY_SIZE)
+#undef TELEMETRY_SIZE
+
+// Fields in each record counting every array element, MOTION_LEAVES, ..., and the bytes of a delta's mask
+#define TELEMETRY_LEAVES_FIELD(NAME, TYPE) + 1
+#define TELEMETRY_LEAVES_ARRAY(NAME, TYPE, COUNT) + (COUNT)
+#define TELEMETRY_LEAVES_STRUCTS(NAME, COUNT, ELEMENT) \
+  + (COUNT) * (0 ELEMENT(TELEMETRY_LEAVES_FIELD, TELEMETRY_LEAVES_ARRAY, TELEMETRY_LEAVES_STRUCTS))
+#define TELEMETRY_LEAVES(ID, NAME, SOURCE, FIELDS) \
+  const size_t NAME##_LEAVES = 0 FIELDS(TELEMETRY_LEAVES_FIELD, TELEMETRY_LEAVES_ARRAY, TELEMETRY_LEAVES_STRUCTS); \
+  const size_t NAME##_MASK_SIZE = (NAME##_LEAVES + 7) / 8;
+TELEMETRY_RECORDS(TELEMETRY_LEAVES)
+#undef TELEMETRY_LEAVES
+
+// Largest possible packet, every record in it once (with room for a delta's mask)
+#define TELEMETRY_PACKET_SIZE(ID, NAME, SOURCE, FIELDS) + TELEMETRY_RECORD_HEADER_SIZE + NAME##_MASK_SIZE + NAME##_SIZE
+const size_t MAX_PACKET_SIZE = TELEMETRY_HEADER_SIZE TELEMETRY_RECORDS(TELEMETRY_PACKET_SIZE);
+#undef TELEMETRY_PACKET_SIZE
+
+struct Header {
+  uint8_t magic;
+  uint8_t version;
+  uint16_t length;
+  uint32_t sequence;
+  int64_t timestamp;
+};
+
+/*
+ * Writes a header with no records yet. Append records after it, then call finish_packet()
+ * @return TELEMETRY_HEADER_SIZE
+ */
+size_t begin_packet(uint8_t * packet, uint32_t sequence, int64_t timestamp);
+
+/*
+ * Fills in the header's length
+ * @param size bytes in the whole packet, header included
+ */
+void finish_packet(uint8_t * packet, size_t size);
+
+/*
+ * @return false if there is not a whole header, or it is not a telemetry header
+ */
+bool decode_header(const uint8_t * packet, size_t size, Header * header);
+
+/*
+ * Writes one record (record header and fields) for the source struct
+ * @return bytes written, TELEMETRY_RECORD_HEADER_SIZE + <NAME>_SIZE
+ */
+#define TELEMETRY_ENCODE(ID, NAME, SOURCE, FIELDS) size_t encode(const SOURCE & src, uint8_t * out);
+TELEMETRY_RECORDS(TELEMETRY_ENCODE)
+#undef TELEMETRY_ENCODE
+size_t encode(E_States state, uint8_t * out);
+
+/*
+ * Reads the fields of a record (without its record header) back into the struct.
+ * Narrow signed wire types are sign extended into the struct's wider fields
+ * @return false if the record is too short
+ */
+#define TELEMETRY_DECODE(ID, NAME, SOURCE, FIELDS) bool decode(const uint8_t * fields, size_t size, SOURCE * dst);
+TELEMETRY_RECORDS(TELEMETRY_DECODE)
+#undef TELEMETRY_DECODE
+
+/*
+ * Writes a delta record: the fields of src that differ from prev (compared as wire types)
+ * @return bytes written, 0 if nothing changed (and nothing needs sending)
+ */
+#define TELEMETRY_ENCODE_DELTA(ID, NAME, SOURCE, FIELDS) \
+  size_t encode_delta(const SOURCE & src, const SOURCE & prev, uint8_t * out);
+TELEMETRY_RECORDS(TELEMETRY_ENCODE_DELTA)
+#undef TELEMETRY_ENCODE_DELTA
+
+/*
+ * Applies the fields of a delta record (without its record header) on top of the last values in dst
+ * @return false if the record is too short
+ */
+#define TELEMETRY_APPLY_DELTA(ID, NAME, SOURCE, FIELDS) \
+  bool apply_delta(const uint8_t * fields, size_t size, SOURCE * dst);
+TELEMETRY_RECORDS(TELEMETRY_APPLY_DELTA)
+#undef TELEMETRY_APPLY_DELTA
+
+// Picks between whole records and deltas for one receiver, remembering what it was last sent.
+// Every record goes out whole the first time, after request_keyframe(), and once every keyframe_period, so a
+// receiver that joins late or loses track is never more than a period away from the full picture.
+// After that only records with changed fields are sent, as deltas (or whole, when that is smaller)
+class Encoder {
+ public:
+  // keyframe_period in microseconds, 0 sends every record whole
+  explicit Encoder(int64_t keyframe_period = 0);
+
+  void set_keyframe_period(int64_t period);
+  void request_keyframe();  // Sends every record whole the next time it is encoded
+
+  // Like Telemetry::begin_packet(), and starts a keyframe when one is due
+  size_t begin_packet(uint8_t * packet, uint32_t sequence, int64_t timestamp);
+
+  // True if the packet begun last starts a keyframe: a receiver that missed packets is back in sync from it on,
+  // as every record's next appearance is whole
+  bool starts_keyframe() const { return keyframe_started; }
+
+  // @return bytes written, 0 if the record has not changed since it was last sent
+#define TELEMETRY_ENCODER_ENCODE(ID, NAME, SOURCE, FIELDS) size_t encode(const SOURCE & src, uint8_t * out);
+  TELEMETRY_RECORDS(TELEMETRY_ENCODER_ENCODE)
+#undef TELEMETRY_ENCODER_ENCODE
+  size_t encode(E_States state, uint8_t * out);
+
+ private:
+  int64_t keyframe_period;
+  int64_t last_keyframe;
+  bool keyframe_pending;  // request_keyframe() since the last begin_packet()
+  bool keyframe_started;
+#define TELEMETRY_ENCODER_LAST(ID, NAME, SOURCE, FIELDS) \
+  SOURCE last_##NAME;  /* What the receiver has */ \
+  bool whole_##NAME;   /* Send it whole next time */
+  TELEMETRY_RECORDS(TELEMETRY_ENCODER_LAST)
+#undef TELEMETRY_ENCODER_LAST
+};
+
+}  // namespace Telemetry
+
+#endif  // TELEMETRY_H_
@@ -0,0 +1,163 @@
+#include "TelemetryFanout.h"
+#include "Utils.h"
+#include <sys/socket.h>
+#include <errno.h>
+#include <unistd.h>
+
+using Utils::print;
+using Utils::LogLevel;
+
+TelemetryFanout::TelemetryFanout(size_t client_limit, size_t queue_capacity) :
+  frames_dropped(0), syscalls(0), bytes_sent(0), max_clients(client_limit), capacity(queue_capacity) {
+}
+
+TelemetryFanout::~TelemetryFanout() {
+  clear();
+}
+
+bool TelemetryFanout::add(int fd) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (client_list.size() >= max_clients) {
+    return false;
+  }
+  Client client;
+  client.fd = fd;
+  client.sent = 0;
+  client.resync = true;  // Nothing to apply deltas to yet
+  client.failed = false;
+  client.last_progress = Utils::microseconds();
+  client.dropped = 0;
+  client.bytes = 0;
+  client.high_water = 0;
+  client_list.push_back(client);
+  return true;
+}
+
+void TelemetryFanout::remove(int fd) {
+  std::lock_guard<std::mutex> guard(mutex);
+  for (auto it = client_list.begin(); it != client_list.end(); ++it) {
+    if (it->fd == fd) {
+      print(LogLevel::LOG_INFO, "TCP client %d removed: %lu bytes sent, %lu packets dropped, queue high water %lu\n",
+            fd, (unsigned long) it->bytes, (unsigned long) it->dropped, (unsigned long) it->high_water);  // NOLINT
+      close(fd);
+      client_list.erase(it);
+      return;
+    }
+  }
+}
+
+void TelemetryFanout::clear() {
+  std::lock_guard<std::mutex> guard(mutex);
+  for (Client & client : client_list) {
+    close(client.fd);
+  }
+  client_list.clear();
+}
+
+bool TelemetryFanout::publish(const uint8_t * data, size_t size, bool resync_point) {
+  Frame frame = std::make_shared<const std::vector<uint8_t>>(data, data + size);  // The only copy
+  bool overflowed = false;
+  std::lock_guard<std::mutex> guard(mutex);
+  for (Client & client : client_list) {
+    if (client.failed) {
+      continue;
+    }
+    if (client.queue.size() >= capacity) {
+      // Keep the packet that is part way out, the stream would be corrupt without the rest of it
+      size_t keep = client.sent > 0 ? 1 : 0;
+      client.dropped += client.queue.size() - keep;
+      frames_dropped.fetch_add(client.queue.size() - keep);
+      client.queue.resize(keep);
+      client.resync = true;
+      overflowed = true;
+    }
+    if (client.resync && !resync_point) {
+      client.dropped++;
+      frames_dropped++;
+      continue;
+    }
+    client.resync = false;
+    client.queue.push_back(frame);
+    if (client.queue.size() > client.high_water) {
+      client.high_water = client.queue.size();
+    }
+  }
+  return overflowed;
+}
+
+ssize_t TelemetryFanout::send_queue(Client * client) {
+  ssize_t total = 0;
+  while (!client->queue.empty()) {
+    const std::vector<uint8_t> & frame = *client->queue.front();
+    ssize_t sent = send(client->fd, frame.data() + client->sent, frame.size() - client->sent,
+                        MSG_DONTWAIT | MSG_NOSIGNAL);
+    syscalls++;
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN ? total : -1;  // EWOULDBLOCK is the same value on Linux
+    }
+    total += sent;
+    client->sent += (size_t) sent;
+    client->last_progress = Utils::microseconds();
+    if (client->sent == frame.size()) {
+      client->queue.pop_front();
+      client->sent = 0;
+    }
+  }
+  client->last_progress = Utils::microseconds();  // Nothing waiting isn't a stall
+  return total;
+}
+
+size_t TelemetryFanout::flush(int64_t stall_timeout) {
+  size_t total = 0;
+  std::lock_guard<std::mutex> guard(mutex);
+  for (Client & client : client_list) {
+    if (client.failed) {
+      continue;
+    }
+    ssize_t sent = send_queue(&client);
+    if (sent > 0) {
+      total += (size_t) sent;
+      client.bytes += (uint64_t) sent;
+    }
+    bool stalled = Utils::microseconds() - client.last_progress > stall_timeout;
+    if (sent < 0 || stalled) {
+      print(LogLevel::LOG_ERROR, "TCP client %d %s, dropping it\n", client.fd, stalled ? "stalled" : "failed");
+      client.failed = true;
+      client.queue.clear();
+      shutdown(client.fd, SHUT_RDWR);  // Its reader sees the end and remove()s it
+    }
+  }
+  bytes_sent.fetch_add(total);
+  return total;
+}
+
+std::vector<int> TelemetryFanout::pending() {
+  std::vector<int> fds;
+  std::lock_guard<std::mutex> guard(mutex);
+  for (Client & client : client_list) {
+    if (!client.failed && !client.queue.empty()) {
+      fds.push_back(client.fd);
+    }
+  }
+  return fds;
+}
+
+size_t TelemetryFanout::clients() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return client_list.size();
+}
+
+void TelemetryFanout::print_stats() {
+  std::lock_guard<std::mutex> guard(mutex);
+  print(LogLevel::LOG_INFO, "tcp_fanout: %lu clients, %lu bytes sent, %lu syscalls, %lu packets dropped\n",
+        (unsigned long) client_list.size(), (unsigned long) bytes_sent.load(),  // NOLINT
+        (unsigned long) syscalls.load(), (unsigned long) frames_dropped.load());  // NOLINT
+  for (Client & client : client_list) {
+    print(LogLevel::LOG_INFO, "  client %d: %lu bytes, %lu dropped, queue %lu (high water %lu)%s\n", client.fd,
+          (unsigned long) client.bytes, (unsigned long) client.dropped, (unsigned long) client.queue.size(),  // NOLINT
+          (unsigned long) client.high_water, client.resync ? ", resyncing" : "");  // NOLINT
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef TELEMETRYFANOUT_H_
+#define TELEMETRYFANOUT_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex> // NOLINT
+#include <vector>
+
+// Sends the same telemetry to several subscribers (base station, logger, laptop...), see TCPManager's server mode
+//
+// Each packet is encoded once and shared by every client's queue, which is sent with non blocking writes so a
+// slow client only ever holds up itself. A client whose queue fills up loses the packets that hadn't started
+// going out and skips ahead to the next resync point: a packet a receiver can pick the stream back up from
+// (the start of a keyframe, or any packet of a format without deltas). publish() reports the overflow so the
+// caller can make the next packet one.
+//
+// Thread safe. Typically one thread accepts clients and reads from them, another publishes and flushes.
+// Only remove() closes a client's fd, a failed client is just shut down so its reader sees it end
+class TelemetryFanout {
+ public:
+  TelemetryFanout(size_t max_clients, size_t queue_capacity);
+  ~TelemetryFanout();
+
+  /*
+   * Starts sending to fd from the next resync point
+   * @return false if there are already max_clients (fd is left open)
+   */
+  bool add(int fd);
+
+  /*
+   * Stops sending to fd and closes it
+   */
+  void remove(int fd);
+
+  /*
+   * Queues a packet for every client
+   * @param resync_point a client that lost packets can start receiving again here
+   * @return true if a client's queue overflowed, so a resync point is needed soon
+   */
+  bool publish(const uint8_t * data, size_t size, bool resync_point);
+
+  /*
+   * Sends what each client's socket takes without blocking.
+   * A client whose socket failed, or took nothing for stall_timeout microseconds, is shut down
+   * @return bytes sent to all clients
+   */
+  size_t flush(int64_t stall_timeout);
+
+  /*
+   * Clients with something waiting on a full socket
+   */
+  std::vector<int> pending();
+
+  size_t clients();
+
+  /*
+   * Closes every client
+   */
+  void clear();
+
+  // Summed over every client since it was added
+  std::atomic<uint64_t> frames_dropped;  // Packets a client's queue had no room for, or skipped to resync
+  std::atomic<uint64_t> syscalls;        // send() calls
+  std::atomic<uint64_t> bytes_sent;
+
+  void print_stats();
+
+ private:
+  typedef std::shared_ptr<const std::vector<uint8_t>> Frame;
+
+  struct Client {
+    int fd;
+    std::deque<Frame> queue;
+    size_t sent;      // Bytes of queue.front() already sent
+    bool resync;      // Skipping packets until the next resync point
+    bool failed;
+    int64_t last_progress;
+    uint64_t dropped;
+    uint64_t bytes;
+    size_t high_water;
+  };
+
+  // Sends the client's queue until it is empty or its socket is full. @return bytes sent, -1 on failure
+  ssize_t send_queue(Client * client);
+
+  std::mutex mutex;
+  std::vector<Client> client_list;
+  size_t max_clients;
+  size_t capacity;
+};
+
+#endif  // TELEMETRYFANOUT_H_
@@ -0,0 +1,212 @@
+#include "ThreadConfig.h"
+#include "Utils.h"
+#include "Configurator.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <cstring>
+#include <fstream>
+#include <mutex> // NOLINT
+
+using Utils::print;
+using Utils::LogLevel;
+
+namespace {
+struct Record {
+  char name[32];
+  ThreadConfig::Settings requested;
+  ThreadConfig::Settings actual;
+};
+
+const int MAX_RECORDS = 16;
+Record records[MAX_RECORDS];
+int num_records = 0;
+std::mutex records_mutex;
+
+const char * policy_name(int32_t policy) {
+  switch (policy) {
+    case SCHED_FIFO: return "FIFO";
+    case SCHED_RR:   return "RR";
+    default:         return "OTHER";
+  }
+}
+
+// Threads restart along with the Pod (ex: every test), so a name keeps its record
+void save(const std::string & name, const ThreadConfig::Settings & requested, const ThreadConfig::Settings & actual) {
+  std::lock_guard<std::mutex> guard(records_mutex);
+  int i = 0;
+  while (i < num_records && name != records[i].name) {
+    i++;
+  }
+  if (i == MAX_RECORDS) {
+    return;
+  }
+  if (i == num_records) {
+    num_records++;
+    snprintf(records[i].name, sizeof(records[i].name), "%s", name.c_str());
+  }
+  records[i].requested = requested;
+  records[i].actual = actual;
+}
+
+// Touch the pages now, so the first deep call stack in flight doesn't page fault
+void prefault_stack(size_t bytes) {
+  volatile char * stack = static_cast<volatile char *>(alloca(bytes));
+  for (size_t i = 0; i < bytes; i += 4096) {
+    stack[i] = 0;
+  }
+}
+}  // namespace
+
+bool ThreadConfig::apply(const std::string & name) {
+  Settings requested;
+  requested.priority = 0;
+  requested.cpu = -1;
+  std::string policy = "fifo";
+  ConfiguratorManager::config.getValue(name + "_priority", requested.priority);
+  ConfiguratorManager::config.getValue(name + "_policy", policy);
+  ConfiguratorManager::config.getValue(name + "_cpu", requested.cpu);
+  if (requested.priority <= 0) {
+    requested.policy = SCHED_OTHER;
+    requested.priority = 0;
+  } else {
+    requested.policy = (policy == "rr") ? SCHED_RR : SCHED_FIFO;
+  }
+  return apply(name, requested);
+}
+
+bool ThreadConfig::apply(const std::string & name, const Settings & requested) {
+  bool ok = true;
+  pthread_t self = pthread_self();
+
+  // Thread names are limited to 16 bytes including the terminator
+  std::string short_name = name.substr(0, 15);
+  pthread_setname_np(self, short_name.c_str());
+
+  // Threads inherit their creator's policy, so a time shared thread started from a real time one has to be set back
+  if (requested.policy != SCHED_OTHER || current().policy != SCHED_OTHER) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = requested.priority;
+    int rc = pthread_setschedparam(self, requested.policy, &param);
+    if (rc != 0) {
+      print(LogLevel::LOG_ERROR, "Thread %s: SCHED_%s %d not applied: %s\n",
+                                  name.c_str(), policy_name(requested.policy), requested.priority, strerror(rc));
+      ok = false;
+    }
+  }
+
+  if (requested.cpu >= CPU_SETSIZE) {
+    print(LogLevel::LOG_ERROR, "Thread %s: CPU %d affinity not applied: past CPU_SETSIZE\n", name.c_str(), requested.cpu);
+    ok = false;
+  } else if (requested.cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((size_t) requested.cpu, &set);
+    int rc = pthread_setaffinity_np(self, sizeof(set), &set);
+    if (rc != 0) {
+      print(LogLevel::LOG_ERROR, "Thread %s: CPU %d affinity not applied: %s\n", name.c_str(), requested.cpu, strerror(rc));
+      ok = false;
+    }
+  }
+
+  Settings actual = current();
+  save(name, requested, actual);
+  if (requested.policy != SCHED_OTHER || requested.cpu >= 0) {
+    print(LogLevel::LOG_INFO, "Thread %s: SCHED_%s %d, cpu %d\n",
+                               name.c_str(), policy_name(actual.policy), actual.priority, actual.cpu);
+  }
+  return ok;
+}
+
+ThreadConfig::Settings ThreadConfig::current() {
+  Settings settings;
+  struct sched_param param;
+  int policy = SCHED_OTHER;
+  memset(&param, 0, sizeof(param));
+  pthread_getschedparam(pthread_self(), &policy, &param);
+  settings.policy = policy;
+  settings.priority = param.sched_priority;
+
+  // Only report a CPU if the thread is pinned to exactly one
+  settings.cpu = -1;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0 && CPU_COUNT(&set) == 1) {
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        settings.cpu = (int) cpu;
+        break;
+      }
+    }
+  }
+  return settings;
+}
+
+bool ThreadConfig::lock_memory() {
+  int32_t lock = 0;
+  int32_t prefault = 0;
+  ConfiguratorManager::config.getValue("lock_memory", lock);
+  ConfiguratorManager::config.getValue("stack_prefault", prefault);
+  if (!lock) {
+    return false;
+  }
+
+  if (prefault > 0) {
+    prefault_stack((size_t) prefault);  // Grows the main thread's stack mapping first, so it is locked as well
+  }
+
+  // MCL_CURRENT locks every page mapped right now: each thread's whole stack and the flight recorder's file,
+  // not just what has been touched. Without CAP_IPC_LOCK that has to fit under RLIMIT_MEMLOCK
+  int64_t mapped = -1;
+  std::ifstream statm("/proc/self/statm");
+  if (statm >> mapped) {
+    mapped *= sysconf(_SC_PAGESIZE);
+  }
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && geteuid() != 0 &&
+      mapped > (int64_t) limit.rlim_cur) {
+    print(LogLevel::LOG_ERROR, "Memory is not locked: %ld kB mapped, RLIMIT_MEMLOCK is %ld kB\n",
+          (long) (mapped / 1024), (long) (limit.rlim_cur / 1024));  // NOLINT
+    return false;
+  }
+
+  // Not MCL_FUTURE: it would lock every later thread stack and mmap() as it is made, and once past the limit
+  // those fail instead (std::thread throws, the flight recorder doesn't open)
+  if (mlockall(MCL_CURRENT) != 0) {
+    PRINT_ERRNO("mlockall failed, memory is not locked");
+    print(LogLevel::LOG_ERROR, "%ld kB were mapped\n", (long) (mapped / 1024));  // NOLINT
+    return false;
+  }
+  print(LogLevel::LOG_INFO, "Memory locked: %ld kB, %d bytes of stack prefaulted\n",
+        (long) (mapped / 1024), prefault > 0 ? prefault : 0);  // NOLINT
+  return true;
+}
+
+bool ThreadConfig::applied(const std::string & name, Settings * requested, Settings * actual) {
+  std::lock_guard<std::mutex> guard(records_mutex);
+  for (int i = 0; i < num_records; i++) {
+    if (name == records[i].name) {
+      *requested = records[i].requested;
+      *actual = records[i].actual;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadConfig::print_report() {
+  std::lock_guard<std::mutex> guard(records_mutex);
+  print(LogLevel::LOG_INFO, "Thread scheduling (requested -> applied):\n");
+  for (int i = 0; i < num_records; i++) {
+    const Record & r = records[i];
+    print(LogLevel::LOG_INFO, "  %-16s SCHED_%s %2d cpu %2d -> SCHED_%s %2d cpu %2d%s\n", r.name,
+          policy_name(r.requested.policy), r.requested.priority, r.requested.cpu,
+          policy_name(r.actual.policy), r.actual.priority, r.actual.cpu,
+          (r.requested.policy != r.actual.policy || r.requested.priority != r.actual.priority ||
+           (r.requested.cpu >= 0 && r.requested.cpu != r.actual.cpu)) ? "  (NOT APPLIED)" : "");
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef THREADCONFIG_H_
+#define THREADCONFIG_H_
+
+#include <stdint.h>
+#include <string>
+
+// Scheduling setup for the pod's threads
+//
+// Every long running thread calls apply() with its name when it starts. The name picks the config keys:
+//   <name>_priority  1-99 runs the thread SCHED_FIFO (or SCHED_RR) at that priority. 0/missing runs it time shared (SCHED_OTHER)
+//   <name>_policy    fifo (default) or rr
+//   <name>_cpu       pins the thread to that CPU. -1/missing leaves the affinity as it is
+// and the thread is named (truncated to 15 characters) so it shows up in top -H / ps -L.
+// Names: logic_loop, adc_manager, can_manager, i2c_manager, pru_manager, reactor,
+//        tcp_loop, tcp_read_loop, tcp_write_loop, udp_manager
+//
+// Settings that can't be applied (ex: no CAP_SYS_NICE for real time priorities) are logged and skipped,
+// the thread keeps running with whatever it had. What each thread actually ended up with is kept for print_report().
+namespace ThreadConfig {
+
+struct Settings {
+  int32_t policy;    // SCHED_OTHER, SCHED_FIFO or SCHED_RR
+  int32_t priority;  // 0 for SCHED_OTHER, 1-99 otherwise
+  int32_t cpu;       // -1 for no pinning
+};
+
+/*
+ * Names the calling thread and applies <name>_priority/_policy/_cpu from the config
+ * @return false if any of the requested settings couldn't be applied
+ */
+bool apply(const std::string & name);
+
+/*
+ * Same as above, with explicit settings instead of the config
+ */
+bool apply(const std::string & name, const Settings & requested);
+
+/*
+ * What the kernel reports for the calling thread right now
+ */
+Settings current();
+
+/*
+ * If lock_memory is set in the config: touch stack_prefault bytes of stack, then mlockall() the pages
+ * mapped right now. Call it once the long lived threads and the flight recorder are up.
+ * Threads created afterwards (ex: the TCP threads on each reconnect) are not locked.
+ * Reports and locks nothing if the mapped memory is over RLIMIT_MEMLOCK
+ * @return true if memory is locked
+ */
+bool lock_memory();
+
+/*
+ * What was applied to each named thread since startup
+ * @param requested/applied filled in if the thread is known
+ * @return false if no thread called apply() with name
+ */
+bool applied(const std::string & name, Settings * requested, Settings * actual);
+
+/*
+ * Prints requested vs applied settings for every thread that called apply()
+ */
+void print_report();
+
+}  // namespace ThreadConfig
+
+#endif  // THREADCONFIG_H_
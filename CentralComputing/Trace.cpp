@@ -0,0 +1,159 @@
+#include "Trace.h"
+#include "Command.h"
+#include "LatencyHistogram.h"
+#include "Utils.h"
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+using Utils::print;
+using Utils::LogLevel;
+
+HistoryRing<CommandTrace, Trace::RING_LENGTH> Trace::ring;
+
+namespace {
+thread_local CommandTrace current;
+thread_local bool following = false;
+std::atomic<int64_t> run_start(0);
+uint32_t sequence = 0;  // Logic loop only
+
+// Finished traces since reset(), oldest first
+std::vector<Sample<CommandTrace>> collect() {
+  std::vector<Sample<CommandTrace>> traces(Trace::RING_LENGTH);
+  traces.resize(Trace::ring.since(run_start.load(), traces.data(), Trace::RING_LENGTH));
+  return traces;
+}
+
+Trace::Percentiles percentiles(std::vector<int64_t> * values) {
+  Trace::Percentiles ret = {0, 0, 0, 0};
+  if (values->empty()) {
+    return ret;
+  }
+  std::sort(values->begin(), values->end());
+  size_t n = values->size();
+  ret.count = static_cast<uint32_t>(n);
+  ret.p50 = (*values)[(n - 1) / 2];
+  ret.p99 = (*values)[(n - 1) * 99 / 100];
+  ret.max = (*values)[n - 1];
+  return ret;
+}
+
+void print_percentiles(const char * name, const char * stage, const Trace::Percentiles & p) {
+  if (p.count > 0) {
+    print(LogLevel::LOG_INFO, "  %-30s %-12s n=%-6u p50 %9.1f  p99 %9.1f  max %9.1f us\n", name, stage, p.count,
+          p.p50 / 1000.0, p.p99 / 1000.0, p.max / 1000.0);
+  }
+}
+
+// Async events may overlap on one track, which queued commands do
+void write_span(FILE * file, bool * first, const char * name, uint32_t id, int64_t begin, int64_t end, uint32_t value) {
+  fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"command\",\"ph\":\"b\",\"id\":%u,\"pid\":1,\"tid\":1,\"ts\":%.3f,"
+                "\"args\":{\"value\":%u}},\n"
+                "{\"name\":\"%s\",\"cat\":\"command\",\"ph\":\"e\",\"id\":%u,\"pid\":1,\"tid\":1,\"ts\":%.3f}",
+          *first ? "" : ",\n", name, id, begin / 1000.0, value, name, id, end / 1000.0);
+  *first = false;
+}
+}  // namespace
+
+void Trace::begin(const CommandTrace & trace) {
+  current = trace;
+  current.transitioned = 0;
+  current.actuated = 0;
+  following = true;
+}
+
+void Trace::transitioned() {
+  current.transitioned = LatencyHistogram::now();
+}
+
+void Trace::actuated() {
+  if (following) {
+    current.actuated = LatencyHistogram::now();
+  }
+}
+
+void Trace::end() {
+  if (!following) {
+    return;
+  }
+  following = false;
+  Sample<CommandTrace> sample;
+  sample.header.timestamp = current.created;
+  sample.header.sequence = sequence++;
+  sample.header.PADDING = 0;
+  sample.data = current;
+  ring.push(sample);
+}
+
+void Trace::reset() {
+  run_start.store(LatencyHistogram::now());
+}
+
+bool Trace::summarize(uint32_t id, Summary * out) {
+  std::vector<int64_t> dequeued;
+  std::vector<int64_t> transitioned;
+  std::vector<int64_t> actuated;
+  for (const Sample<CommandTrace> & sample : collect()) {
+    const CommandTrace & t = sample.data;
+    if (t.id != id) {
+      continue;
+    }
+    dequeued.push_back(t.dequeued - t.created);
+    if (t.transitioned != 0) {
+      transitioned.push_back(t.transitioned - t.created);
+    }
+    if (t.actuated != 0) {
+      actuated.push_back(t.actuated - t.created);
+    }
+  }
+  out->dequeued = percentiles(&dequeued);
+  out->transitioned = percentiles(&transitioned);
+  out->actuated = percentiles(&actuated);
+  return out->dequeued.count > 0;
+}
+
+void Trace::print_summary() {
+  print(LogLevel::LOG_INFO, "Command latency from creation (last %lu commands):\n", (unsigned long) RING_LENGTH);
+  for (uint32_t id = 0; id < Command::SENTINEL; id++) {
+    Summary summary;
+    if (summarize(id, &summary)) {
+      std::string name = Command::get_network_command_ID_string(id);
+      print_percentiles(name.c_str(), "dequeued", summary.dequeued);
+      print_percentiles(name.c_str(), "transitioned", summary.transitioned);
+      print_percentiles(name.c_str(), "actuated", summary.actuated);
+    }
+  }
+}
+
+bool Trace::export_chrome(const std::string & path) {
+  FILE * file = fopen(path.c_str(), "w");
+  if (file == NULL) {
+    PRINT_ERRNO("Couldn't open command trace file");
+    return false;
+  }
+
+  // One async span per command, with child spans for its time in the queue, in its transition and until its action
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (const Sample<CommandTrace> & sample : collect()) {
+    const CommandTrace & t = sample.data;
+    std::string name = Command::get_network_command_ID_string(t.id);
+    int64_t done = std::max(std::max(t.dequeued, t.transitioned), t.actuated);
+    write_span(file, &first, name.c_str(), sample.header.sequence, t.created, done, t.value);
+    write_span(file, &first, "queued", sample.header.sequence, t.created, t.dequeued, t.value);
+    if (t.transitioned != 0) {
+      write_span(file, &first, "transition", sample.header.sequence, t.dequeued, t.transitioned, t.value);
+    }
+    if (t.actuated != 0) {
+      // From dequeue: a transition's entry actions (ex: ST_Flight_Abort) run before it returns
+      write_span(file, &first, "actuation", sample.header.sequence, t.dequeued, t.actuated, t.value);
+    }
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  bool ok = fclose(file) == 0;
+  if (ok) {
+    print(LogLevel::LOG_INFO, "Command trace written to %s\n", path.c_str());
+  }
+  return ok;
+}
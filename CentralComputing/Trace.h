@@ -0,0 +1,72 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "HistoryRing.hpp"
+#include <stdint.h>
+#include <string>
+
+// One command's trip through the pod. CLOCK_MONOTONIC nanoseconds (see LatencyHistogram::now()), 0 if it didn't happen
+struct CommandTrace {
+  uint32_t id;
+  uint32_t value;
+  int64_t created;       // Command::put() (set_error_flag() and the network managers all go through it)
+  int64_t dequeued;      // Command::get() in the logic loop
+  int64_t transitioned;  // Its transition function returned
+  int64_t actuated;      // The last Brakes/ Motor action it caused finished
+};
+
+// End to end command latency tracing
+//
+// Command::put() stamps each command as it is queued and Command::get() as the logic loop takes it. The logic loop
+// follows it through its transition and action function with begin()/ transitioned()/ end(), and Brakes/ Motor
+// call actuated() whenever they act. Finished traces go in a lock free ring (written by the logic loop only),
+// which can be summarized per command ID or exported as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+namespace Trace {
+  static const size_t RING_LENGTH = 2048;
+  extern HistoryRing<CommandTrace, RING_LENGTH> ring;
+
+  // Logic loop only
+  void begin(const CommandTrace & trace);
+  void transitioned();
+  void end();
+
+  /*
+   * Stamps the command the calling thread is following, if any. Cheap enough to call on every actuator action
+   */
+  void actuated();
+
+  /*
+   * Only traces finished after this are summarized/ exported. Called when the Pod starts running
+   */
+  void reset();
+
+  struct Percentiles {
+    uint32_t count;
+    int64_t p50;  // nanoseconds
+    int64_t p99;
+    int64_t max;
+  };
+
+  // Time from creation to each stage
+  struct Summary {
+    Percentiles dequeued;
+    Percentiles transitioned;
+    Percentiles actuated;  // Only commands that caused an action
+  };
+
+  /*
+   * Summary of the traces for one command ID still in the ring
+   * @return false if there are none
+   */
+  bool summarize(uint32_t id, Summary * out);
+
+  void print_summary();
+
+  /*
+   * Writes the traces still in the ring as Chrome trace event JSON
+   * @return false if the file couldn't be written
+   */
+  bool export_chrome(const std::string & path);
+}  // namespace Trace
+
+#endif  // TRACE_H_
@@ -1,4 +1,5 @@
 #include "UDPManager.h"
+#include "ThreadConfig.h"
 
 using Utils::print;
 using Utils::LogLevel;
@@ -11,6 +12,7 @@ struct addrinfo UDPManager::hints;
 struct addrinfo * UDPManager::sendinfo = NULL;
 struct addrinfo * UDPManager::recvinfo = NULL;
 Event UDPManager::setup;
+Event UDPManager::closing;
 std::mutex UDPManager::mutex;
 
 bool UDPManager::start_udp(const char * hostname, const char * send_port, const char * recv_port) {
@@ -136,25 +138,47 @@ int UDPManager::udp_send(uint8_t* buf, uint8_t len) {
   return byte_count;
 }
 
-void UDPManager::connection_monitor(const char * hostname, const char * send_port, const char * recv_port) {
+namespace {
+// Connection state, shared by connection_monitor() and the reactor handler
+bool is_connected = false;
+int connected_timeout = 0;  // milliseconds
+uint8_t send_buffer[] = {'A', 'C', 'K'};
+
+// Runs the ping/ack exchange from a Reactor instead of connection_monitor()'s thread
+class UDPHandler : public ReactorHandler {
+ public:
+  std::string handler_name() {
+    return "udp";
+  }
+
+  int handler_fd() {
+    return UDPManager::recv_socketfd;
+  }
+
+  void on_readable() {
+    // Like connection_monitor(), no timeout until the first message, then connected_timeout after every message
+    deadline = LatencyHistogram::now() + (int64_t) connected_timeout * 1000000;
+    UDPManager::handle_message();
+  }
+
+  void on_deadline() {
+    UDPManager::handle_timeout();
+    deadline += (int64_t) connected_timeout * 1000000;
+  }
+};
+
+UDPHandler handler;
+}  // namespace
+
+bool UDPManager::open_connection(const char * hostname, const char * send_port, const char * recv_port) {
   setup.reset();
 
   // Create UDP socket
   if (!start_udp(hostname, send_port, recv_port)) {
     print(LogLevel::LOG_ERROR, "Error setting up UDP\n");
-    return; 
+    return false;
   }
 
-  // Setup variables for UDP loop
-  bool is_connected = false;
-  int rv;
-  int byte_count;
-  struct pollfd fds[1];
-  fds[0].fd = recv_socketfd;
-  fds[0].events = POLLIN;
-  uint8_t send_buffer[] = {'A', 'C', 'K'};
-  uint8_t read_buffer[8];
-
   /*
    * Timeout = -min(p) - min(D1) + heartbeat_period + max(D1) + max(p) 
    * p is processing time
@@ -175,9 +199,10 @@ void UDPManager::connection_monitor(const char * hostname, const char * send_por
     print(LogLevel::LOG_ERROR, "CONFIG FILE ERROR -UDP- Missing necessary configuration\n");
     exit(1);  // Crash hard on this error
   }
-  int connected_timeout = heartbeat_period + max_delta + max_p - min_p - min_delta;
-  int timeout = -1; 
+  connected_timeout = heartbeat_period + max_delta + max_p - min_p - min_delta;
+  is_connected = false;
   
+  closing.reset();
   running.store(true);
   print(LogLevel::LOG_INFO, "UDP Setup complete\n");
   setup.invoke();
@@ -185,31 +210,67 @@ void UDPManager::connection_monitor(const char * hostname, const char * send_por
   // TODO: @Evan Remove this
   // Send ack just to test
   udp_send(send_buffer, sizeof(send_buffer));  
+  return true;
+}
+
+void UDPManager::handle_message() {
+  uint8_t read_buffer[8];
+  int byte_count = udp_recv(read_buffer, sizeof(read_buffer));  // Read message
+  if (byte_count > 0 && udp_parse(read_buffer, byte_count)) {  // Check if PING. Returns true if message was PING
+    byte_count = udp_send(send_buffer, sizeof(send_buffer));  // Respond with ACK
+    // print(LogLevel::LOG_DEBUG, "sent %d bytes, \n", byte_count); 
+    if (!is_connected) {
+      print(LogLevel::LOG_INFO, "UDP Connected! \n");
+      Command::put(Command::CLR_NETWORK_ERROR, NETWORKErrors::UDP_DISCONNECT_ERROR);
+      is_connected = true;
+    }
+  }
+}
+
+void UDPManager::handle_timeout() {
+  print(LogLevel::LOG_ERROR, "UDP timeout\n");
+  Command::put(Command::SET_NETWORK_ERROR, NETWORKErrors::UDP_DISCONNECT_ERROR);
+  is_connected = false;
+}
+
+void UDPManager::close_connection() {
+  freeaddrinfo(sendinfo);  // Free memory
+  close(send_socketfd);  // Close socket
+  close(recv_socketfd);  // Close socket
+  setup.reset();  // Reset event (important when tests are run repeatedly)
+  print(LogLevel::LOG_INFO, "UDP Exiting\n");
+}
+
+void UDPManager::connection_monitor(const char * hostname, const char * send_port, const char * recv_port) {
+  ThreadConfig::apply("udp_manager");
+  if (!open_connection(hostname, send_port, recv_port)) {
+    return; 
+  }
+
+  // Setup variables for UDP loop
+  int rv;
+  int timeout = -1; 
+  struct pollfd fds[2];
+  fds[0].fd = recv_socketfd;
+  fds[0].events = POLLIN;
+  fds[1].fd = closing.fd();  // close_client() wakes us up through this
+  fds[1].events = POLLIN;
 
   // Poll indefinitely until a ping is received, then go into ping-ack loop.
   while (running) {
-    rv = poll(fds, 1, timeout);  // http://beej.us/guide/bgnet/html/single/bgnet.html#indexId434909-276
+    rv = poll(fds, 2, timeout);  // http://beej.us/guide/bgnet/html/single/bgnet.html#indexId434909-276
     if (rv == -1) {  // ERROR occured in poll()
       print(LogLevel::LOG_ERROR, "UDP poll() failed: %s\n", strerror(errno));
       Command::put(Command::SET_NETWORK_ERROR, NETWORKErrors::UDP_DISCONNECT_ERROR);
       is_connected = false;
     } else if (rv == 0) {  // Timeout occured 
-      print(LogLevel::LOG_ERROR, "UDP timeout\n");
-      Command::put(Command::SET_NETWORK_ERROR, NETWORKErrors::UDP_DISCONNECT_ERROR);
-      is_connected = false;
+      handle_timeout();
     } else {
-      if (fds[0].revents & POLLIN) {  // There is data to be read from UDP
+      if (fds[1].revents & POLLIN) {
+        break;  // Closing
+      } else if (fds[0].revents & POLLIN) {  // There is data to be read from UDP
         timeout = connected_timeout;  // Set timeout to appropriate value
-        byte_count = udp_recv(read_buffer, sizeof(read_buffer));  // Read message
-        if (byte_count > 0 && udp_parse(read_buffer, byte_count)) {  // Check if PING. Returns true if message was PING
-          byte_count = udp_send(send_buffer, sizeof(send_buffer));  // Respond with ACK
-          // print(LogLevel::LOG_DEBUG, "sent %d bytes, \n", byte_count); 
-          if (!is_connected) {
-            print(LogLevel::LOG_INFO, "UDP Connected! \n");
-            Command::put(Command::CLR_NETWORK_ERROR, NETWORKErrors::UDP_DISCONNECT_ERROR);
-            is_connected = true;
-          }
-        }
+        handle_message();
       } else {
         // print(LogLevel::LOG_ERROR, "UDP poll event, but not on specified socket with specified event\n");
         // TODO: Once Unified Command Queue is implemented, consider this as a failure & write to queue
@@ -217,16 +278,25 @@ void UDPManager::connection_monitor(const char * hostname, const char * send_por
     }
   }
 
-  freeaddrinfo(sendinfo);  // Free memory
-  close(send_socketfd);  // Close socket
-  close(recv_socketfd);  // Close socket
-  setup.reset();  // Reset event (important when tests are run repeatedly)
-  print(LogLevel::LOG_INFO, "UDP Exiting\n");
+  close_connection();
+}
+
+bool UDPManager::attach(Reactor * reactor, const char * hostname, const char * send_port, const char * recv_port) {
+  if (!open_connection(hostname, send_port, recv_port)) {
+    return false;
+  }
+  handler.deadline = 0;  // No timeout until the first message arrives
+  if (!reactor->add(&handler)) {
+    close_connection();
+    return false;
+  }
+  return true;
 }
 
 void UDPManager::close_client() {
   std::lock_guard<std::mutex> guard(mutex);
   running.store(false);
+  closing.invoke();
   shutdown(recv_socketfd, SHUT_RDWR);
   shutdown(send_socketfd, SHUT_RDWR);
 }
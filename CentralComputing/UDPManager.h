@@ -7,6 +7,7 @@
 #include "Configurator.h"
 #include "SafeQueue.hpp"
 #include "Event.h"
+#include "Reactor.h"
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <stdlib.h>
@@ -34,6 +35,7 @@ extern Connection_Status connection_status;
 extern struct addrinfo hints, *sendinfo, *recvinfo;
 
 extern Event setup;
+extern Event closing;  // Invoked by close_client(), connection_monitor() polls it along with the socket
 extern std::mutex mutex;
 
 /**
@@ -53,6 +55,19 @@ bool udp_parse(uint8_t* buf, uint8_t len);     // parse the data in the buffer
  **/
 void connection_monitor(const char * hostname, const char * send_port, const char * recv_port);
 
+/**
+ * Reactor mode: sets up the UDP sockets, then has reactor run the ping/ack exchange instead of connection_monitor()
+ * Call close_connection() once the reactor has stopped
+ * @return false if the sockets couldn't be set up
+ **/
+bool attach(Reactor * reactor, const char * hostname, const char * send_port, const char * recv_port);
+
+// Pieces of connection_monitor(), shared with the reactor mode
+bool open_connection(const char * hostname, const char * send_port, const char * recv_port);
+void handle_message();  // Reads a message, ACKs it if it was a PING
+void handle_timeout();  // No message within the connected timeout
+void close_connection();
+
 /**
  * Closes the socket, ending all transmission
  **/
@@ -3,6 +3,7 @@
 #include "Defines.hpp"
 #include "Utils.h"
 #include "Configurator.h"
+#include "ObjectPool.hpp"
 
 using Utils::print;
 using Utils::microseconds;
@@ -52,27 +53,19 @@ class Scenario{
 
   // By default, all functions return "empty data"
   virtual std::shared_ptr<ADCData> sim_get_adc() {
-    std::shared_ptr<ADCData> d = std::make_shared<ADCData>();
-    memset(d.get(), (uint8_t)0, sizeof(ADCData));
-    return d;
+    return DataPool::make<ADCData>();
   }
   
   virtual std::shared_ptr<CANData> sim_get_can() {
-    std::shared_ptr<CANData> d = std::make_shared<CANData>();
-    memset(d.get(), (uint8_t)0, sizeof(CANData));
-    return d;
+    return DataPool::make<CANData>();
   }
 
   virtual std::shared_ptr<I2CData> sim_get_i2c() {
-    std::shared_ptr<I2CData> d = std::make_shared<I2CData>();
-    memset(d.get(), (uint8_t)0, sizeof(I2CData));
-    return d;
+    return DataPool::make<I2CData>();
   }
 
   virtual std::shared_ptr<PRUData> sim_get_pru() {
-    std::shared_ptr<PRUData> d = std::make_shared<PRUData>();
-    memset(d.get(), (uint8_t)0, sizeof(PRUData));
-    return d;
+    return DataPool::make<PRUData>();
   }
 
   virtual std::shared_ptr<MotionData> sim_get_motion() {
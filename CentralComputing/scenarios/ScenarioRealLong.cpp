@@ -54,7 +54,7 @@ void ScenarioRealLong::true_motion() {
 
 std::shared_ptr<ADCData> ScenarioRealLong::sim_get_adc() {
   true_motion();
-  std::shared_ptr<ADCData> d = std::make_shared<ADCData>();
+  std::shared_ptr<ADCData> d = DataPool::make<ADCData>();
   // Multiply by 455/ 9.80665 to convert m/s/s to adc "levels"
   d->data[adc_axis_0] =  acceleration * 455/ 9.80665; 
   d->data[adc_axis_1] =  acceleration * 455/ 9.80665;
@@ -66,7 +66,7 @@ std::shared_ptr<CANData> ScenarioRealLong::sim_get_can() {
   true_motion();
 
   // Create a CANData struct and fill with data
-  std::shared_ptr<CANData> d = std::make_shared<CANData>();
+  std::shared_ptr<CANData> d = DataPool::make<CANData>();
   d->status_word = 0;
   d->controller_temp = 30;
   d->motor_temp = 30;
@@ -92,9 +92,7 @@ std::shared_ptr<CANData> ScenarioRealLong::sim_get_can() {
 
 std::shared_ptr<I2CData> ScenarioRealLong::sim_get_i2c() {
   true_motion();
-  std::shared_ptr<I2CData> d = std::make_shared<I2CData>();
-  memset(d.get(), (uint8_t)0, sizeof(I2CData));
-  return d;
+  return DataPool::make<I2CData>();
 }
 
 std::shared_ptr<PRUData> ScenarioRealLong::sim_get_pru() {
@@ -102,7 +100,7 @@ std::shared_ptr<PRUData> ScenarioRealLong::sim_get_pru() {
   print(LogLevel::LOG_DEBUG, 
     "TRUE Motion: Pos: %.2f, Vel: %.2f, Acl: %.2f \n", position, velocity, acceleration );
 
-  std::shared_ptr<PRUData> d = std::make_shared<PRUData>();
+  std::shared_ptr<PRUData> d = DataPool::make<PRUData>();
   d->wheel_velocity[0] =  velocity * 1000; // multiply by 1000 to convert to millimeters
   d->wheel_velocity[1] =  velocity * 1000;
 
@@ -0,0 +1,73 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "Command.h"
+
+// A burst of queued commands is applied within a few logic loop iterations, not one per iteration
+TEST_F(PodTest, CommandBatchDrain) {
+  int64_t start = LatencyHistogram::now();
+  for (int i = 0; i < 64; i++) {
+    Command::put(Command::CLR_OTHER_ERROR, OTHERErrors::GPIO_SWITCH_ERROR);
+  }
+  Command::wait_for_empty();
+  int64_t elapsed = LatencyHistogram::now() - start;
+  print(LogLevel::LOG_INFO, "64 commands drained in %ld us\n", (long) (elapsed / 1000));
+  EXPECT_LT(elapsed, 32000000);  // 64 ms at one per 1 ms iteration
+}
+
+// Commands queued together are applied in order (within a priority lane, see Command.h):
+// each sees the state the previous ones left
+TEST_F(PodTest, CommandBatchOrder) {
+  pod->processing_command.reset();
+  Command::put(Command::TRANS_FUNCTIONAL_TEST_OUTSIDE, 0);
+  Command::put(Command::ENABLE_MOTOR, 0);
+  Command::put(Command::SET_MOTOR_SPEED, 125);
+  Command::put(Command::TRANS_SAFE_MODE, 0);  // Turns the motor off
+  Command::put(Command::ENABLE_MOTOR, 0);  // Not allowed in safe mode
+  Command::wait_for_empty();
+  pod->processing_command.wait();
+  usleep(10000);  // Let the iteration that drained them finish
+
+  EXPECT_EQ(pod->state_machine->get_current_state(), E_States::ST_SAFE_MODE);
+  EXPECT_FALSE(pod->state_machine->motor.is_enabled());
+  EXPECT_EQ(pod->state_machine->motor.get_throttle(), 0);
+
+  // Set then cleared in the same batch
+  pod->processing_error.reset();
+  Command::put(Command::SET_OTHER_ERROR, OTHERErrors::GPIO_SWITCH_ERROR);
+  Command::put(Command::CLR_OTHER_ERROR, OTHERErrors::GPIO_SWITCH_ERROR);
+  Command::wait_for_empty();
+  pod->processing_error.wait();
+  usleep(10000);
+  TCPManager::data_mutex.lock();
+  EXPECT_EQ(pod->unified_state.errors->error_vector[5], (uint32_t) 0);  // OTHER errors
+  TCPManager::data_mutex.unlock();
+}
+
+// Same commands, checking the effect of the first half before the transition back to safe mode
+TEST_F(PodTest, CommandBatchActions) {
+  pod->processing_command.reset();
+  Command::put(Command::TRANS_FUNCTIONAL_TEST_OUTSIDE, 0);
+  Command::put(Command::ENABLE_MOTOR, 0);
+  Command::put(Command::SET_MOTOR_SPEED, 125);
+  Command::wait_for_empty();
+  pod->processing_command.wait();
+  usleep(10000);
+
+  EXPECT_EQ(pod->state_machine->get_current_state(), E_States::ST_FUNCTIONAL_TEST_OUTSIDE);
+  EXPECT_TRUE(pod->state_machine->motor.is_enabled());
+  EXPECT_EQ(pod->state_machine->motor.get_throttle(), 125);
+}
+
+// A brake command queued behind the transition that allows it is applied after that transition, not first
+TEST_F(PodTest, CommandBatchBrakeAfterTransition) {
+  pod->processing_command.reset();
+  Command::put(Command::TRANS_FUNCTIONAL_TEST_OUTSIDE, 0);
+  Command::put(Command::ENABLE_BRAKE, 0);  // Ignored in safe mode
+  Command::wait_for_empty();
+  pod->processing_command.wait();
+  usleep(10000);
+
+  EXPECT_EQ(pod->state_machine->get_current_state(), E_States::ST_FUNCTIONAL_TEST_OUTSIDE);
+  EXPECT_TRUE(pod->state_machine->brakes.is_enabled());
+}
+#endif
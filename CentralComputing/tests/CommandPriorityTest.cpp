@@ -0,0 +1,77 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "Command.h"
+
+namespace {
+uint32_t next_id() {
+  Command::Network_Command com;
+  EXPECT_TRUE(Command::get(&com));
+  return com.id;
+}
+}  // namespace
+
+TEST(CommandPriorityTest, Lanes) {
+  EXPECT_EQ(Command::priority_of(Command::TRANS_ABORT), Command::PRIORITY_CRITICAL);
+  EXPECT_EQ(Command::priority_of(Command::TRANS_FLIGHT_BRAKE), Command::PRIORITY_CRITICAL);
+  EXPECT_EQ(Command::priority_of(Command::ENABLE_BRAKE), Command::PRIORITY_NORMAL);
+  EXPECT_EQ(Command::priority_of(Command::DISABLE_BRAKE), Command::PRIORITY_NORMAL);
+  EXPECT_EQ(Command::priority_of(Command::SET_ADC_ERROR), Command::PRIORITY_ERROR);
+  EXPECT_EQ(Command::priority_of(Command::CLR_OTHER_ERROR), Command::PRIORITY_ERROR);
+  EXPECT_EQ(Command::priority_of(Command::SET_MOTOR_SPEED), Command::PRIORITY_NORMAL);
+  EXPECT_EQ(Command::priority_of(Command::TRANS_FLIGHT_COAST), Command::PRIORITY_NORMAL);
+}
+
+TEST(CommandPriorityTest, CriticalFirst) {
+  Command::flush();
+  Command::put(Command::SET_MOTOR_SPEED, 100);
+  Command::put(Command::CLR_CAN_ERROR, CAN_SEND_FRAME_ERROR);
+  Command::put(Command::SET_MOTOR_SPEED, 200);
+  Command::put(Command::SET_CAN_ERROR, CAN_SEND_FRAME_ERROR);
+  Command::put(Command::TRANS_FLIGHT_BRAKE, 0);
+  Command::put(Command::TRANS_ABORT, 0);
+
+  EXPECT_EQ(next_id(), (uint32_t) Command::TRANS_FLIGHT_BRAKE);
+  EXPECT_EQ(next_id(), (uint32_t) Command::TRANS_ABORT);
+  EXPECT_EQ(next_id(), (uint32_t) Command::CLR_CAN_ERROR);  // Set/clear order is kept
+  EXPECT_EQ(next_id(), (uint32_t) Command::SET_CAN_ERROR);
+
+  Command::Network_Command com;
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.value, (uint32_t) 100);
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.value, (uint32_t) 200);
+  EXPECT_FALSE(Command::get(&com));
+}
+
+// A normal command that has waited too long goes ahead of newer error commands, but never ahead of critical ones
+TEST(CommandPriorityTest, AgedCommandsNotStarved) {
+  Command::flush();
+  Command::put(Command::SET_MOTOR_SPEED, 100);
+  usleep(COMMAND_MAX_WAIT / 1000 + 2000);
+  Command::put(Command::SET_ADC_ERROR, ADC_READ_ERROR);
+  Command::put(Command::TRANS_ABORT, 0);
+
+  EXPECT_EQ(next_id(), (uint32_t) Command::TRANS_ABORT);
+  EXPECT_EQ(next_id(), (uint32_t) Command::SET_MOTOR_SPEED);
+  EXPECT_EQ(next_id(), (uint32_t) Command::SET_ADC_ERROR);
+}
+
+// An abort queued behind a backlog is handled next, and its wait is measured
+TEST_F(PodTest, AbortJumpsBacklog) {
+  Command::queue_wait[Command::PRIORITY_CRITICAL].reset();
+  Command::queue_wait[Command::PRIORITY_NORMAL].reset();
+  for (int i = 0; i < 100; i++) {
+    Command::put(Command::SET_MOTOR_SPEED, 0);
+  }
+  Command::put(Command::TRANS_ABORT, 0);
+  Command::wait_for_empty();
+
+  LatencyHistogram & critical = Command::queue_wait[Command::PRIORITY_CRITICAL];
+  LatencyHistogram & normal = Command::queue_wait[Command::PRIORITY_NORMAL];
+  EXPECT_EQ(critical.count(), (uint64_t) 1);
+  EXPECT_EQ(normal.count(), (uint64_t) 100);
+  EXPECT_LT(critical.max(), normal.max());
+  critical.print("abort_queue_wait");
+  normal.print("backlog_queue_wait");
+}
+#endif
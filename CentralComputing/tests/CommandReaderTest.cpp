@@ -0,0 +1,108 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "CommandReader.h"
+#include "TCPManager.h"
+#include <sys/socket.h>
+#include <vector>
+
+namespace {
+std::vector<uint8_t> encode(const std::vector<Command::Network_Command> & commands) {
+  std::vector<uint8_t> bytes;
+  for (const Command::Network_Command & command : commands) {
+    for (uint32_t word : {command.id, command.value}) {
+      for (int i = 0; i < 4; i++) {
+        bytes.push_back((uint8_t) (word >> (8 * i)));  // Little endian
+      }
+    }
+  }
+  return bytes;
+}
+}  // namespace
+
+// However the stream is cut up, every command comes out whole and in order
+TEST(CommandReaderTest, PartialAndCoalesced) {
+  std::vector<Command::Network_Command> sent;
+  for (uint32_t i = 0; i < 40; i++) {
+    sent.push_back({i % Command::SENTINEL, 0x01020304u * i});
+  }
+  std::vector<uint8_t> bytes = encode(sent);
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  CommandReader reader(fds[0]);
+  std::vector<Command::Network_Command> received;
+  Command::Network_Command out[CommandReader::MAX_COMMANDS];
+  // 1 byte, part of a command, exactly one, several with a partial one at the end...
+  const size_t cuts[] = {1, 3, 4, 8, 13, 21, 2, 100, 5, 7};
+  size_t at = 0;
+  for (size_t i = 0; at < bytes.size(); i++) {
+    size_t size = std::min(cuts[i % 10], bytes.size() - at);
+    ASSERT_EQ(write(fds[1], &bytes[at], size), (ssize_t) size);
+    at += size;
+    ASSERT_EQ(reader.fill(), (ssize_t) size);
+    size_t count = reader.decode(out, CommandReader::MAX_COMMANDS);
+    received.insert(received.end(), out, out + count);
+    EXPECT_EQ(reader.buffered(), at - received.size() * COMMAND_FRAME_SIZE);
+  }
+  ASSERT_EQ(received.size(), sent.size());
+  for (size_t i = 0; i < sent.size(); i++) {
+    EXPECT_EQ(received[i].id, sent[i].id);
+    EXPECT_EQ(received[i].value, sent[i].value);
+  }
+  EXPECT_EQ(reader.commands, (uint64_t) sent.size());
+  EXPECT_EQ(reader.buffered(), (size_t) 0);
+
+  // A whole burst in one read
+  ASSERT_EQ(write(fds[1], bytes.data(), bytes.size()), (ssize_t) bytes.size());
+  ASSERT_EQ(reader.fill(), (ssize_t) bytes.size());
+  EXPECT_EQ(reader.decode(out, 10), (size_t) 10);  // The rest wait
+  EXPECT_EQ(reader.decode(out, CommandReader::MAX_COMMANDS), sent.size() - 10);
+  EXPECT_EQ(out[0].value, sent[10].value);
+
+  close(fds[1]);
+  EXPECT_EQ(reader.fill(), 0);
+  close(fds[0]);
+
+  // Bytes from elsewhere, and a buffer that's full until decoded
+  reader.reset(-1);
+  const uint8_t command[] = {31, 0, 0, 0, 0x02, 0x01, 0, 0};
+  EXPECT_EQ(reader.append(command, sizeof(command)), sizeof(command));
+  ASSERT_EQ(reader.decode(out, 1), (size_t) 1);
+  EXPECT_EQ(out[0].id, (uint32_t) 31);
+  EXPECT_EQ(out[0].value, (uint32_t) 0x0102);
+  std::vector<uint8_t> filler(COMMAND_READ_BUFFER + 1);
+  EXPECT_EQ(reader.append(filler.data(), filler.size()), (size_t) COMMAND_READ_BUFFER);
+  EXPECT_EQ(reader.fill(), -1);
+}
+
+// Thousands of commands in one burst from the base station: none dropped, far fewer reads than commands
+TEST_F(PodTest, TCPCommandThroughput) {
+  const uint32_t total = 5000;  // Many times what the command lane holds
+  std::vector<Command::Network_Command> commands;
+  for (uint32_t i = 0; i < total; i++) {
+    commands.push_back({Command::REQUEST_KEYFRAME, i});  // Harmless, no transition
+  }
+  uint64_t read_before = TCPManager::commands_read.load();
+  uint64_t syscalls_before = TCPManager::read_syscalls.load();
+  uint64_t applied_before = Command::queue_wait[Command::PRIORITY_NORMAL].count();
+  uint64_t dropped_before = Command::command_queue[Command::PRIORITY_NORMAL].overflows();
+
+  int64_t start = Utils::microseconds();
+  ASSERT_TRUE(SimulatorManager::sim.send_commands(commands));
+  for (int i = 0; i < 1000 && TCPManager::commands_read.load() - read_before < total; i++) {
+    usleep(10000);
+  }
+  Command::wait_for_empty();
+  int64_t elapsed = Utils::microseconds() - start;
+
+  uint64_t read = TCPManager::commands_read.load() - read_before;
+  uint64_t syscalls = TCPManager::read_syscalls.load() - syscalls_before;
+  EXPECT_EQ(read, (uint64_t) total);
+  EXPECT_GE(Command::queue_wait[Command::PRIORITY_NORMAL].count() - applied_before, (uint64_t) total);
+  EXPECT_EQ(Command::command_queue[Command::PRIORITY_NORMAL].overflows(), dropped_before);
+  EXPECT_LT(syscalls, (uint64_t) total / 8);
+  print(LogLevel::LOG_INFO, "%u commands in %ld us (%.0f commands/s), %lu reads, waited for room %lu times\n",
+        total, (long) elapsed, total * 1000000.0 / (double) elapsed, (unsigned long) syscalls,  // NOLINT
+        (unsigned long) TCPManager::command_waits.load());  // NOLINT
+}
+#endif
@@ -3,6 +3,10 @@
 #include "Command.h"
 #include "Defines.hpp"
 #include <string>
+#include <atomic>
+#include <mutex> // NOLINT
+#include <thread> // NOLINT
+#include <vector>
 
 using namespace std;
 
@@ -59,6 +63,136 @@ TEST(ErrorFlagTest, ErrorFlagTestBasic) {
 
 }
 
+namespace {
+// The mutex and loop over all 32 bits that set_error_flag used before, kept to compare against.
+// Counts what it would have sent instead of putting commands
+std::mutex legacy_mutex;
+int64_t legacy_timers[FLAGS_PER_ERROR];
+std::atomic<int> legacy_sent(0);
+
+void legacy_set_error_flag(uint32_t value) {
+  legacy_mutex.lock();
+  legacy_mutex.unlock();
+  for (int i = 0, j = 1; i < FLAGS_PER_ERROR; i++, j*=2) {
+    if (value & ((uint32_t) j)) {
+      int64_t delta = microseconds() - legacy_timers[i];
+      if (delta > 1000000) {
+        legacy_timers[i] = microseconds();
+        legacy_sent++;
+      }
+    }
+  }
+}
+
+// Every thread sets the same handful of error bits as fast as it can, like a sensor faulting every refresh
+template <class F>
+void error_storm(F set_flag, LatencyHistogram * latency) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&] {
+      for (int i = 0; i < 100000; i++) {
+        int64_t start = LatencyHistogram::now();
+        set_flag();
+        latency->record(LatencyHistogram::now() - start);
+      }
+    }));
+  }
+  for (auto & t : threads) {
+    t.join();
+  }
+}
+}  // namespace
+
+// Under a storm from several threads each bit is still sent at most once per period
+TEST(ErrorFlagTest, ErrorFlagStorm) {
+  const uint32_t storm = ADC_READ_ERROR | ADC_POSITIVE_SANITY_ERROR | ADC_NEGATIVE_SANITY_ERROR;
+  for (int i = 0; i < FLAGS_PER_ERROR * 6; i++) {
+    Command::error_flag_timers[i] = -1000000;
+  }
+  Command::flush();
+
+  LatencyHistogram latency;
+  int64_t start = LatencyHistogram::now();
+  error_storm([&] { Command::set_error_flag(Command::SET_ADC_ERROR, storm); }, &latency);
+  int64_t periods = (LatencyHistogram::now() - start) / (ERROR_FLAG_PERIOD * 1000) + 1;
+
+  // Nothing drains the queue here, so every bit rides on the first command
+  int sent = 0;
+  int commands = 0;
+  Command::Network_Command com;
+  while (Command::get(&com)) {
+    EXPECT_EQ(com.id, Command::SET_ADC_ERROR);
+    EXPECT_EQ(com.value & ~storm, (uint32_t) 0);
+    sent += __builtin_popcount(com.value);
+    commands++;
+  }
+  EXPECT_EQ(commands, 1);
+  EXPECT_GE(sent, 3);
+  EXPECT_LE(sent, 3 * periods);
+  latency.print("set_error_flag_storm");
+
+  LatencyHistogram legacy_latency;
+  error_storm([&] { legacy_set_error_flag(storm); }, &legacy_latency);
+  legacy_latency.print("legacy_set_error_flag_storm");
+
+  for (int i = 0; i < FLAGS_PER_ERROR * 6; i++) {
+    Command::error_flag_timers[i] = -1000000;
+  }
+}
+
+// Bits from one source set before the logic loop gets to them become one command, each bit still rate limited
+TEST(ErrorFlagTest, ErrorFlagCoalesce) {
+  for (int i = 0; i < FLAGS_PER_ERROR * 6; i++) {
+    Command::error_flag_timers[i] = -1000000;
+  }
+  Command::flush();
+  Command::Network_Command com;
+
+  Command::set_error_flag(Command::SET_CAN_ERROR, CAN_SEND_FRAME_ERROR);
+  Command::set_error_flag(Command::SET_CAN_ERROR, CAN_RECV_FRAME_ERROR | CAN_SEND_FRAME_ERROR);
+  Command::set_error_flag(Command::SET_ADC_ERROR, ADC_READ_ERROR);
+  Command::set_error_flag(Command::SET_CAN_ERROR, CAN_MOTOR_CONTROLLER_INTERNAL_ERROR);
+  EXPECT_EQ(Command::size(), 2);
+
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.id, Command::SET_CAN_ERROR);
+  EXPECT_EQ(com.value, CAN_SEND_FRAME_ERROR | CAN_RECV_FRAME_ERROR | CAN_MOTOR_CONTROLLER_INTERNAL_ERROR);
+  EXPECT_EQ(Command::get_network_command_value_string(&com),
+            "CAN_SEND_FRAME_ERROR|CAN_RECV_FRAME_ERROR|CAN_MOTOR_CONTROLLER_INTERNAL_ERROR");
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.id, Command::SET_ADC_ERROR);
+  EXPECT_EQ(com.value, ADC_READ_ERROR);
+  EXPECT_FALSE(Command::get(&com));
+
+  // Only the bit that has not been sent this period goes out
+  Command::set_error_flag(Command::SET_CAN_ERROR, CAN_SEND_FRAME_ERROR | CAN_MOTOR_CONTROLLER_WARN);
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.value, CAN_MOTOR_CONTROLLER_WARN);
+  EXPECT_FALSE(Command::get(&com));
+
+  // A placeholder that was flushed does not block the next one
+  Command::set_error_flag(Command::SET_PRU_ERROR, PRU_SETUP_FAILURE);
+  Command::flush();
+  Command::error_flag_timers[(Command::SET_PRU_ERROR - Command::SET_ADC_ERROR) * FLAGS_PER_ERROR] = -1000000;
+  Command::set_error_flag(Command::SET_PRU_ERROR, PRU_SETUP_FAILURE);
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.value, PRU_SETUP_FAILURE);
+
+  for (int i = 0; i < FLAGS_PER_ERROR * 6; i++) {
+    Command::error_flag_timers[i] = -1000000;
+  }
+}
+
+// Several bits in one call land in the error vector together
+TEST_F(PodTest, ErrorFlagTestWithPodCoalesced) {
+  pod->processing_error.reset();
+  Command::set_error_flag(Command::SET_ADC_ERROR, ADC_READ_ERROR | ADC_STALE_DATA);
+  pod->processing_error.wait();
+  TCPManager::data_mutex.lock();   // MUST USE LOCK TO AVOID TSAN ERRORS
+  EXPECT_EQ(pod->unified_state.errors->error_vector[0], ADC_READ_ERROR | ADC_STALE_DATA);
+  TCPManager::data_mutex.unlock();
+}
+
 //Test Setting error flags without Pod
 TEST_F(PodTest, ErrorFlagTestWithPodUnifiedState) {
   UnifiedState * unified_state;
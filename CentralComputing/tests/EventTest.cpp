@@ -0,0 +1,173 @@
+#ifdef SIM // Only compile if building test executable
+#include "Event.h"
+#include "Poller.h"
+#include "LatencyHistogram.h"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable> // NOLINT
+#include <thread> // NOLINT
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace {
+// The mutex/ condition_variable Event this replaced, kept to compare against
+class CondEvent {
+ public:
+  void wait() {
+    std::unique_lock<std::mutex> lk(mutex);
+    cond.wait(lk, [&]{ return condition; });
+  }
+  void invoke() {
+    std::unique_lock<std::mutex> lk(mutex);
+    condition = true;
+    lk.unlock();
+    cond.notify_all();
+  }
+  void reset() {
+    std::lock_guard<std::mutex> guard(mutex);
+    condition = false;
+  }
+
+ private:
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool condition = false;
+};
+
+// Time from invoke() in this thread to wait() returning in another
+template <class E>
+void measure_wake(LatencyHistogram * latency) {
+  E event;
+  E done;
+  std::atomic<int64_t> invoked_at(0);
+  for (int i = 0; i < 500; i++) {
+    event.reset();
+    done.reset();
+    std::thread waiter([&] {
+      event.wait();
+      latency->record(LatencyHistogram::now() - invoked_at.load());
+      done.invoke();
+    });
+    usleep(200);  // Let it block
+    invoked_at.store(LatencyHistogram::now());
+    event.invoke();
+    done.wait();
+    waiter.join();
+  }
+}
+}  // namespace
+
+TEST(EventTest, SetAndReset) {
+  Event e;
+  EXPECT_FALSE(e.is_set());
+  e.invoke();
+  e.invoke();  // Stays set, one reset() clears it
+  EXPECT_TRUE(e.is_set());
+  e.wait();  // Returns right away
+  e.reset();
+  EXPECT_FALSE(e.is_set());
+
+  int64_t start = LatencyHistogram::now();
+  e.wait_for(20000);
+  int64_t elapsed = LatencyHistogram::now() - start;
+  EXPECT_GE(elapsed, 20000000);
+  EXPECT_LT(elapsed, 200000000);
+
+  // A deadline in the past returns right away
+  e.wait_until(0);
+}
+
+TEST(EventTest, WakesAllWaiters) {
+  Event e;
+  std::atomic<int> woken(0);
+  std::vector<std::thread> waiters;
+  for (int i = 0; i < 4; i++) {
+    waiters.push_back(std::thread([&] {
+      e.wait();
+      woken++;
+    }));
+  }
+  usleep(10000);
+  EXPECT_EQ(woken.load(), 0);
+  e.invoke();
+  for (auto & t : waiters) {
+    t.join();
+  }
+  EXPECT_EQ(woken.load(), 4);
+}
+
+// The fd can sit in a poll()/ Poller next to other fds
+TEST(EventTest, Pollable) {
+  Event e;
+  struct pollfd pfd;
+  pfd.fd = e.fd();
+  pfd.events = POLLIN;
+  EXPECT_EQ(poll(&pfd, 1, 0), 0);
+  e.invoke();
+  EXPECT_EQ(poll(&pfd, 1, 0), 1);
+  EXPECT_EQ(poll(&pfd, 1, 0), 1);  // Level triggered, until reset()
+  e.reset();
+  EXPECT_EQ(poll(&pfd, 1, 0), 0);
+
+  Poller poller;
+  ASSERT_TRUE(poller.open());
+  ASSERT_TRUE(poller.add(e.fd()));
+  EXPECT_EQ(poller.wait(1000), 0);
+  std::thread invoker([&] {
+    usleep(5000);
+    e.invoke();
+  });
+  int ready[Poller::MAX_EVENTS];
+  ASSERT_EQ(poller.wait(1000000, ready, Poller::MAX_EVENTS), 1);
+  EXPECT_EQ(ready[0], e.fd());
+  invoker.join();
+}
+
+// Without an eventfd (here: no file descriptors left) waits still return once the event is invoked
+TEST(EventTest, NoEventfdFallback) {
+  struct rlimit saved;
+  ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &saved), 0);
+  int lowest_free = eventfd(0, 0);  // Not dup(0), stdin may have been closed by an earlier test
+  ASSERT_GE(lowest_free, 0);
+  close(lowest_free);
+  struct rlimit limited = saved;
+  limited.rlim_cur = (rlim_t) lowest_free;  // The next fd would be past the limit
+  ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limited), 0);
+  Event e;
+  ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &saved), 0);
+  ASSERT_EQ(e.fd(), -1);
+
+  int64_t start = LatencyHistogram::now();
+  e.wait_for(20000);
+  EXPECT_GE(LatencyHistogram::now() - start, 20000000);
+  EXPECT_FALSE(e.is_set());
+
+  std::thread invoker([&] {
+    usleep(10000);
+    e.invoke();
+  });
+  start = LatencyHistogram::now();
+  e.wait();
+  EXPECT_LT(LatencyHistogram::now() - start, 1000000000);
+  EXPECT_TRUE(e.is_set());
+  invoker.join();
+
+  e.reset();
+  EXPECT_FALSE(e.is_set());
+  e.wait_until(0);
+}
+
+TEST(EventTest, WakeLatencyBenchmark) {
+  LatencyHistogram eventfd_latency;
+  LatencyHistogram condvar_latency;
+  measure_wake<Event>(&eventfd_latency);
+  measure_wake<CondEvent>(&condvar_latency);
+  eventfd_latency.print("eventfd_event_wake");
+  condvar_latency.print("condvar_event_wake");
+  EXPECT_EQ(eventfd_latency.count(), (uint64_t) 500);
+  EXPECT_EQ(condvar_latency.count(), (uint64_t) 500);
+}
+#endif
@@ -0,0 +1,160 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "FlightRecorder.h"
+#include "ScenarioRealLong.h"
+#include <string.h>
+#include <vector>
+
+using std::make_shared;
+
+namespace {
+// Snapshot i of a made up run, every field the test checks a function of i
+void fill(UnifiedState * state, uint32_t i) {
+  state->motion_data->x[0] = (int32_t) i;
+  state->motion_data->x[1] = (int32_t) (i % 500) * 3;
+  for (int k = 0; k < NUM_ADC; k++) {
+    state->adc_data->data[k] = (int32_t) ((i * 7 + (uint32_t) k) % 4096);
+  }
+  state->can_data->torque_val = i % 1000;
+  state->state = i % 2 ? ST_FLIGHT_ACCEL : ST_FLIGHT_COAST;
+}
+}  // namespace
+
+// Reads back what was recorded, in order, after the ring has wrapped around
+TEST(FlightRecorderTest, RoundTripAndWrap) {
+  UnifiedState state;
+  state.motion_data = make_shared<MotionData>();
+  state.adc_data = make_shared<ADCData>();
+  state.can_data = make_shared<CANData>();
+  state.i2c_data = make_shared<I2CData>();
+  state.pru_data = make_shared<PRUData>();
+  state.errors = make_shared<Errors>();
+  memset(state.motion_data.get(), 0, sizeof(MotionData));
+  memset(state.can_data.get(), 0, sizeof(CANData));
+  memset(state.i2c_data.get(), 0, sizeof(I2CData));
+  memset(state.pru_data.get(), 0, sizeof(PRUData));
+  memset(state.errors.get(), 0, sizeof(Errors));
+
+  std::string path = "/tmp/flight_recorder_test.rec";
+  FlightRecorder recorder;
+  EXPECT_FALSE(recorder.record(state));  // Not open
+  EXPECT_FALSE(recorder.open(path, FLIGHT_RECORDER_BLOCK_SIZE));  // Too small to be a ring
+  ASSERT_TRUE(recorder.open(path, 3 * FLIGHT_RECORDER_BLOCK_SIZE));
+  const uint32_t total = 6000;
+  for (uint32_t i = 0; i < total; i++) {
+    if (i % 7 == 0) {
+      Command::Network_Command command = {Command::REQUEST_KEYFRAME, i};
+      EXPECT_TRUE(recorder.record(command));
+    }
+    fill(&state, i);
+    EXPECT_TRUE(recorder.record(state));
+    if (i % 200 == 199) {
+      usleep(15000);  // Let the writer keep up, the queue holds FLIGHT_RECORDER_QUEUE_SIZE
+    }
+  }
+  recorder.close();
+  EXPECT_FALSE(recorder.record(state));
+  EXPECT_EQ(recorder.snapshots.load(), (uint64_t) total);
+  EXPECT_EQ(recorder.dropped.load(), (uint64_t) 0);
+  EXPECT_GT(recorder.blocks.load(), (uint64_t) recorder.block_count());  // Wrapped
+
+  FlightRecordReader reader;
+  ASSERT_TRUE(reader.open(path));
+  EXPECT_EQ(reader.blocks(), (size_t) 3);
+  EXPECT_GT(reader.started(), (int64_t) 0);
+  FlightRecordReader::Entry entry;
+  int64_t previous_time = 0;
+  int64_t previous = -1;
+  uint32_t snapshots = 0;
+  uint32_t commands = 0;
+  while (reader.next(&entry)) {
+    EXPECT_GE(entry.timestamp, previous_time);
+    previous_time = entry.timestamp;
+    if (entry.kind == FLIGHT_RECORD_COMMAND) {
+      // Recorded just before snapshot value
+      EXPECT_EQ(entry.command.id, (uint32_t) Command::REQUEST_KEYFRAME);
+      EXPECT_EQ(entry.command.value % 7, (uint32_t) 0);
+      EXPECT_EQ((int64_t) entry.command.value, previous + 1);
+      commands++;
+      continue;
+    }
+    uint32_t i = (uint32_t) entry.snapshot.motion.x[0];
+    EXPECT_EQ(entry.snapshot.sequence, i);
+    if (previous >= 0) {
+      ASSERT_EQ((int64_t) i, previous + 1);  // Nothing missing or out of order within what's left
+    }
+    previous = i;
+    fill(&state, i);
+    EXPECT_EQ(entry.snapshot.motion.x[1], state.motion_data->x[1]);
+    EXPECT_EQ(memcmp(entry.snapshot.adc.data, state.adc_data->data, sizeof(ADCData)), 0);
+    EXPECT_EQ(entry.snapshot.can.torque_val, state.can_data->torque_val);
+    EXPECT_EQ(entry.snapshot.state, state.state);
+    snapshots++;
+  }
+  EXPECT_EQ(previous, (int64_t) total - 1);  // The newest are kept
+  EXPECT_GT(snapshots, (uint32_t) 1000);
+  EXPECT_LT(snapshots, total);  // The oldest were overwritten
+  EXPECT_GE(commands, snapshots / 7 - 1);
+  EXPECT_EQ(reader.corrupt, (uint64_t) 0);
+  remove(path.c_str());
+}
+
+// A whole run (acceleration, coast, braking) recorded at the logic loop's 1 kHz fits in the default file
+TEST_F(PodTest, FlightRecorderRealLong) {
+  std::string path = "/tmp/flight_recorder_flight.rec";
+  ASSERT_TRUE(pod->recorder.open(path, 16 * 1024 * 1024));
+  int64_t start = Utils::microseconds();
+  ConfiguratorManager::config.openConfigFile("tests/realFlightPlan.txt", true);
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  MoveState(Command::Network_Command_ID::TRANS_FUNCTIONAL_TEST_OUTSIDE, E_States::ST_FUNCTIONAL_TEST_OUTSIDE, true);
+  MoveState(Command::Network_Command_ID::TRANS_LOADING, E_States::ST_LOADING, true);
+  MoveState(Command::Network_Command_ID::TRANS_FUNCTIONAL_TEST_INSIDE, E_States::ST_FUNCTIONAL_TEST_INSIDE, true);
+  MoveState(Command::Network_Command_ID::TRANS_LAUNCH_READY, E_States::ST_LAUNCH_READY, true);
+  MoveState(Command::Network_Command_ID::TRANS_FLIGHT_ACCEL, E_States::ST_FLIGHT_ACCEL, true);
+  pod->processing_command.reset();
+  pod->state_machine->auto_transition_safe_mode.wait();
+  pod->processing_command.wait();
+  usleep(100000);
+  pod->recorder.close();
+  int64_t elapsed = Utils::microseconds() - start;
+  EXPECT_EQ(pod->recorder.dropped.load(), (uint64_t) 0);
+  EXPECT_LE(pod->recorder.blocks.load(), (uint64_t) pod->recorder.block_count());  // Nothing overwritten
+
+  FlightRecordReader reader;
+  ASSERT_TRUE(reader.open(path));
+  FlightRecordReader::Entry entry;
+  uint64_t snapshots = 0;
+  int64_t first = -1;
+  int64_t last = 0;
+  bool accel_command = false;
+  std::vector<E_States> states;
+  while (reader.next(&entry)) {
+    if (entry.kind == FLIGHT_RECORD_COMMAND) {
+      accel_command |= entry.command.id == Command::TRANS_FLIGHT_ACCEL;
+      continue;
+    }
+    if (states.empty() || states.back() != entry.snapshot.state) {
+      states.push_back(entry.snapshot.state);
+    }
+    first = first < 0 ? entry.timestamp : first;
+    last = entry.timestamp;
+    snapshots++;
+  }
+  EXPECT_TRUE(accel_command);
+  EXPECT_EQ(snapshots, pod->recorder.snapshots.load());
+  std::vector<E_States> flight = {ST_FLIGHT_ACCEL, ST_FLIGHT_COAST, ST_FLIGHT_BRAKE, ST_SAFE_MODE};
+  EXPECT_TRUE(std::search(states.begin(), states.end(), flight.begin(), flight.end()) != states.end());
+  double seconds = (double) (last - first) / 1000000.0;
+  EXPECT_GT(seconds, (double) elapsed / 1000000.0 - 1);
+  EXPECT_GT((double) snapshots / seconds, 900.0);  // Every iteration
+
+  // Room for at least a 15 s run at this rate
+  double bytes_per_second = (double) pod->recorder.bytes.load() / seconds;
+  double capacity = (double) (pod->recorder.block_count() * FLIGHT_RECORDER_BLOCK_SIZE) / bytes_per_second;
+  print(LogLevel::LOG_INFO, "Recorded %lu snapshots over %.1f s, %.0f bytes/s, %.1f s fit in the file\n",
+        (unsigned long) snapshots, seconds, bytes_per_second, capacity);  // NOLINT
+  EXPECT_GT(capacity, 15.0);
+  remove(path.c_str());
+}
+#endif
@@ -0,0 +1,132 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "HistoryRing.hpp"
+#include "ScenarioRealLong.h"
+#include <atomic>
+#include <thread> // NOLINT
+#include <vector>
+
+using std::make_shared;
+
+namespace {
+Sample<ADCData> make_sample(uint32_t sequence) {
+  Sample<ADCData> sample;
+  memset(&sample, 0, sizeof(sample));
+  sample.header.sequence = sequence;
+  sample.header.timestamp = sequence * 1000;
+  for (int i = 0; i < NUM_ADC; i++) {
+    sample.data.data[i] = (int32_t) sequence;
+  }
+  return sample;
+}
+
+int32_t first_channel(const ADCData & data) {
+  return data.data[0];
+}
+}  // namespace
+
+TEST(HistoryRingTest, LastAndSince) {
+  HistoryRing<ADCData, 8> ring;
+  Sample<ADCData> out[8];
+  EXPECT_EQ(ring.last(4, out), (size_t) 0);
+
+  for (uint32_t i = 1; i <= 5; i++) {
+    ring.push(make_sample(i));
+  }
+  ASSERT_EQ(ring.last(3, out), (size_t) 3);
+  EXPECT_EQ(out[0].header.sequence, (uint32_t) 3);  // Oldest first
+  EXPECT_EQ(out[2].header.sequence, (uint32_t) 5);
+
+  // Ask for more than there is
+  EXPECT_EQ(ring.last(8, out), (size_t) 5);
+
+  // Strictly after the timestamp
+  ASSERT_EQ(ring.since(3000, out, 8), (size_t) 2);
+  EXPECT_EQ(out[0].header.sequence, (uint32_t) 4);
+  EXPECT_EQ(out[1].header.sequence, (uint32_t) 5);
+}
+
+TEST(HistoryRingTest, Wraps) {
+  HistoryRing<ADCData, 8> ring;
+  Sample<ADCData> out[8];
+  for (uint32_t i = 1; i <= 21; i++) {
+    ring.push(make_sample(i));
+  }
+  EXPECT_EQ(ring.size(), (uint64_t) 21);
+  ASSERT_EQ(ring.last(100, out), (size_t) 8);  // Only the last 8 are kept
+  for (uint32_t i = 0; i < 8; i++) {
+    EXPECT_EQ(out[i].header.sequence, 14 + i);
+    EXPECT_EQ(out[i].data.data[3], (int32_t) (14 + i));
+  }
+}
+
+TEST(HistoryRingTest, Stats) {
+  HistoryRing<ADCData, 8> ring;
+  WindowStats empty = ring.stats(8, 0, first_channel);
+  EXPECT_EQ(empty.count, (size_t) 0);
+
+  for (uint32_t i = 1; i <= 10; i++) {
+    ring.push(make_sample(i));
+  }
+  // Last 4: 7, 8, 9, 10
+  WindowStats s = ring.stats(4, 0, first_channel);
+  EXPECT_EQ(s.count, (size_t) 4);
+  EXPECT_DOUBLE_EQ(s.mean, 8.5);
+  EXPECT_DOUBLE_EQ(s.min, 7);
+  EXPECT_DOUBLE_EQ(s.max, 10);
+  EXPECT_DOUBLE_EQ(s.variance, 1.25);
+
+  // Everything after t = 8000: 9, 10
+  s = ring.stats(8, 8000, first_channel);
+  EXPECT_EQ(s.count, (size_t) 2);
+  EXPECT_DOUBLE_EQ(s.mean, 9.5);
+}
+
+// Readers racing a writer must only ever see a run of consecutive, untorn samples
+TEST(HistoryRingTest, ConcurrentReaders) {
+  HistoryRing<ADCData, 16> ring;
+  std::atomic<bool> done(false);
+  std::atomic<int> bad(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; r++) {
+    readers.push_back(std::thread([&] {
+      Sample<ADCData> out[16];
+      while (!done.load()) {
+        size_t n = ring.last(16, out);
+        for (size_t i = 0; i < n; i++) {
+          if (out[i].data.data[0] != out[i].data.data[NUM_ADC - 1] ||
+              out[i].data.data[0] != (int32_t) out[i].header.sequence ||
+              (i > 0 && out[i].header.sequence != out[i - 1].header.sequence + 1)) {
+            bad++;
+          }
+        }
+      }
+    }));
+  }
+  for (uint32_t i = 1; i <= 20000; i++) {
+    ring.push(make_sample(i));
+  }
+  done.store(true);
+  for (auto & t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(bad.load(), 0);
+}
+
+// The SourceManagers keep their published samples in history
+TEST_F(PodTest, SourceManagerHistory) {
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  usleep(300000);
+
+  Sample<PRUData> out[3];
+  ASSERT_EQ(SourceManager::PRU.history.last(3, out), (size_t) 3);
+  EXPECT_EQ(out[1].header.sequence, out[0].header.sequence + 1);
+  EXPECT_EQ(out[2].header.sequence, out[1].header.sequence + 1);
+
+  PRUData latest;
+  SampleHeader header;
+  SourceManager::PRU.Get(&latest, &header);
+  EXPECT_GE(header.sequence, out[2].header.sequence);
+}
+#endif
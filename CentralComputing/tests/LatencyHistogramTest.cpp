@@ -0,0 +1,76 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+#include "ScenarioRealLong.h"
+#include <thread> // NOLINT
+#include <vector>
+
+using std::make_shared;
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram h;
+  EXPECT_EQ(h.count(), (uint64_t) 0);
+  EXPECT_EQ(h.percentile(99.0), 0);
+
+  // 1..10000 ns, uniform
+  for (int64_t i = 1; i <= 10000; i++) {
+    h.record(i);
+  }
+  EXPECT_EQ(h.count(), (uint64_t) 10000);
+  EXPECT_EQ(h.max(), 10000);
+  EXPECT_EQ(h.mean(), 5000);
+  // Log-linear buckets, 16 per power of two: within ~6%
+  EXPECT_NEAR(h.percentile(50.0), 5000, 5000 * 0.07);
+  EXPECT_NEAR(h.percentile(99.0), 9900, 9900 * 0.07);
+  EXPECT_EQ(h.percentile(100.0), 10000);
+
+  // Small values are exact
+  LatencyHistogram small;
+  small.record(3);
+  small.record(7);
+  EXPECT_EQ(small.percentile(50.0), 3);
+  EXPECT_EQ(small.percentile(100.0), 7);
+
+  h.reset();
+  EXPECT_EQ(h.count(), (uint64_t) 0);
+  EXPECT_EQ(h.max(), 0);
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecord) {
+  LatencyHistogram h;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&h, t] {
+      for (int i = 0; i < 10000; i++) {
+        h.record(1000 * (t + 1));
+      }
+    }));
+  }
+  for (auto & t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(h.count(), (uint64_t) 40000);
+  EXPECT_EQ(h.max(), 4000);
+}
+
+// Every stage gets timed while the pod runs, and can be looked up by name
+TEST_F(PodTest, PipelineLatencyRecorded) {
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  usleep(300000);
+
+  const char * names[] = {"adc_refresh", "can_refresh", "i2c_refresh", "pru_refresh",
+                          "adc_error_check", "pru_error_check", "can_sample_age", "pru_sample_age",
+                          "update_unified_state", "motion_model", "steady_function"};
+  for (const char * name : names) {
+    LatencyHistogram * h = Metrics::find(name);
+    ASSERT_TRUE(h != nullptr) << name;
+    EXPECT_GT(h->count(), (uint64_t) 0) << name;
+  }
+  EXPECT_TRUE(Metrics::find("not_a_stage") == nullptr);
+
+  // A sample can't be older than a couple of refresh periods (100ms by default)
+  EXPECT_LT(Metrics::find("pru_sample_age")->max(), 250 * 1000 * 1000);
+}
+#endif
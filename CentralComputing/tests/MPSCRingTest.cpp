@@ -0,0 +1,189 @@
+#ifdef SIM // Only compile if building test executable
+#include "Command.h"
+#include "MPSCRing.hpp"
+#include "SafeQueue.hpp"
+#include "LatencyHistogram.h"
+#include <atomic>
+#include <thread> // NOLINT
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace {
+const int PRODUCERS = 6;  // Roughly the number of threads that call Command::put()
+const int PER_PRODUCER = 50000;
+
+// Producer p sends (p << 32) | 0, 1, 2, ... so the consumer can check per producer ordering
+uint64_t tag(int producer, uint32_t i) {
+  return (((uint64_t) producer) << 32) | i;
+}
+
+// SafeQueue never fills up
+bool try_enqueue(MPSCRing<uint64_t, 256> * ring, uint64_t value) {
+  return ring->enqueue(value);
+}
+bool try_enqueue(SafeQueue<uint64_t> * queue, uint64_t value) {
+  queue->enqueue(value);
+  return true;
+}
+
+// Every producer hammers the queue at once while one consumer drains it. Records the latency of each enqueue call.
+// A full ring is retried after a yield (so nothing is lost), each attempt is timed on its own
+template <class Queue>
+void contend(Queue * queue, LatencyHistogram * latency, std::atomic<int> * out_of_order) {
+  std::atomic<bool> go(false);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; p++) {
+    producers.push_back(std::thread([&, p] {
+      while (!go.load()) {}
+      for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+        while (true) {
+          int64_t start = LatencyHistogram::now();
+          bool queued = try_enqueue(queue, tag(p, i));
+          latency->record(LatencyHistogram::now() - start);
+          if (queued) {
+            break;
+          }
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+
+  uint32_t next[PRODUCERS] = {0};
+  int received = 0;
+  go.store(true);
+  uint64_t value;
+  while (received < PRODUCERS * PER_PRODUCER) {
+    if (queue->dequeue(&value)) {
+      int p = (int) (value >> 32);
+      if (p >= PRODUCERS || (uint32_t) value != next[p]) {
+        (*out_of_order)++;
+      } else {
+        next[p]++;
+      }
+      received++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (auto & t : producers) {
+    t.join();
+  }
+}
+}  // namespace
+
+TEST(MPSCRingTest, FillAndDrain) {
+  MPSCRing<uint64_t, 4> ring;
+  uint64_t value;
+  EXPECT_FALSE(ring.dequeue(&value));
+  for (uint64_t i = 0; i < 4; i++) {
+    EXPECT_TRUE(ring.enqueue(i));
+  }
+  EXPECT_EQ(ring.size(), 4);
+  ASSERT_TRUE(ring.front(&value));
+  EXPECT_EQ(value, (uint64_t) 0);
+  EXPECT_EQ(ring.size(), 4);
+
+  // Full: the new value is dropped, not the old ones
+  EXPECT_FALSE(ring.enqueue(100));
+  EXPECT_FALSE(ring.enqueue(101));
+  EXPECT_EQ(ring.overflows(), (uint64_t) 2);
+  EXPECT_EQ(ring.high_water(), 4);
+
+  for (uint64_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.dequeue(&value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(ring.dequeue(&value));
+  EXPECT_EQ(ring.size(), 0);
+
+  // Works across laps
+  for (uint64_t i = 0; i < 10; i++) {
+    EXPECT_TRUE(ring.enqueue(i));
+    ASSERT_TRUE(ring.dequeue(&value));
+    EXPECT_EQ(value, i);
+  }
+  ring.reset_counters();
+  EXPECT_EQ(ring.overflows(), (uint64_t) 0);
+  EXPECT_EQ(ring.high_water(), 0);
+}
+
+// Producers that never retry: everything is either received or counted as an overflow
+TEST(MPSCRingTest, OverflowAccounting) {
+  MPSCRing<uint64_t, 64> ring;
+  std::atomic<int> accepted(0);
+  std::atomic<bool> done(false);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; p++) {
+    producers.push_back(std::thread([&, p] {
+      for (uint32_t i = 0; i < 20000; i++) {
+        if (ring.enqueue(tag(p, i))) {
+          accepted++;
+        }
+      }
+    }));
+  }
+  std::thread closer([&] {
+    for (auto & t : producers) {
+      t.join();
+    }
+    done.store(true);
+  });
+
+  int received = 0;
+  uint64_t value;
+  while (!done.load() || ring.size() > 0) {
+    if (ring.dequeue(&value)) {
+      received++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  closer.join();
+  EXPECT_EQ(received, accepted.load());
+  EXPECT_EQ((uint64_t) received + ring.overflows(), (uint64_t) PRODUCERS * 20000);
+  EXPECT_LE(ring.high_water(), 64);
+}
+
+// Nothing lost or duplicated, and each producer's commands come out in the order it put them
+TEST(MPSCRingTest, ContentionStress) {
+  MPSCRing<uint64_t, 256> ring;
+  LatencyHistogram ring_latency;
+  std::atomic<int> out_of_order(0);
+  contend(&ring, &ring_latency, &out_of_order);
+  EXPECT_EQ(out_of_order.load(), 0);
+  EXPECT_EQ(ring.size(), 0);
+  ring_latency.print("mpsc_ring_enqueue");
+
+  // The mutex queue it replaced, for comparison
+  SafeQueue<uint64_t> queue;
+  LatencyHistogram queue_latency;
+  out_of_order.store(0);
+  contend(&queue, &queue_latency, &out_of_order);
+  EXPECT_EQ(out_of_order.load(), 0);
+  queue_latency.print("safe_queue_enqueue");
+}
+
+// No Pod running here, so nothing drains the command queue
+TEST(MPSCRingTest, CommandQueueOverflow) {
+  Command::flush();
+  Command::reset_queue_counters();
+  int queued = 0;
+  for (int i = 0; i < COMMAND_QUEUE_SIZE + 10; i++) {
+    if (Command::put(Command::SET_OTHER_ERROR, OTHERErrors::GPIO_SWITCH_ERROR)) {
+      queued++;
+    }
+  }
+  EXPECT_EQ(queued, COMMAND_QUEUE_SIZE);
+  EXPECT_EQ(Command::command_queue[Command::PRIORITY_ERROR].overflows(), (uint64_t) 10);
+  EXPECT_EQ(Command::command_queue[Command::PRIORITY_ERROR].high_water(), COMMAND_QUEUE_SIZE);
+  EXPECT_EQ(Command::command_queue[Command::PRIORITY_NORMAL].overflows(), (uint64_t) 0);
+
+  // The oldest commands are kept
+  Command::Network_Command com;
+  ASSERT_TRUE(Command::get(&com));
+  EXPECT_EQ(com.id, (uint32_t) Command::SET_OTHER_ERROR);
+  Command::flush();
+  EXPECT_EQ(Command::size(), 0);
+}
+#endif
@@ -0,0 +1,57 @@
+#ifdef SIM // Only compile if building test executable
+#include "Notifier.h"
+#include "LatencyHistogram.h"
+#include "Utils.h"
+#include <atomic>
+#include <thread> // NOLINT
+#include "gtest/gtest.h"
+
+using Utils::print;
+using Utils::LogLevel;
+
+TEST(NotifierTest, PendingNotificationNotLost) {
+  Notifier n;
+  n.notify();
+  n.notify();  // Collapses into the first one
+  EXPECT_TRUE(n.wait_until(LatencyHistogram::now() + 1000000000));
+  EXPECT_FALSE(n.wait_until(LatencyHistogram::now() + 1000000));
+  EXPECT_EQ(n.notified_wakeups(), (uint64_t) 1);
+  EXPECT_EQ(n.timeouts(), (uint64_t) 1);
+}
+
+TEST(NotifierTest, TimesOutAtDeadline) {
+  Notifier n;
+  int64_t start = LatencyHistogram::now();
+  EXPECT_FALSE(n.wait_until(start + 20000000));  // 20 ms
+  int64_t elapsed = LatencyHistogram::now() - start;
+  EXPECT_GE(elapsed, 20000000);
+  EXPECT_LT(elapsed, 200000000);
+
+  // A deadline in the past returns right away
+  EXPECT_FALSE(n.wait_until(start));
+}
+
+// Wake latency from notify() in one thread to the waiter running
+TEST(NotifierTest, WakesWaiter) {
+  Notifier n;
+  std::atomic<int64_t> notified_at(0);
+  LatencyHistogram latency;
+  std::atomic<bool> waiting(false);
+  for (int i = 0; i < 200; i++) {
+    std::thread notifier([&] {
+      while (!waiting.load()) {}
+      usleep(200);  // Let the waiter get into the futex
+      notified_at.store(LatencyHistogram::now());
+      n.notify();
+    });
+    waiting.store(true);
+    EXPECT_TRUE(n.wait_until(LatencyHistogram::now() + 1000000000));
+    latency.record(LatencyHistogram::now() - notified_at.load());
+    notifier.join();
+    waiting.store(false);
+  }
+  latency.print("notifier_wake");
+  EXPECT_EQ(latency.count(), (uint64_t) 200);
+  EXPECT_EQ(n.timeouts(), (uint64_t) 0);
+}
+#endif
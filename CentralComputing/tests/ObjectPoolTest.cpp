@@ -0,0 +1,79 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "ObjectPool.hpp"
+#include "AllocationCounter.h"
+#include "ScenarioRealLong.h"
+#include <vector>
+
+using std::make_shared;
+
+struct PoolTestData {
+  int32_t values[8];
+};
+
+// Released objects go back into the pool, so steady state make/release never reaches the heap
+TEST(ObjectPoolTest, Recycles) {
+  ObjectPool<PoolTestData, 4> & pool = ObjectPool<PoolTestData, 4>::instance();
+  uint64_t misses = pool.misses();
+  uint64_t allocations = AllocationCounter::thread_allocations();
+  for (int i = 0; i < 100; i++) {
+    std::shared_ptr<PoolTestData> d = pool.make();
+    EXPECT_EQ(d->values[3], 0);
+    d->values[3] = i;
+    EXPECT_EQ(pool.in_use(), 1);
+  }
+  EXPECT_EQ(pool.in_use(), 0);
+  EXPECT_EQ(pool.misses(), misses);
+  if (AllocationCounter::enabled()) {
+    EXPECT_EQ(AllocationCounter::thread_allocations(), allocations);
+  }
+}
+
+// Once every slot is handed out, the pool falls back to the heap and counts it
+TEST(ObjectPoolTest, FallsBackWhenExhausted) {
+  ObjectPool<PoolTestData, 4> & pool = ObjectPool<PoolTestData, 4>::instance();
+  uint64_t misses = pool.misses();
+  std::vector<std::shared_ptr<PoolTestData>> held;
+  held.reserve(6);
+  for (int i = 0; i < 6; i++) {
+    PoolTestData value;
+    value.values[0] = i;
+    held.push_back(pool.make(value));
+  }
+  EXPECT_EQ(pool.in_use(), 4);
+  EXPECT_EQ(pool.misses(), misses + 2);
+  for (size_t i = 0; i < held.size(); i++) {
+    EXPECT_EQ(held[i]->values[0], (int32_t) i);
+  }
+  held.clear();
+  EXPECT_EQ(pool.in_use(), 0);
+}
+
+TEST(ObjectPoolTest, CounterSeesAllocations) {
+  if (!AllocationCounter::enabled()) {
+    return;
+  }
+  uint64_t allocations = AllocationCounter::thread_allocations();
+  std::shared_ptr<PoolTestData> d = make_shared<PoolTestData>();
+  EXPECT_EQ(AllocationCounter::thread_allocations(), allocations + 1);
+}
+
+// Run the sensor pipeline against a real scenario, and make sure none of the
+// SourceManager refresh loops allocated anything once they were running
+TEST_F(PodTest, SensorPipelineAllocationFree) {
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  usleep(300000);
+
+  if (AllocationCounter::enabled()) {
+    EXPECT_EQ(SourceManager::ADC.steady_state_allocations(), (uint64_t) 0);
+    EXPECT_EQ(SourceManager::CAN.steady_state_allocations(), (uint64_t) 0);
+    EXPECT_EQ(SourceManager::I2C.steady_state_allocations(), (uint64_t) 0);
+    EXPECT_EQ(SourceManager::PRU.steady_state_allocations(), (uint64_t) 0);
+  }
+  EXPECT_EQ(ObjectPool<ADCData>::instance().misses(), (uint64_t) 0);
+  EXPECT_EQ(ObjectPool<CANData>::instance().misses(), (uint64_t) 0);
+  EXPECT_EQ(ObjectPool<I2CData>::instance().misses(), (uint64_t) 0);
+  EXPECT_EQ(ObjectPool<PRUData>::instance().misses(), (uint64_t) 0);
+}
+#endif
@@ -0,0 +1,58 @@
+#ifdef SIM // Only compile if building test executable
+#include "PeriodicTimer.h"
+#include "Event.h"
+#include "Utils.h"
+#include <unistd.h>
+#include <thread> // NOLINT
+#include "gtest/gtest.h"
+
+// Work done in the loop body must not stretch the period
+TEST(PeriodicTimerTest, NoDrift) {
+  const int64_t period = 5000;
+  const int iterations = 40;
+  PeriodicTimer timer;
+  int64_t start = PeriodicTimer::monotonic_nanos();
+  timer.start(period);
+  for (int i = 0; i < iterations; i++) {
+    usleep(2000);  // "work", less than a period
+    timer.wait();
+  }
+  int64_t elapsed = (PeriodicTimer::monotonic_nanos() - start) / 1000;
+
+  // With wait_for(period) this would take iterations * (period + 2000)
+  EXPECT_GE(elapsed, iterations * period);
+  EXPECT_LT(elapsed, iterations * period + 2000 * iterations / 2);
+  EXPECT_EQ(timer.ticks(), (uint64_t) iterations);
+}
+
+// A long iteration counts the missed deadlines and doesn't burst to catch up
+TEST(PeriodicTimerTest, Overrun) {
+  PeriodicTimer timer;
+  timer.start(2000);
+  timer.wait();
+  EXPECT_EQ(timer.overruns(), (uint64_t) 0);
+
+  usleep(11000);  // Misses 5 deadlines
+  int64_t before = PeriodicTimer::monotonic_nanos();
+  timer.wait();
+  EXPECT_GE(timer.overruns(), (uint64_t) 5);
+  // Slept until the next future deadline instead of returning right away
+  EXPECT_GT(PeriodicTimer::monotonic_nanos() - before, 0);
+  EXPECT_LE(timer.remaining(), 2000);
+}
+
+// Shutdown (the event) wakes the loop right away
+TEST(PeriodicTimerTest, WakesOnEvent) {
+  Event closing;
+  PeriodicTimer timer;
+  timer.start(10000000);  // 10 seconds
+  std::thread t([&] {
+    usleep(10000);
+    closing.invoke();
+  });
+  int64_t start = PeriodicTimer::monotonic_nanos();
+  timer.wait(&closing);
+  EXPECT_LT((PeriodicTimer::monotonic_nanos() - start) / 1000, 1000000);
+  t.join();
+}
+#endif
@@ -0,0 +1,65 @@
+#ifdef SIM // Only compile if building test executable
+#include "Poller.h"
+#include "Utils.h"
+#include <unistd.h>
+#include <thread> // NOLINT
+#include "gtest/gtest.h"
+
+using Utils::microseconds;
+
+TEST(PollerTest, TimeoutReadyAndWake) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  Poller poller;
+  ASSERT_TRUE(poller.open());
+  ASSERT_TRUE(poller.add(fds[0]));
+
+  // Nothing to read
+  int64_t start = microseconds();
+  EXPECT_EQ(poller.wait(20000), 0);
+  EXPECT_GE(microseconds() - start, 15000);
+
+  // Data available
+  char c = 'x';
+  ASSERT_EQ(write(fds[1], &c, 1), 1);
+  EXPECT_EQ(poller.wait(1000000), 1);
+  ASSERT_EQ(read(fds[0], &c, 1), 1);
+
+  // Woken by another thread, long before the timeout
+  start = microseconds();
+  std::thread waker([&] {
+    usleep(10000);
+    poller.wake();
+  });
+  EXPECT_EQ(poller.wait(5000000), Poller::WOKEN);
+  EXPECT_LT(microseconds() - start, 1000000);
+  waker.join();
+
+  // The wakeup was consumed
+  EXPECT_EQ(poller.wait(1000), 0);
+
+  poller.close();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// A watched fd that hangs up is reported once and dropped, instead of waking every wait() from then on
+TEST(PollerTest, HangupReportedOnce) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  Poller poller;
+  ASSERT_TRUE(poller.open());
+  ASSERT_TRUE(poller.add(fds[0]));
+
+  close(fds[1]);  // The read end sees EPOLLHUP from now on
+  EXPECT_EQ(poller.wait(1000000), Poller::HANGUP);
+  EXPECT_EQ(poller.hung_up_fd(), fds[0]);
+
+  int64_t start = microseconds();
+  EXPECT_EQ(poller.wait(20000), Poller::TIMEOUT);
+  EXPECT_GE(microseconds() - start, 15000);
+
+  poller.close();
+  close(fds[0]);
+}
+#endif
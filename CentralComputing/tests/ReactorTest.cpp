@@ -0,0 +1,199 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "Reactor.h"
+#include "PeriodicTimer.h"
+#include "ScenarioRealLong.h"
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+using std::make_shared;
+
+namespace {
+// Appends its id to a shared log every time it runs
+class LogHandler : public ReactorHandler {
+ public:
+  LogHandler(int handler_id, std::vector<int> * run_log, int readable_fd = -1)
+    : id(handler_id), log(run_log), fd(readable_fd), runs(0) {}
+
+  std::string handler_name() {
+    return "test_" + std::to_string(id);
+  }
+
+  int handler_fd() {
+    return fd;
+  }
+
+  void on_readable() {
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) < 0) {}
+    log->push_back(-id);
+    runs++;
+  }
+
+  void on_deadline() {
+    log->push_back(id);
+    deadline = 0;
+    runs++;
+  }
+
+  int id;
+  std::vector<int> * log;
+  int fd;
+  std::atomic<int> runs;
+};
+}  // namespace
+
+// Expired deadlines run in the order the handlers were added, regardless of which expired first
+TEST(ReactorTest, DeadlineOrder) {
+  std::vector<int> log;
+  LogHandler first(1, &log);
+  LogHandler second(2, &log);
+  int64_t now = LatencyHistogram::now();
+  first.deadline = now + 20000000;   // 20 ms
+  second.deadline = now + 10000000;  // 10 ms, expires first
+
+  Reactor reactor;
+  // Added before start, both are picked up in the same iteration once their deadlines have passed
+  ASSERT_TRUE(reactor.add(&first));
+  ASSERT_TRUE(reactor.add(&second));
+  ASSERT_TRUE(reactor.start());
+  usleep(50000);
+  reactor.stop();
+
+  ASSERT_EQ(log.size(), (size_t) 2);
+  EXPECT_EQ(log[0], 2);  // Ran alone, at its own deadline
+  EXPECT_EQ(log[1], 1);
+  EXPECT_EQ(reactor.lateness(&second)->count(), (uint64_t) 1);
+  EXPECT_LT(reactor.lateness(&second)->max(), 5000000);  // Serviced within 5 ms
+}
+
+TEST(ReactorTest, ReadableFd) {
+  std::vector<int> log;
+  int fd = eventfd(0, EFD_NONBLOCK);
+  ASSERT_GE(fd, 0);
+  LogHandler handler(3, &log, fd);
+
+  Reactor reactor;
+  ASSERT_TRUE(reactor.start());
+  ASSERT_TRUE(reactor.add(&handler));  // Added while running
+  usleep(10000);
+  uint64_t value = 1;
+  EXPECT_EQ(write(fd, &value, sizeof(value)), (ssize_t) sizeof(value));
+  for (int i = 0; i < 100 && handler.runs.load() == 0; i++) {
+    usleep(1000);
+  }
+  reactor.stop();
+  close(fd);
+
+  ASSERT_EQ(log.size(), (size_t) 1);
+  EXPECT_EQ(log[0], -3);
+}
+
+namespace {
+struct JitterResult {
+  int64_t logic_max;         // us
+  int64_t logic_mean;        // us
+  int64_t source_max;        // us, worst over the four managers
+  int64_t context_switches;  // whole process, while measuring
+};
+
+int64_t context_switches() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Stand in for the logic loop: 1 kHz, reading every manager's latest sample
+JitterResult measure_jitter(int64_t duration) {
+  ADCData adc;
+  CANData can;
+  I2CData i2c;
+  PRUData pru;
+  PeriodicTimer timer;
+  JitterResult result;
+  int64_t switches = context_switches();
+  timer.start(1000);
+  for (int64_t i = 0; i < duration / 1000; i++) {
+    timer.wait();
+    SourceManager::ADC.Get(&adc);
+    SourceManager::CAN.Get(&can);
+    SourceManager::I2C.Get(&i2c);
+    SourceManager::PRU.Get(&pru);
+  }
+  result.context_switches = context_switches() - switches;
+  result.logic_max = timer.max_jitter();
+  result.logic_mean = timer.mean_jitter();
+  return result;
+}
+
+void stop_sources() {
+  SourceManager::PRU.stop();
+  SourceManager::CAN.stop();
+  SourceManager::ADC.stop();
+  SourceManager::I2C.stop();
+}
+
+void start_sources(Reactor * reactor) {
+  SourceManager::PRU.initialize(reactor);
+  SourceManager::CAN.initialize(reactor);
+  SourceManager::ADC.initialize(reactor);
+  SourceManager::I2C.initialize(reactor);
+}
+}  // namespace
+
+// Jitter benchmark
+// Runs the pod's sources with a thread each (the default), then hosted by one reactor, and measures
+// the jitter of a 1 kHz loop reading them alongside the pod's own logic loop.
+// Prints the numbers. Only fails if either mode stopped refreshing.
+TEST_F(PodTest, ReactorJitterBenchmark) {
+  const int64_t duration = 1000000;
+  if (pod->reactor.is_running()) {
+    return;  // Already in reactor mode (reactor_mode 1), the sources can't be moved between modes
+  }
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  usleep(100000);
+
+  // Threaded
+  SampleHeader before;
+  SampleHeader after;
+  PRUData pru;
+  SourceManager::PRU.Get(&pru, &before);
+  JitterResult threaded = measure_jitter(duration);
+  threaded.source_max = std::max(std::max(SourceManager::ADC.refresh_timer().max_jitter(),
+                                          SourceManager::CAN.refresh_timer().max_jitter()),
+                                 std::max(SourceManager::I2C.refresh_timer().max_jitter(),
+                                          SourceManager::PRU.refresh_timer().max_jitter()));
+  SourceManager::PRU.Get(&pru, &after);
+  EXPECT_GT(after.sequence, before.sequence);
+
+  // Reactor
+  stop_sources();
+  Reactor reactor;
+  ASSERT_TRUE(reactor.start());
+  start_sources(&reactor);
+  SourceManager::PRU.Get(&pru, &before);
+  JitterResult hosted = measure_jitter(duration);
+  hosted.source_max = 0;
+  ReactorHandler * handlers[] = {&SourceManager::ADC, &SourceManager::CAN, &SourceManager::I2C, &SourceManager::PRU};
+  for (ReactorHandler * handler : handlers) {
+    ASSERT_TRUE(reactor.lateness(handler) != nullptr);
+    hosted.source_max = std::max(hosted.source_max, reactor.lateness(handler)->max() / 1000);
+  }
+  SourceManager::PRU.Get(&pru, &after);
+  EXPECT_GT(after.sequence, before.sequence);
+  reactor.stop();
+  stop_sources();
+
+  // Back to threads, for TearDown
+  start_sources(nullptr);
+
+  print(LogLevel::LOG_INFO, "Reactor bench (1 kHz reader, %ld ms per mode)\n", (long) (duration / 1000));
+  print(LogLevel::LOG_INFO, "  threaded: reader jitter mean %ld us max %ld us, source max lateness %ld us, %ld context switches\n",
+        (long) threaded.logic_mean, (long) threaded.logic_max, (long) threaded.source_max, (long) threaded.context_switches);
+  print(LogLevel::LOG_INFO, "  reactor : reader jitter mean %ld us max %ld us, source max lateness %ld us, %ld context switches\n",
+        (long) hosted.logic_mean, (long) hosted.logic_max, (long) hosted.source_max, (long) hosted.context_switches);
+}
+#endif
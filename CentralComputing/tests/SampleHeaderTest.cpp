@@ -0,0 +1,53 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "LatencyHistogram.h"
+#include "ScenarioRealLong.h"
+
+using std::make_shared;
+
+// Every publish is stamped, and the sequence moves forward while a scenario is running
+TEST_F(PodTest, SamplesAreStamped) {
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  usleep(300000);
+
+  PRUData data;
+  SampleHeader first;
+  SampleHeader second;
+  SourceManager::PRU.Get(&data, &first);
+  usleep(300000);
+  SourceManager::PRU.Get(&data, &second);
+  int64_t now = LatencyHistogram::now();
+
+  EXPECT_GT(first.timestamp, 0);
+  EXPECT_GT(second.sequence, first.sequence);
+  EXPECT_GT(second.timestamp, first.timestamp);
+  EXPECT_LE(second.timestamp, now);
+
+  // The logic loop copies the headers into the unified state along with the data
+  TCPManager::data_mutex.lock();   // MUST USE LOCK TO AVOID TSAN ERRORS
+  EXPECT_GT(pod->unified_state.adc_header.sequence, (uint32_t) 0);
+  EXPECT_GT(pod->unified_state.can_header.sequence, (uint32_t) 0);
+  EXPECT_GT(pod->unified_state.i2c_header.sequence, (uint32_t) 0);
+  EXPECT_GT(pod->unified_state.pru_header.sequence, (uint32_t) 0);
+  EXPECT_EQ(pod->unified_state.errors->error_vector[3] & PRUErrors::PRU_STALE_DATA, (uint32_t) 0);
+  TCPManager::data_mutex.unlock();
+}
+
+TEST_F(PodTest, StaleSamplesDetected) {
+  int64_t stale_timeout = SourceManager::PRU.stale_timeout_config();
+  SampleHeader header;
+  header.sequence = 1;
+  int64_t now = LatencyHistogram::now();
+
+  // Never captured by the refresh loop, so it can't be stale
+  header.timestamp = 0;
+  EXPECT_FALSE(SourceManager::PRU.check_sample_age(header, now));
+
+  header.timestamp = now - 1000;
+  EXPECT_FALSE(SourceManager::PRU.check_sample_age(header, now));
+
+  header.timestamp = now - (stale_timeout + 1000) * 1000;
+  EXPECT_EQ(SourceManager::PRU.check_sample_age(header, now), stale_timeout > 0);
+}
+#endif
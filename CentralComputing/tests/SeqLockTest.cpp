@@ -0,0 +1,172 @@
+#ifdef SIM // Only compile if building test executable
+#include "SeqLock.hpp"
+#include "Utils.h"
+#include "Defines.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex> // NOLINT
+#include <thread> // NOLINT
+#include <vector>
+#include <algorithm>
+#include "gtest/gtest.h"
+
+using Utils::print;
+using Utils::LogLevel;
+using Utils::microseconds;
+
+// Every reader must see a value written by a single store, never a mix of two
+TEST(SeqLockTest, NoTornReads) {
+  SeqLock<CANData> lock;
+  CANData value;
+  memset(&value, 0, sizeof(value));
+  lock.store(value);
+
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; r++) {
+    readers.push_back(std::thread([&] {
+      CANData out;
+      while (!done.load()) {
+        lock.load(&out);
+        // Writer fills every field with the same value
+        if (out.status_word != out.adaptive_soc ||
+            out.status_word != out.internal_relay_state) {
+          torn++;
+        }
+      }
+    }));
+  }
+
+  for (uint32_t i = 1; i <= 50000; i++) {
+    uint32_t * words = reinterpret_cast<uint32_t *>(&value);
+    for (size_t w = 0; w < sizeof(CANData) / sizeof(uint32_t); w++) {
+      words[w] = i;
+    }
+    lock.store(value);
+  }
+  done.store(true);
+  for (auto & t : readers) {
+    t.join();
+  }
+
+  EXPECT_EQ(torn.load(), 0);
+  EXPECT_EQ(lock.sequence(), (uint32_t) 50001);
+}
+
+TEST(SeqLockTest, LoadReturnsLatest) {
+  SeqLock<ADCData> lock;
+  ADCData in;
+  ADCData out;
+  memset(&in, 0, sizeof(in));
+  EXPECT_EQ(lock.sequence(), (uint32_t) 0);
+
+  in.data[3] = 42;
+  lock.store(in);
+  EXPECT_EQ(lock.load(&out), (uint32_t) 1);
+  EXPECT_EQ(out.data[3], 42);
+
+  in.data[3] = -7;
+  lock.store(in);
+  EXPECT_EQ(lock.load(&out), (uint32_t) 2);
+  EXPECT_EQ(out.data[3], -7);
+}
+
+// Contention benchmark
+// Compares the old SourceManagerBase publication path (mutex guarding a shared_ptr swap)
+// to the seqlock, with one writer at the refresh rate of a fast manager and a reader in a tight loop.
+// Prints the time per read (the seqlock read includes copying the whole struct out,
+// the mutex read only copies a pointer) and the worst time the writer spent publishing. Only fails if the seqlock made no forward progress.
+namespace {
+struct MutexPublisher {
+  void store(const std::shared_ptr<CANData> & d) {
+    mutex.lock();
+    data = d;
+    mutex.unlock();
+  }
+  std::shared_ptr<CANData> load() {
+    mutex.lock();
+    std::shared_ptr<CANData> ret = data;
+    mutex.unlock();
+    return ret;
+  }
+  std::mutex mutex;
+  std::shared_ptr<CANData> data;
+};
+
+const int64_t BENCH_TIME = 200000;  // 200 ms per run
+const int64_t WRITE_PERIOD = 50;    // 20 kHz, well above any manager's refresh rate
+
+// Spin (not sleep) between writes, so the writer keeps the cache line hot like a busy refresh thread
+void wait_next_write(int64_t * next) {
+  while (microseconds() < *next) {}
+  *next += WRITE_PERIOD;
+}
+}  // namespace
+
+TEST(SeqLockTest, ContentionBenchmark) {
+  // Mutex + shared_ptr
+  MutexPublisher mp;
+  mp.store(std::make_shared<CANData>());
+  std::atomic<bool> done(false);
+  int64_t mutex_writes = 0;
+  int64_t mutex_reads = 0;
+  int64_t mutex_max_write = 0;
+  int64_t start = microseconds();
+  std::thread mwriter([&] {
+    int64_t next = start;
+    while (!done.load()) {
+      wait_next_write(&next);
+      std::shared_ptr<CANData> d = std::make_shared<CANData>();
+      int64_t t = microseconds();
+      mp.store(d);
+      mutex_max_write = std::max(mutex_max_write, microseconds() - t);
+      mutex_writes++;
+    }
+  });
+  while (microseconds() - start < BENCH_TIME) {
+    std::shared_ptr<CANData> d = mp.load();
+    mutex_reads++;
+  }
+  done.store(true);
+  mwriter.join();
+  int64_t mutex_time = microseconds() - start;
+
+  // Seqlock
+  SeqLock<CANData> lock;
+  CANData value;
+  memset(&value, 0, sizeof(value));
+  done.store(false);
+  int64_t seq_writes = 0;
+  int64_t seq_reads = 0;
+  int64_t seq_max_write = 0;
+  start = microseconds();
+  std::thread swriter([&] {
+    int64_t next = start;
+    while (!done.load()) {
+      wait_next_write(&next);
+      int64_t t = microseconds();
+      lock.store(value);
+      seq_max_write = std::max(seq_max_write, microseconds() - t);
+      seq_writes++;
+    }
+  });
+  CANData out;
+  while (microseconds() - start < BENCH_TIME) {
+    lock.load(&out);
+    seq_reads++;
+  }
+  done.store(true);
+  swriter.join();
+  int64_t seq_time = microseconds() - start;
+
+  print(LogLevel::LOG_INFO, "SeqLock bench (%d byte payload)\n", (int) sizeof(CANData));
+  print(LogLevel::LOG_INFO, "  mutex  : %8.1f ns/read, worst write %ld us (%ld writes)\n",
+        mutex_time * 1000.0 / (double) mutex_reads, (long) mutex_max_write, (long) mutex_writes);
+  print(LogLevel::LOG_INFO, "  seqlock: %8.1f ns/read, worst write %ld us (%ld writes)\n",
+        seq_time * 1000.0 / (double) seq_reads, (long) seq_max_write, (long) seq_writes);
+
+  EXPECT_GT(seq_reads, 0);
+  EXPECT_GT(seq_writes, 0);
+}
+#endif
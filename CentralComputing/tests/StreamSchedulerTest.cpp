@@ -0,0 +1,99 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "StreamScheduler.h"
+#include "TCPManager.h"
+#include <string>
+#include <vector>
+
+namespace {
+// Runs the scheduler the way the write loop does, jumping straight to each deadline, until end
+std::vector<std::pair<int64_t, size_t>> run_until(StreamScheduler * scheduler, int64_t end) {
+  std::vector<std::pair<int64_t, size_t>> runs;
+  size_t due[8];
+  for (int64_t now = scheduler->next_due(); now <= end; now = scheduler->next_due()) {
+    size_t count = scheduler->poll(now, due, 8);
+    for (size_t i = 0; i < count; i++) {
+      runs.push_back(std::make_pair(now, due[i]));
+    }
+  }
+  return runs;
+}
+}  // namespace
+
+TEST(StreamSchedulerTest, RatesAndPhases) {
+  StreamScheduler scheduler;
+  size_t fast = scheduler.add("fast", 100, 0, 1);
+  size_t slow = scheduler.add("slow", 300, 50, 1);
+  scheduler.start(1000);
+  EXPECT_EQ(scheduler.next_due(), 1000);
+
+  auto runs = run_until(&scheduler, 2000);
+  std::vector<int64_t> slow_times;
+  for (auto & run : runs) {
+    if (run.second == slow) {
+      slow_times.push_back(run.first);
+    }
+  }
+  EXPECT_EQ(scheduler.runs(fast), (uint64_t) 11);  // 1000, 1100 ... 2000
+  EXPECT_EQ(slow_times, (std::vector<int64_t> {1050, 1350, 1650, 1950}));
+  EXPECT_EQ(scheduler.missed(fast), (uint64_t) 0);
+  EXPECT_EQ(scheduler.next_due(), 2100);
+}
+
+TEST(StreamSchedulerTest, PriorityOrder) {
+  StreamScheduler scheduler;
+  size_t low = scheduler.add("low", 100, 0, 5);
+  size_t high = scheduler.add("high", 100, 0, 0);
+  size_t middle = scheduler.add("middle", 100, 0, 2);
+  EXPECT_EQ(scheduler.by_priority(), (std::vector<size_t> {high, middle, low}));
+
+  size_t due[3];
+  scheduler.start(0);
+  ASSERT_EQ(scheduler.poll(0, due, 3), (size_t) 3);
+  EXPECT_EQ(due[0], high);
+  EXPECT_EQ(due[1], middle);
+  EXPECT_EQ(due[2], low);
+
+  // Whatever doesn't fit stays due
+  ASSERT_EQ(scheduler.poll(100, due, 1), (size_t) 1);
+  EXPECT_EQ(due[0], high);
+  EXPECT_EQ(scheduler.next_due(), 100);
+
+  scheduler.set(low, 100, 0, -1);
+  EXPECT_EQ(scheduler.by_priority()[0], low);
+}
+
+TEST(StreamSchedulerTest, LateAndDisabled) {
+  StreamScheduler scheduler;
+  size_t stream = scheduler.add("stream", 100, 0, 0);
+  size_t off = scheduler.add("off", 0, 0, 0);
+  scheduler.start(0);
+  size_t due[2];
+  ASSERT_EQ(scheduler.poll(0, due, 2), (size_t) 1);
+
+  // A loop that wakes up 950us late runs the stream once, not 10 times in a row
+  ASSERT_EQ(scheduler.poll(1050, due, 2), (size_t) 1);
+  EXPECT_EQ(due[0], stream);
+  EXPECT_EQ(scheduler.missed(stream), (uint64_t) 9);  // 200 ... 1000
+  EXPECT_EQ(scheduler.next_due(), 1100);
+  EXPECT_EQ(scheduler.runs(off), (uint64_t) 0);
+
+  scheduler.set(stream, 0, 0, 0);
+  scheduler.start(2000);
+  EXPECT_EQ(scheduler.next_due(), StreamScheduler::NEVER);
+  EXPECT_EQ(scheduler.poll(1000000, due, 2), (size_t) 0);
+}
+
+// The write loop follows the configured rates: motion at 50Hz, BMS cells every 2s
+TEST_F(PodTest, TCPStreamRates) {
+  usleep(1000000);
+  uint64_t motion = TCPManager::scheduler.runs(TCPManager::STREAM_MOTION);
+  uint64_t bms = TCPManager::scheduler.runs(TCPManager::STREAM_BMS);
+  EXPECT_EQ(TCPManager::scheduler.period(TCPManager::STREAM_MOTION), 20000);
+  EXPECT_GE(motion, (uint64_t) 40);
+  EXPECT_LE(motion, (uint64_t) 52);
+  EXPECT_EQ(bms, (uint64_t) 1);
+  EXPECT_GE(TCPManager::write_batches.load(), (uint64_t) 40);
+  TCPManager::scheduler.print_stats("tcp_write_loop");
+}
+#endif
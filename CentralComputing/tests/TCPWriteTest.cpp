@@ -0,0 +1,241 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "TCPManager.h"
+#include "Telemetry.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <fstream>
+#include <thread> // NOLINT
+#include <map>
+#include <string>
+#include <vector>
+
+using std::make_shared;
+
+namespace {
+// Points the write path at one end of a socketpair that nobody reads yet, every stream due all the time
+struct SlowReader {
+  int fds[2];
+  UnifiedState state;
+  int saved_socketfd = TCPManager::socketfd;
+  UnifiedState * saved_state = TCPManager::unified_state;
+  int32_t saved_format = TCPManager::telemetry_format;
+  int64_t saved_stall = TCPManager::write_stall_timeout;
+
+  SlowReader() {
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    int buffer = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    state.motion_data = make_shared<MotionData>();
+    state.adc_data = make_shared<ADCData>();
+    state.can_data = make_shared<CANData>();
+    state.i2c_data = make_shared<I2CData>();
+    state.pru_data = make_shared<PRUData>();
+    state.errors = make_shared<Errors>();
+    memset(state.errors.get(), 0, sizeof(Errors));
+    state.state = ST_SAFE_MODE;
+
+    TCPManager::socketfd = fds[0];
+    TCPManager::unified_state = &state;
+    TCPManager::telemetry_format = TELEMETRY_FORMAT_RAW;
+    TCPManager::configure_streams();
+    for (size_t stream = 0; stream < TCPManager::STREAM_COUNT; stream++) {
+      TCPManager::scheduler.set(stream, 1, 0, TCPManager::scheduler.priority(stream));
+    }
+    TCPManager::scheduler.start(PeriodicTimer::monotonic_nanos() / 1000);
+    TCPManager::reset_write_stats();
+  }
+
+  ~SlowReader() {
+    TCPManager::socketfd = saved_socketfd;
+    TCPManager::unified_state = saved_state;
+    TCPManager::telemetry_format = saved_format;
+    TCPManager::write_stall_timeout = saved_stall;
+    TCPManager::configure_streams();
+    close(fds[0]);
+    close(fds[1]);
+  }
+};
+}  // namespace
+
+// A base station that stops reading costs snapshots, never the write loop's time, and no error or state change
+TEST(TCPWriteTest, SlowReaderNeverBlocks) {
+  SlowReader reader;
+  TCPManager::write_stall_timeout = 10000000;
+  for (uint32_t i = 0; i < 200; i++) {
+    reader.state.errors->error_vector[0] = i / 20;  // 10 changes
+    int64_t start = Utils::microseconds();
+    ASSERT_NE(TCPManager::write_data(), -1);
+    EXPECT_LT(Utils::microseconds() - start, 50000);
+  }
+  EXPECT_TRUE(TCPManager::output_pending());
+  EXPECT_GT(TCPManager::frames_dropped(), (uint64_t) 0);
+  EXPECT_LE(TCPManager::queue_depth(), (size_t) (6 + 2 * TCP_QUEUE_CAPACITY));
+  EXPECT_GT(TCPManager::queue_high_water(), (size_t) 8);  // More than one of each stream, errors queued up
+  TCPManager::print_write_stats();
+
+  // Start reading, everything that was queued goes out
+  std::vector<uint8_t> received;
+  std::thread drain([&] {
+    uint8_t buf[8192];
+    ssize_t n;
+    while ((n = read(reader.fds[1], buf, sizeof(buf))) > 0) {
+      received.insert(received.end(), buf, buf + n);
+    }
+  });
+  for (int i = 0; i < 1000 && (TCPManager::output_pending() || TCPManager::queue_depth() > 0); i++) {
+    ASSERT_NE(TCPManager::flush_data(), -1);
+    usleep(1000);
+  }
+  EXPECT_FALSE(TCPManager::output_pending());
+  EXPECT_EQ(TCPManager::queue_depth(), (size_t) 0);
+  shutdown(reader.fds[0], SHUT_WR);
+  drain.join();
+
+  // Every error value arrives, in order
+  std::map<uint8_t, size_t> sizes = {{4, sizeof(MotionData)}, {5, sizeof(Errors)}, {6, sizeof(E_States)},
+                                     {1, sizeof(CANData)}, {3, sizeof(PRUData)}, {2, sizeof(I2CData)},
+                                     {7, sizeof(ADCData)}, {9, sizeof(BMSCells)}};
+  std::vector<uint32_t> errors;
+  for (size_t at = 0; at < received.size();) {
+    ASSERT_EQ(sizes.count(received[at]), (size_t) 1) << "bad frame ID at byte " << at;
+    if (received[at] == 5) {
+      Errors e;
+      memcpy(&e, &received[at + 1], sizeof(Errors));
+      if (errors.empty() || errors.back() != e.error_vector[0]) {  // Repeated while the socket kept up
+        errors.push_back(e.error_vector[0]);
+      }
+    }
+    at += 1 + sizes[received[at]];
+  }
+  ASSERT_EQ(errors.size(), (size_t) 10);
+  for (uint32_t i = 0; i < 10; i++) {
+    EXPECT_EQ(errors[i], i);
+  }
+}
+
+// A base station that reads nothing at all is given up on, so the pod can reconnect
+TEST(TCPWriteTest, StalledReaderDropped) {
+  {
+    SlowReader reader;
+    TCPManager::write_stall_timeout = 100000;
+    while (!TCPManager::output_pending()) {
+      ASSERT_NE(TCPManager::write_data(), -1);
+    }
+    EXPECT_EQ(TCPManager::flush_data(), 0);
+    usleep(150000);
+    EXPECT_EQ(TCPManager::flush_data(), -1);
+  }
+
+  // The whole loop: the stalled connection is shut down, the read side returns and the pod connects again
+  char config_path[] = "/tmp/tcp_write_stall_XXXXXX";
+  int config_fd = mkstemp(config_path);
+  ASSERT_GE(config_fd, 0);
+  close(config_fd);
+  {
+    std::ofstream override_file(config_path);
+    override_file << "tcp_write_stall_timeout 200000\n" << "tcp_write_loop_timeout 100000\n"
+                  << "tcp_telemetry_format 0\n";
+    for (const char * stream : {"motion", "errors", "state", "can", "pru", "i2c", "adc", "bms"}) {
+      override_file << "tcp_stream_" << stream << "_period 1000\n" << "tcp_stream_" << stream << "_phase 0\n";
+    }
+  }
+  // The first value loaded for a key wins
+  ConfiguratorManager::config.clear();
+  bool loaded = ConfiguratorManager::config.openConfigFile(config_path, false);
+  unlink(config_path);
+  ASSERT_TRUE(loaded);
+  ASSERT_TRUE(ConfiguratorManager::config.openConfigFile(podtest_global::config_to_open, false));
+  Command::flush();
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listen_fd, 0);
+  int buffer = 4096;  // Inherited by the accepted sockets, so the pod's writes back up quickly
+  setsockopt(listen_fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = 0;  // Any free port
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(listen_fd, (struct sockaddr *) &address, sizeof(address)), 0);
+  ASSERT_EQ(listen(listen_fd, 1), 0);
+  socklen_t address_size = sizeof(address);
+  ASSERT_EQ(getsockname(listen_fd, (struct sockaddr *) &address, &address_size), 0);
+  // Loopback buffers take a few seconds to fill at these rates before the stall timeout starts counting
+  auto accept_pod = [listen_fd]() {
+    struct pollfd pfd = {listen_fd, POLLIN, 0};
+    return poll(&pfd, 1, 10000) == 1 ? accept(listen_fd, nullptr, nullptr) : -1;
+  };
+
+  // Owned by the pod thread as well, in case it has to be left behind
+  struct PodThread {
+    std::string port;
+    UnifiedState state;
+    Event exited;
+  };
+  std::shared_ptr<PodThread> pod_thread = make_shared<PodThread>();
+  pod_thread->port = std::to_string((unsigned int) ntohs(address.sin_port));
+  UnifiedState & state = pod_thread->state;
+  state.motion_data = make_shared<MotionData>();
+  state.adc_data = make_shared<ADCData>();
+  state.can_data = make_shared<CANData>();
+  state.i2c_data = make_shared<I2CData>();
+  state.pru_data = make_shared<PRUData>();
+  state.errors = make_shared<Errors>();
+  memset(state.errors.get(), 0, sizeof(Errors));
+  state.state = ST_SAFE_MODE;
+  // tcp_loop() waits on this between connections, only the simulator's own connect otherwise sets it
+  SimulatorManager::sim.pause_tcp.invoke();
+  std::thread pod([pod_thread]() {
+    TCPManager::tcp_loop("127.0.0.1", pod_thread->port.c_str(), &pod_thread->state);
+    pod_thread->exited.invoke();
+  });
+
+  int stalled = accept_pod();  // Never read from until the pod gives up on it
+  EXPECT_GE(stalled, 0);
+  int reconnected = accept_pod();
+  EXPECT_GE(reconnected, 0);
+
+  // The first connection was shut down by the pod: what it sent, then end of stream
+  if (stalled >= 0) {
+    struct timeval read_timeout = {5, 0};
+    setsockopt(stalled, SOL_SOCKET, SO_RCVTIMEO, &read_timeout, sizeof(read_timeout));
+    uint8_t buf[8192];
+    ssize_t n;
+    while ((n = read(stalled, buf, sizeof(buf))) > 0) {
+    }
+    EXPECT_EQ(n, 0);
+    close(stalled);
+  }
+
+  TCPManager::close_client();
+  pod_thread->exited.wait_for(5000000);
+  if (pod_thread->exited.is_set()) {
+    pod.join();
+  } else {
+    ADD_FAILURE() << "tcp_loop did not exit after close_client()";
+    pod.detach();
+  }
+  if (reconnected >= 0) {
+    close(reconnected);
+  }
+  close(listen_fd);
+  Command::flush();
+  ConfiguratorManager::config.clear();
+}
+
+// Everything due in a write cycle goes out in one send()
+TEST_F(PodTest, TCPWriteOneSyscallPerBatch) {
+  for (int i = 0; i < 300 && TCPManager::write_batches.load() == 0; i++) {
+    usleep(10000);
+  }
+  ASSERT_GT(TCPManager::write_batches.load(), (uint64_t) 0);
+  EXPECT_EQ(TCPManager::write_syscalls.load(), TCPManager::write_batches.load());
+  // At least the motion, error and state records
+  EXPECT_GE(TCPManager::bytes_written.load(), TELEMETRY_HEADER_SIZE + 3 * TELEMETRY_RECORD_HEADER_SIZE +
+            Telemetry::MOTION_SIZE + Telemetry::ERRORS_SIZE + Telemetry::STATE_SIZE);
+  TCPManager::print_write_stats();
+}
+#endif
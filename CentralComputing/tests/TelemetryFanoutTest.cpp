@@ -0,0 +1,177 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "TCPManager.h"
+#include "TelemetryFanout.h"
+#include <sys/socket.h>
+#include <netdb.h>
+#include <fstream>
+#include <string>
+#include <thread> // NOLINT
+#include <vector>
+
+namespace {
+// Test frames: [sequence u32][resync u8][filler], so the receiver can tell where it picked the stream up
+const size_t FRAME_SIZE = 1000;
+
+std::vector<uint8_t> make_frame(uint32_t sequence, bool resync) {
+  std::vector<uint8_t> frame(FRAME_SIZE, (uint8_t) sequence);
+  memcpy(frame.data(), &sequence, sizeof(sequence));
+  frame[4] = resync;
+  return frame;
+}
+
+// Reads whatever is there without blocking
+void drain(int fd, std::vector<uint8_t> * received) {
+  uint8_t buf[8192];
+  ssize_t n;
+  while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+    received->insert(received->end(), buf, buf + n);
+  }
+}
+}  // namespace
+
+// One slow subscriber loses packets and resyncs, the other two get every packet, byte for byte the same
+TEST(TelemetryFanoutTest, SlowClientOnlyHurtsItself) {
+  int fast[2][2], slow[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fast[0]), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fast[1]), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, slow), 0);
+  int buffer = 4096;
+  setsockopt(slow[0], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+  setsockopt(slow[1], SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+
+  TelemetryFanout fanout(3, 8);
+  ASSERT_TRUE(fanout.add(fast[0][0]));
+  ASSERT_TRUE(fanout.add(fast[1][0]));
+  ASSERT_TRUE(fanout.add(slow[0]));
+  EXPECT_FALSE(fanout.add(-1));  // Full
+  EXPECT_EQ(fanout.clients(), (size_t) 3);
+
+  std::vector<uint8_t> received[3];
+  bool overflowed = false;
+  const uint32_t frames = 200;
+  for (uint32_t i = 0; i < frames; i++) {
+    bool resync = i % 10 == 0;  // A keyframe every 10 packets
+    std::vector<uint8_t> frame = make_frame(i, resync);
+    overflowed |= fanout.publish(frame.data(), frame.size(), resync);
+    int64_t start = Utils::microseconds();
+    fanout.flush(10000000);
+    EXPECT_LT(Utils::microseconds() - start, 50000);
+    drain(fast[0][1], &received[0]);
+    drain(fast[1][1], &received[1]);
+    if (i >= 50 && i < 150) {
+      continue;  // The slow client stops reading for a while
+    }
+    drain(slow[1], &received[2]);
+  }
+  EXPECT_TRUE(overflowed);
+  for (int i = 0; i < 100 && !fanout.pending().empty(); i++) {
+    fanout.flush(10000000);
+    drain(fast[0][1], &received[0]);
+    drain(fast[1][1], &received[1]);
+    drain(slow[1], &received[2]);
+    usleep(1000);
+  }
+  EXPECT_TRUE(fanout.pending().empty());
+
+  ASSERT_EQ(received[0].size(), frames * FRAME_SIZE);
+  EXPECT_EQ(received[0], received[1]);
+
+  // Whole frames, in order, and every gap ends at a resync point
+  ASSERT_EQ(received[2].size() % FRAME_SIZE, (size_t) 0);
+  uint32_t previous = 0;
+  size_t gaps = 0;
+  for (size_t at = 0; at < received[2].size(); at += FRAME_SIZE) {
+    uint32_t sequence;
+    memcpy(&sequence, &received[2][at], sizeof(sequence));
+    ASSERT_EQ(memcmp(&received[2][at], make_frame(sequence, received[2][at + 4]).data(), FRAME_SIZE), 0);
+    if (at > 0 && sequence != previous + 1) {
+      ASSERT_GT(sequence, previous);
+      EXPECT_TRUE(received[2][at + 4]) << "picked up at " << sequence;
+      gaps++;
+    }
+    previous = sequence;
+  }
+  EXPECT_EQ(previous, frames - 1);
+  EXPECT_GE(gaps, (size_t) 1);
+  EXPECT_EQ(fanout.frames_dropped.load(), frames - received[2].size() / FRAME_SIZE);
+  fanout.print_stats();
+
+  close(fast[0][1]);
+  close(fast[1][1]);
+  close(slow[1]);
+}
+
+// The pod listening for subscribers: both get telemetry, either can send commands
+TEST(TelemetryFanoutTest, ServerMode) {
+  const char * port = "8041";
+  {
+    std::ofstream override_file("/tmp/tcp_server_mode.txt");
+    override_file << "tcp_mode 1\n" << "tcp_port " << port << "\n";
+  }
+  // The first value loaded for a key wins
+  ConfiguratorManager::config.clear();
+  ASSERT_TRUE(ConfiguratorManager::config.openConfigFile("/tmp/tcp_server_mode.txt", false));
+  ASSERT_TRUE(ConfiguratorManager::config.openConfigFile(podtest_global::config_to_open, false));
+  Command::flush();
+
+  UnifiedState state;
+  state.motion_data = std::make_shared<MotionData>();
+  state.adc_data = std::make_shared<ADCData>();
+  state.can_data = std::make_shared<CANData>();
+  state.i2c_data = std::make_shared<I2CData>();
+  state.pru_data = std::make_shared<PRUData>();
+  state.errors = std::make_shared<Errors>();
+  memset(state.errors.get(), 0, sizeof(Errors));
+  state.state = ST_SAFE_MODE;
+  std::thread server(TCPManager::tcp_loop, "127.0.0.1", port, &state);
+
+  int clients[2];
+  for (int & fd : clients) {
+    struct addrinfo hints, *info;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    ASSERT_EQ(getaddrinfo("127.0.0.1", port, &hints, &info), 0);
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    bool ok = false;
+    for (int i = 0; i < 100 && !ok; i++) {
+      ok = connect(fd, info->ai_addr, info->ai_addrlen) == 0;
+      if (!ok) {
+        usleep(10000);
+      }
+    }
+    freeaddrinfo(info);
+    ASSERT_TRUE(ok);
+  }
+  TCPManager::connected.wait();
+
+  // Both start at a keyframe
+  for (int fd : clients) {
+    uint8_t header[TELEMETRY_HEADER_SIZE];
+    ASSERT_EQ(recv(fd, header, sizeof(header), MSG_WAITALL), (ssize_t) sizeof(header));
+    Telemetry::Header decoded;
+    EXPECT_TRUE(Telemetry::decode_header(header, sizeof(header), &decoded));
+  }
+
+  Command::Network_Command command = {Command::REQUEST_KEYFRAME, 0};
+  EXPECT_EQ(write(clients[1], &command, sizeof(command)), (ssize_t) sizeof(command));
+  Command::Network_Command received;
+  bool got = false;
+  for (int i = 0; i < 100 && !got; i++) {
+    while (!got && Command::get(&received)) {
+      got = received.id == Command::REQUEST_KEYFRAME;
+    }
+    usleep(10000);
+  }
+  EXPECT_TRUE(got);
+  EXPECT_EQ(TCPManager::fanout->clients(), (size_t) 2);
+
+  TCPManager::close_client();
+  server.join();
+  close(clients[0]);
+  close(clients[1]);
+  Command::flush();
+  ConfiguratorManager::config.clear();
+}
+#endif
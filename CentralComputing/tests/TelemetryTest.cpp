@@ -0,0 +1,308 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "ScenarioRealLong.h"
+#include "Telemetry.h"
+#include "Utils.h"
+#include <string.h>
+#include <vector>
+
+using std::make_shared;
+
+namespace {
+// Walks the records of a packet, decoding the ones the test fills in
+struct Decoded {
+  MotionData motion;
+  Errors errors;
+  Telemetry::StateData state;
+  CANData can;
+  BMSCells bms;
+  PRUData pru;
+  I2CData i2c;
+  ADCData adc;
+  int records = 0;
+};
+
+// Every record in the write loop, as the pod had it at one instant
+struct Snapshot {
+  int64_t time;
+  MotionData motion;
+  Errors errors;
+  E_States state;
+  CANData can;
+  PRUData pru;
+  I2CData i2c;
+  ADCData adc;
+  BMSCells bms;
+};
+
+size_t encode_sample(const Snapshot & s, uint8_t * packet, uint32_t sequence, Telemetry::Encoder * encoder) {
+  size_t size = encoder->begin_packet(packet, sequence, s.time);
+  size += encoder->encode(s.motion, packet + size);
+  size += encoder->encode(s.errors, packet + size);
+  size += encoder->encode(s.state, packet + size);
+  size += encoder->encode(s.can, packet + size);
+  size += encoder->encode(s.pru, packet + size);
+  size += encoder->encode(s.i2c, packet + size);
+  size += encoder->encode(s.adc, packet + size);
+  size += encoder->encode(s.bms, packet + size);
+  Telemetry::finish_packet(packet, size);
+  return size;
+}
+
+bool decode_packet(const uint8_t * packet, size_t size, Telemetry::Header * header, Decoded * out) {
+  if (!Telemetry::decode_header(packet, size, header) || (size_t) (TELEMETRY_HEADER_SIZE + header->length) != size) {
+    return false;
+  }
+  const uint8_t * record = packet + TELEMETRY_HEADER_SIZE;
+  while (record < packet + size) {
+    uint8_t type = record[0];
+    size_t length = record[1] | (record[2] << 8);
+    const uint8_t * fields = record + TELEMETRY_RECORD_HEADER_SIZE;
+    bool ok = true;
+    switch (type) {
+      case Telemetry::MOTION: ok = Telemetry::decode(fields, length, &out->motion); break;
+      case Telemetry::ERRORS: ok = Telemetry::decode(fields, length, &out->errors); break;
+      case Telemetry::STATE:  ok = Telemetry::decode(fields, length, &out->state); break;
+      case Telemetry::CAN:    ok = Telemetry::decode(fields, length, &out->can); break;
+      case Telemetry::PRU:    ok = Telemetry::decode(fields, length, &out->pru); break;
+      case Telemetry::I2C:    ok = Telemetry::decode(fields, length, &out->i2c); break;
+      case Telemetry::ADC:    ok = Telemetry::decode(fields, length, &out->adc); break;
+      case Telemetry::BMS:    ok = Telemetry::decode(fields, length, &out->bms); break;
+      case Telemetry::MOTION | TELEMETRY_DELTA: ok = Telemetry::apply_delta(fields, length, &out->motion); break;
+      case Telemetry::ERRORS | TELEMETRY_DELTA: ok = Telemetry::apply_delta(fields, length, &out->errors); break;
+      case Telemetry::STATE | TELEMETRY_DELTA:  ok = Telemetry::apply_delta(fields, length, &out->state); break;
+      case Telemetry::CAN | TELEMETRY_DELTA:    ok = Telemetry::apply_delta(fields, length, &out->can); break;
+      case Telemetry::PRU | TELEMETRY_DELTA:    ok = Telemetry::apply_delta(fields, length, &out->pru); break;
+      case Telemetry::I2C | TELEMETRY_DELTA:    ok = Telemetry::apply_delta(fields, length, &out->i2c); break;
+      case Telemetry::ADC | TELEMETRY_DELTA:    ok = Telemetry::apply_delta(fields, length, &out->adc); break;
+      case Telemetry::BMS | TELEMETRY_DELTA:    ok = Telemetry::apply_delta(fields, length, &out->bms); break;
+      default: break;  // Unknown records are skipped
+    }
+    if (!ok) {
+      return false;
+    }
+    out->records++;
+    record = fields + length;
+  }
+  return true;
+}
+}  // namespace
+
+TEST(TelemetryTest, RoundTrip) {
+  MotionData motion;
+  memset(&motion, 0, sizeof(motion));
+  motion.x[0] = 123456;
+  motion.x[1] = -2000;
+  motion.x[2] = 455;
+  motion.p_timeout = 30000000;
+  motion.b_counter = -5;
+  motion.motor_state = 1;
+  motion.motor_target_torque = -300;
+  memcpy(motion.relay_state_buf, "\x01\x00\x01\x00", 4);
+  Errors errors = {{ADC_READ_ERROR, CAN_BMS_ROLLING_COUNTER_ERROR | CAN_SETUP_FAILURE, 0, 0, TCP_DISCONNECT_ERROR, 0}};
+  CANData can;
+  memset(&can, 0, sizeof(can));
+  can.status_word = 0xBEEF;
+  can.position_val = 0x12345678;
+  can.torque_val = 1000;
+  can.pack_soc = 87;
+  can.adaptive_soc = 250;
+  BMSCells bms;
+  memset(&bms, 0, sizeof(bms));
+  bms.cell_data[29].cell_id = 29;
+  bms.cell_data[29].instant_voltage = 41000;
+  bms.cell_data[0].open_voltage = 36000;
+  bms.therm_value[39] = -12;
+  bms.highest_therm_id = 39;
+
+  uint8_t packet[Telemetry::MAX_PACKET_SIZE];
+  size_t size = Telemetry::begin_packet(packet, 42, 1234567890123);
+  size += Telemetry::encode(motion, packet + size);
+  size += Telemetry::encode(errors, packet + size);
+  size += Telemetry::encode(ST_FLIGHT_COAST, packet + size);
+  size += Telemetry::encode(can, packet + size);
+  size += Telemetry::encode(bms, packet + size);
+  Telemetry::finish_packet(packet, size);
+  EXPECT_EQ(size, TELEMETRY_HEADER_SIZE + 5 * TELEMETRY_RECORD_HEADER_SIZE + Telemetry::MOTION_SIZE +
+            Telemetry::ERRORS_SIZE + Telemetry::STATE_SIZE + Telemetry::CAN_SIZE + Telemetry::BMS_SIZE);
+
+  Telemetry::Header header;
+  Decoded decoded{};  // The padding bytes are not sent
+  ASSERT_TRUE(decode_packet(packet, size, &header, &decoded));
+  EXPECT_EQ(header.version, TELEMETRY_VERSION);
+  EXPECT_EQ(header.sequence, (uint32_t) 42);
+  EXPECT_EQ(header.timestamp, 1234567890123);
+  EXPECT_EQ(decoded.records, 5);
+
+  EXPECT_EQ(memcmp(decoded.motion.x, motion.x, sizeof(motion.x)), 0);
+  EXPECT_EQ(decoded.motion.p_timeout, motion.p_timeout);
+  EXPECT_EQ(decoded.motion.b_counter, motion.b_counter);
+  EXPECT_EQ(decoded.motion.motor_state, motion.motor_state);
+  EXPECT_EQ(decoded.motion.motor_target_torque, motion.motor_target_torque);
+  EXPECT_EQ(memcmp(decoded.motion.relay_state_buf, motion.relay_state_buf, 4), 0);
+  EXPECT_EQ(memcmp(&decoded.errors, &errors, sizeof(Errors)), 0);
+  EXPECT_EQ(decoded.state.state, ST_FLIGHT_COAST);
+  EXPECT_EQ(memcmp(&decoded.can, &can, sizeof(CANData)), 0);
+  EXPECT_EQ(memcmp(&decoded.bms, &bms, sizeof(BMSCells)), 0);
+
+  // A truncated record is refused
+  EXPECT_FALSE(Telemetry::decode(packet + TELEMETRY_HEADER_SIZE + TELEMETRY_RECORD_HEADER_SIZE,
+                                 Telemetry::MOTION_SIZE - 1, &decoded.motion));
+  packet[0] = 4;  // A raw frame ID, not a telemetry packet
+  EXPECT_FALSE(Telemetry::decode_header(packet, size, &header));
+}
+
+// Byte for byte, so the base station never depends on this machine's layout
+TEST(TelemetryTest, LittleEndianLayout) {
+  Errors errors = {{0x01020304, 0, 0, 0, 0, 0xA0B0C0D0}};
+  uint8_t record[TELEMETRY_RECORD_HEADER_SIZE + Telemetry::ERRORS_SIZE];
+  ASSERT_EQ(Telemetry::encode(errors, record), sizeof(record));
+  const uint8_t expected_head[] = {Telemetry::ERRORS, 24, 0, 0x04, 0x03, 0x02, 0x01};
+  EXPECT_EQ(memcmp(record, expected_head, sizeof(expected_head)), 0);
+  const uint8_t expected_tail[] = {0xD0, 0xC0, 0xB0, 0xA0};
+  EXPECT_EQ(memcmp(record + sizeof(record) - 4, expected_tail, 4), 0);
+
+  uint8_t header[TELEMETRY_HEADER_SIZE];
+  Telemetry::begin_packet(header, 0x11223344, -2);
+  Telemetry::finish_packet(header, TELEMETRY_HEADER_SIZE + 0x0102);
+  const uint8_t expected_header[] = {TELEMETRY_MAGIC, TELEMETRY_VERSION, 0x02, 0x01, 0x44, 0x33, 0x22, 0x11,
+                                     0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  EXPECT_EQ(memcmp(header, expected_header, sizeof(header)), 0);
+}
+
+// Everything the write loop sends, packed vs the raw structs (plus their 1 byte IDs)
+TEST(TelemetryTest, SmallerThanRaw) {
+  EXPECT_LT(Telemetry::CAN_SIZE, sizeof(CANData));
+  EXPECT_LT(Telemetry::MOTION_SIZE, sizeof(MotionData));
+  EXPECT_LT(Telemetry::ADC_SIZE, sizeof(ADCData));
+  EXPECT_LT(Telemetry::BMS_SIZE, sizeof(BMSCells));
+  size_t raw = 8 + sizeof(MotionData) + sizeof(Errors) + sizeof(uint32_t) + sizeof(CANData) + sizeof(PRUData) +
+               sizeof(I2CData) + sizeof(ADCData) + sizeof(BMSCells);
+  EXPECT_LT(Telemetry::MAX_PACKET_SIZE, raw);
+  Utils::print(Utils::LogLevel::LOG_INFO, "Telemetry: %lu bytes packed (CAN %lu), %lu bytes raw (CAN %lu)\n",
+               (unsigned long) Telemetry::MAX_PACKET_SIZE, (unsigned long) Telemetry::CAN_SIZE,
+               (unsigned long) raw, (unsigned long) sizeof(CANData));
+}
+
+// Only the changed fields go out, and applying them gets back exactly what was sent
+TEST(TelemetryTest, DeltaRoundTrip) {
+  CANData can;
+  memset(&can, 0, sizeof(can));
+  can.pack_soc = 87;
+  can.rolling_counter = 1;
+  Telemetry::Encoder encoder(1000000);
+  uint8_t record[TELEMETRY_RECORD_HEADER_SIZE + Telemetry::CAN_SIZE];
+  ASSERT_EQ(encoder.encode(can, record), TELEMETRY_RECORD_HEADER_SIZE + Telemetry::CAN_SIZE);  // Whole at first
+  EXPECT_EQ(record[0], Telemetry::CAN);
+  CANData received;
+  memset(&received, 0, sizeof(received));
+  ASSERT_TRUE(Telemetry::decode(record + TELEMETRY_RECORD_HEADER_SIZE, Telemetry::CAN_SIZE, &received));
+
+  EXPECT_EQ(encoder.encode(can, record), (size_t) 0);  // Unchanged
+
+  can.rolling_counter = 2;
+  can.torque_val = (uint32_t) -250;  // Negative, the int16_t sign extended
+  size_t size = encoder.encode(can, record);
+  EXPECT_EQ(record[0], Telemetry::CAN | TELEMETRY_DELTA);
+  EXPECT_EQ(size, TELEMETRY_RECORD_HEADER_SIZE + Telemetry::CAN_MASK_SIZE + sizeof(uint8_t) + sizeof(int16_t));
+  ASSERT_TRUE(Telemetry::apply_delta(record + TELEMETRY_RECORD_HEADER_SIZE, size - TELEMETRY_RECORD_HEADER_SIZE,
+                                     &received));
+  EXPECT_EQ(memcmp(&received, &can, sizeof(CANData)), 0);
+  // A truncated delta is refused
+  EXPECT_FALSE(Telemetry::apply_delta(record + TELEMETRY_RECORD_HEADER_SIZE, size - TELEMETRY_RECORD_HEADER_SIZE - 1,
+                                      &received));
+
+  // With nearly everything changed the whole record is smaller than the delta
+  memset(&can, 0x11, sizeof(can));
+  EXPECT_EQ(encoder.encode(can, record), TELEMETRY_RECORD_HEADER_SIZE + Telemetry::CAN_SIZE);
+  EXPECT_EQ(record[0], Telemetry::CAN);
+
+  // Without a keyframe period nothing is ever left out
+  Telemetry::Encoder whole(0);
+  EXPECT_EQ(whole.encode(can, record), TELEMETRY_RECORD_HEADER_SIZE + Telemetry::CAN_SIZE);
+  EXPECT_EQ(whole.encode(can, record), TELEMETRY_RECORD_HEADER_SIZE + Telemetry::CAN_SIZE);
+}
+
+TEST(TelemetryTest, Keyframes) {
+  Errors errors = {{0, 0, 0, 0, 0, 0}};
+  Telemetry::Encoder encoder(1000000);
+  uint8_t packet[Telemetry::MAX_PACKET_SIZE];
+  encoder.begin_packet(packet, 0, 5000000);
+  EXPECT_TRUE(encoder.starts_keyframe());
+  EXPECT_GT(encoder.encode(errors, packet), (size_t) 0);
+  encoder.begin_packet(packet, 1, 5500000);
+  EXPECT_FALSE(encoder.starts_keyframe());
+  EXPECT_EQ(encoder.encode(errors, packet), (size_t) 0);
+  encoder.begin_packet(packet, 2, 6000000);  // A period since the last keyframe
+  EXPECT_TRUE(encoder.starts_keyframe());
+  EXPECT_EQ(encoder.encode(errors, packet), TELEMETRY_RECORD_HEADER_SIZE + Telemetry::ERRORS_SIZE);
+  encoder.begin_packet(packet, 3, 6100000);
+  EXPECT_EQ(encoder.encode(errors, packet), (size_t) 0);
+  encoder.request_keyframe();
+  EXPECT_EQ(encoder.encode(errors, packet), TELEMETRY_RECORD_HEADER_SIZE + Telemetry::ERRORS_SIZE);
+  EXPECT_EQ(encoder.encode(errors, packet), (size_t) 0);
+  encoder.begin_packet(packet, 4, 6200000);
+  EXPECT_TRUE(encoder.starts_keyframe());
+}
+
+// Records what the write loop would send from a real run, every 10ms, then sends it whole and as deltas.
+// The receiver must end up with exactly the recording either way
+TEST_F(PodTest, DeltaBandwidthRealLong) {
+  SimulatorManager::sim.set_scenario(make_shared<ScenarioRealLong>());
+  SimulatorManager::sim.loaded_scenario.invoke();
+  usleep(200000);
+
+  std::vector<Snapshot> samples(300);
+  for (Snapshot & s : samples) {
+    memset(&s, 0, sizeof(s));
+    TCPManager::data_mutex.lock();
+    s.time = Utils::microseconds();
+    s.motion = *pod->unified_state.motion_data;
+    s.errors = *pod->unified_state.errors;
+    s.state = pod->unified_state.state;
+    s.can = *pod->unified_state.can_data;
+    s.pru = *pod->unified_state.pru_data;
+    s.i2c = *pod->unified_state.i2c_data;
+    s.adc = *pod->unified_state.adc_data;
+    TCPManager::data_mutex.unlock();
+    SourceManager::CAN.cell_data_mutex.lock();
+    s.bms = SourceManager::CAN.public_cell_data;
+    SourceManager::CAN.cell_data_mutex.unlock();
+    usleep(10000);
+  }
+
+  Telemetry::Encoder whole(0);
+  Telemetry::Encoder delta(1000000);
+  uint8_t packet[Telemetry::MAX_PACKET_SIZE];
+  size_t whole_bytes = 0, delta_bytes = 0;
+  Decoded received{};
+  uint32_t sequence = 0;
+  for (const Snapshot & s : samples) {
+    whole_bytes += encode_sample(s, packet, sequence, &whole);
+    size_t size = encode_sample(s, packet, sequence++, &delta);
+    delta_bytes += size;
+
+    Telemetry::Header header;
+    ASSERT_TRUE(decode_packet(packet, size, &header, &received));
+    // Compared as the encoded bytes, the padding is never sent
+    uint8_t expected[Telemetry::MAX_PACKET_SIZE], actual[Telemetry::MAX_PACKET_SIZE];
+    Snapshot got = s;
+    got.motion = received.motion;
+    got.errors = received.errors;
+    got.state = received.state.state;
+    got.can = received.can;
+    got.pru = received.pru;
+    got.i2c = received.i2c;
+    got.adc = received.adc;
+    got.bms = received.bms;
+    size_t expected_size = encode_sample(s, expected, 0, &whole);
+    ASSERT_EQ(encode_sample(got, actual, 0, &whole), expected_size);
+    ASSERT_EQ(memcmp(expected, actual, expected_size), 0) << "sample " << sequence;
+  }
+  double seconds = (samples.back().time - samples.front().time) / 1000000.0;
+  print(LogLevel::LOG_INFO, "Telemetry over %.1fs of ScenarioRealLong: %lu bytes whole (%.0f bytes/s), "
+        "%lu bytes as deltas (%.0f bytes/s), %.1f%%\n", seconds, (unsigned long) whole_bytes, whole_bytes / seconds,
+        (unsigned long) delta_bytes, delta_bytes / seconds, 100.0 * delta_bytes / whole_bytes);
+  EXPECT_LT(delta_bytes, whole_bytes / 2);
+}
+#endif
@@ -0,0 +1,72 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "ThreadConfig.h"
+#include <pthread.h>
+#include <sched.h>
+#include <thread> // NOLINT
+
+TEST(ThreadConfigTest, NameAndAffinity) {
+  ThreadConfig::Settings requested;
+  requested.policy = SCHED_OTHER;
+  requested.priority = 0;
+  requested.cpu = 0;
+
+  bool ok = false;
+  char name[16];
+  ThreadConfig::Settings actual;
+  std::thread t([&] {
+    ok = ThreadConfig::apply("config_test_thread_long_name", requested);
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    actual = ThreadConfig::current();
+  });
+  t.join();
+
+  EXPECT_TRUE(ok);
+  EXPECT_STREQ(name, "config_test_thr");  // Truncated to 15 characters
+  EXPECT_EQ(actual.policy, SCHED_OTHER);
+  EXPECT_EQ(actual.cpu, 0);
+
+  ThreadConfig::Settings reported_requested;
+  ThreadConfig::Settings reported_actual;
+  ASSERT_TRUE(ThreadConfig::applied("config_test_thread_long_name", &reported_requested, &reported_actual));
+  EXPECT_EQ(reported_requested.cpu, 0);
+  EXPECT_EQ(reported_actual.cpu, 0);
+  EXPECT_FALSE(ThreadConfig::applied("no_such_thread", &reported_requested, &reported_actual));
+}
+
+// Real time priorities need CAP_SYS_NICE. Either way, the report has to match what the kernel says
+TEST(ThreadConfigTest, RealTimeReportMatchesKernel) {
+  ThreadConfig::Settings requested;
+  requested.policy = SCHED_FIFO;
+  requested.priority = 1;
+  requested.cpu = -1;
+
+  bool ok = false;
+  ThreadConfig::Settings actual;
+  std::thread t([&] {
+    ok = ThreadConfig::apply("config_test_rt", requested);
+    actual = ThreadConfig::current();
+  });
+  t.join();
+
+  EXPECT_EQ(ok, actual.policy == SCHED_FIFO);
+  ThreadConfig::Settings reported_requested;
+  ThreadConfig::Settings reported_actual;
+  ASSERT_TRUE(ThreadConfig::applied("config_test_rt", &reported_requested, &reported_actual));
+  EXPECT_EQ(reported_requested.policy, SCHED_FIFO);
+  EXPECT_EQ(reported_actual.policy, actual.policy);
+  EXPECT_EQ(reported_actual.priority, actual.priority);
+}
+
+// Every pod thread names itself and reports what it got
+TEST_F(PodTest, PodThreadsReported) {
+  ThreadConfig::Settings requested;
+  ThreadConfig::Settings actual;
+  const char * names[] = {"logic_loop", "tcp_loop", "tcp_read_loop", "tcp_write_loop", "udp_manager"};
+  for (const char * name : names) {
+    EXPECT_TRUE(ThreadConfig::applied(name, &requested, &actual)) << name;
+  }
+  EXPECT_TRUE(ThreadConfig::applied("reactor", &requested, &actual) ||
+              ThreadConfig::applied("can_manager", &requested, &actual));
+}
+#endif
@@ -0,0 +1,49 @@
+#ifdef SIM // Only compile if building test executable
+#include "PodTest.cpp"
+#include "Trace.h"
+#include <fstream>
+#include <sstream>
+
+// ENABLE_BRAKE is carried out by the action function, TRANS_SAFE_MODE by its transition (ST_Safe_Mode)
+TEST_F(PodTest, CommandTrace) {
+  MoveState(Command::Network_Command_ID::TRANS_FUNCTIONAL_TEST_OUTSIDE, E_States::ST_FUNCTIONAL_TEST_OUTSIDE, true);
+  SendCommand(Command::Network_Command_ID::ENABLE_BRAKE, 0);
+  MoveState(Command::Network_Command_ID::TRANS_SAFE_MODE, E_States::ST_SAFE_MODE, true);
+
+  Sample<CommandTrace> traces[Trace::RING_LENGTH];
+  size_t n = Trace::ring.last(Trace::RING_LENGTH, traces);
+  bool found_brake = false;
+  for (size_t i = 0; i < n; i++) {
+    const CommandTrace & t = traces[i].data;
+    EXPECT_LE(t.created, t.dequeued);
+    EXPECT_LE(t.dequeued, t.transitioned);
+    if (t.id == Command::ENABLE_BRAKE) {
+      found_brake = true;
+      EXPECT_GE(t.actuated, t.transitioned);  // Steady function, after the (empty) transition
+    }
+  }
+  EXPECT_TRUE(found_brake);
+
+  Trace::Summary summary;
+  ASSERT_TRUE(Trace::summarize(Command::ENABLE_BRAKE, &summary));
+  EXPECT_EQ(summary.dequeued.count, (uint32_t) 1);
+  EXPECT_EQ(summary.actuated.count, (uint32_t) 1);
+  EXPECT_LE(summary.dequeued.max, summary.actuated.max);
+  ASSERT_TRUE(Trace::summarize(Command::TRANS_SAFE_MODE, &summary));
+  EXPECT_EQ(summary.actuated.count, (uint32_t) 1);  // Entering safe mode turns the motor off
+  EXPECT_FALSE(Trace::summarize(Command::TRANS_FLIGHT_ACCEL, &summary));
+  Trace::print_summary();
+
+  std::string path = "/tmp/command_trace_test.json";
+  ASSERT_TRUE(Trace::export_chrome(path));
+  std::ifstream in(path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  std::string json = contents.str();
+  EXPECT_EQ(json.find("{\"traceEvents\":["), (size_t) 0);
+  EXPECT_NE(json.find("\"name\":\"ENABLE_BRAKE\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"actuation\""), std::string::npos);
+  EXPECT_NE(json.find("]"), std::string::npos);
+  remove(path.c_str());
+}
+#endif